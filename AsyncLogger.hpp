@@ -0,0 +1,747 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: AsyncLogger.hpp                                             //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_ASYNCLOGGER_HPP
+#define GCLOG_ASYNCLOGGER_HPP
+
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+
+namespace gc {
+    // -------------------------------------------------------------------------
+    // Blocks for messages too long to sit in a queue cell, in fixed size
+    // classes. Each producer thread allocates from its own arena without
+    // a lock, the writer thread hands finished blocks back in batches
+    // through a lock-free stack, which the owner takes over with one
+    // exchange once its free lists run dry. A message longer than the
+    // largest class is a chain of largest class chunks.
+    //
+    // Blocks are only ever recycled, never freed before the arena, so
+    // once each size class has seen its peak nothing is allocated.
+    class RecordArena
+    {
+    public:
+        struct Block
+        {
+            Block *next{nullptr};        // the chain, a free list or a batch
+            RecordArena *owner{nullptr};
+            std::uint32_t sizeClass{0};
+            std::uint32_t used{0};
+            Block *allocated{nullptr};   // every block of the owner
+
+            [[nodiscard]] char *data() { return reinterpret_cast<char *>(this + 1); }
+
+            [[nodiscard]] const char *data() const { return reinterpret_cast<const char *>(this + 1); }
+
+            [[nodiscard]] std::size_t capacity() const { return ClassSizes[sizeClass]; }
+        };
+
+        static constexpr std::array<std::size_t, 4> ClassSizes{512, 2048, 8192, 32768};
+
+        RecordArena() = default;
+
+        ~RecordArena()
+        {
+            for (Block *block = m_allocated; block != nullptr;) {
+                Block *next = block->allocated;
+                block->~Block();
+                ::operator delete(block);
+                block = next;
+            }
+        }
+
+        RecordArena(const RecordArena &) = delete;            // non construction-copyable
+        RecordArena(RecordArena &&) = delete;                 // non movable
+        RecordArena &operator=(const RecordArena &) = delete; // non copyable
+        RecordArena &operator=(RecordArena &&) = delete;      // move assignment
+
+        // ---------------------------------------------------------------------
+        // A chain with room for size bytes, its used counts set to size.
+        // Only called by the thread owning the arena.
+        Block *allocate(std::size_t size)
+        {
+            std::uint32_t sizeClass = 0;
+            while (sizeClass + 1 < ClassSizes.size() && ClassSizes[sizeClass] < size) {
+                ++sizeClass;
+            }
+
+            Block *head = nullptr;
+            Block **link = &head;
+            do {
+                Block *block = take(sizeClass);
+                block->next = nullptr;
+                block->used = static_cast<std::uint32_t>(std::min(size, block->capacity()));
+                size -= block->used;
+                *link = block;
+                link = &block->next;
+            } while (size != 0);
+            return head;
+        }
+
+        // ---------------------------------------------------------------------
+        // Copies text into a chain allocate(text.size()) returned.
+        static void copyInto(Block *chain, std::string_view text)
+        {
+            for (; chain != nullptr; chain = chain->next) {
+                std::memcpy(chain->data(), text.data(), chain->used);
+                text.remove_prefix(chain->used);
+            }
+        }
+
+        // ---------------------------------------------------------------------
+        static void appendTo(std::string &out, const Block *chain)
+        {
+            for (; chain != nullptr; chain = chain->next) {
+                out.append(chain->data(), chain->used);
+            }
+        }
+
+        // ---------------------------------------------------------------------
+        // Collects released chains and hands them back to their arena a
+        // batch at a time, with one compare-exchange per batch.
+        class ReturnBatch
+        {
+        public:
+            ReturnBatch() = default;
+
+            ~ReturnBatch() { flush(); }
+
+            ReturnBatch(const ReturnBatch &) = delete;            // non construction-copyable
+            ReturnBatch &operator=(const ReturnBatch &) = delete; // non copyable
+
+            void add(Block *chain)
+            {
+                if (m_head != nullptr && (chain->owner != m_owner || m_count == MaxBatch)) {
+                    flush();
+                }
+                Block *tail = chain;
+                while (tail->next != nullptr) {
+                    tail = tail->next;
+                }
+                if (m_head == nullptr) {
+                    m_owner = chain->owner;
+                    m_tail = tail;
+                }
+                tail->next = m_head;
+                m_head = chain;
+                ++m_count;
+            }
+
+            void flush()
+            {
+                if (m_head != nullptr) {
+                    m_owner->giveBack(m_head, m_tail);
+                }
+                m_owner = nullptr;
+                m_head = m_tail = nullptr;
+                m_count = 0;
+            }
+
+        private:
+            static constexpr std::size_t MaxBatch = 64;
+
+            RecordArena *m_owner{nullptr};
+            Block *m_head{nullptr};
+            Block *m_tail{nullptr};
+            std::size_t m_count{0};
+        };
+
+    private:
+        std::array<Block *, ClassSizes.size()> m_free{};
+        Block *m_allocated{nullptr};
+        alignas(64) std::atomic<Block *> m_returned{nullptr};
+
+        // ---------------------------------------------------------------------
+        Block *take(std::uint32_t sizeClass)
+        {
+            if (m_free[sizeClass] == nullptr) {
+                reclaim();
+            }
+            if (Block *block = m_free[sizeClass]) {
+                m_free[sizeClass] = block->next;
+                return block;
+            }
+
+            auto *block = ::new(::operator new(sizeof(Block) + ClassSizes[sizeClass])) Block;
+            block->owner = this;
+            block->sizeClass = sizeClass;
+            block->allocated = m_allocated;
+            m_allocated = block;
+            return block;
+        }
+
+        // ---------------------------------------------------------------------
+        // Sorts everything handed back so far into the free lists.
+        void reclaim()
+        {
+            Block *block = m_returned.exchange(nullptr, std::memory_order_acquire);
+            while (block != nullptr) {
+                Block *next = block->next;
+                block->next = m_free[block->sizeClass];
+                m_free[block->sizeClass] = block;
+                block = next;
+            }
+        }
+
+        // ---------------------------------------------------------------------
+        // Any thread, head to tail linked through next.
+        void giveBack(Block *head, Block *tail)
+        {
+            Block *top = m_returned.load(std::memory_order_relaxed);
+            do {
+                tail->next = top;
+            } while (!m_returned.compare_exchange_weak(top, head, std::memory_order_release,
+                                                       std::memory_order_relaxed));
+        }
+    };
+
+    // -------------------------------------------------------------------------
+    // Bounded lock-free queue of fixed-size log records (Dmitry Vyukov's
+    // sequence-per-cell design). Any number of threads may push, the writer
+    // thread pops. Producers may also pop, which is how DROP_OLDEST makes
+    // room, so the pop side is safe for several threads as well.
+    class AsyncRecordQueue
+    {
+    public:
+        static constexpr std::size_t MessageCapacity = 216;
+
+        // A message up to MessageCapacity long sits in text, a longer one
+        // in the spill chain and length is its whole size. time is when
+        // the record was logged.
+        struct Record
+        {
+            Logger::LogLevel level{Logger::LogLevel::INFO};
+            std::uint32_t length{0};
+            RecordArena::Block *spill{nullptr};
+            timespec time{};
+            char text[MessageCapacity]{};
+        };
+
+        explicit AsyncRecordQueue(std::size_t capacity)
+                : m_mask(roundUpToPowerOfTwo(capacity) - 1),
+                  m_cells(std::make_unique<Cell[]>(m_mask + 1))
+        {
+            for (std::size_t i = 0; i <= m_mask; ++i) {
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        AsyncRecordQueue(const AsyncRecordQueue &) = delete;
+        AsyncRecordQueue &operator=(const AsyncRecordQueue &) = delete;
+
+        // Returns false if the queue is full. Messages longer than
+        // MessageCapacity are truncated, AsyncLogger spills them into
+        // its arenas instead.
+        bool tryPush(Logger::LogLevel level, std::string_view message)
+        {
+            return tryEmplace(level, [message](Record &record) noexcept {
+                record.length = static_cast<std::uint32_t>(std::min(message.size(), MessageCapacity));
+                std::memcpy(record.text, message.data(), record.length);
+            });
+        }
+
+        // Claims a cell and lets writer fill in the record's text, length
+        // and spill directly. It is only called once a cell has been
+        // claimed, and every record queued after it waits until it
+        // returns: writer should copy and do nothing else, and can't
+        // throw, a cell left claimed would hold up the queue for good.
+        template<typename Writer>
+        bool tryEmplace(Logger::LogLevel level, Writer &&writer)
+        {
+            static_assert(std::is_nothrow_invocable_v<Writer &, Record &>,
+                          "the writer runs inside a claimed cell and must not throw");
+
+            std::size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            Cell *cell;
+
+            for (;;) {
+                cell = &m_cells[pos & m_mask];
+                const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos);
+
+                if (diff == 0) {
+                    if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_enqueuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            cell->record.level = level;
+            cell->record.spill = nullptr;
+            writer(cell->record);
+
+            // seq_cst for the writer deciding whether to sleep, see
+            // detail::Wakeup.
+            cell->sequence.store(pos + 1, std::memory_order_seq_cst);
+            return true;
+        }
+
+        // Hands the oldest record to visitor while it still sits in its
+        // cell, so the writer never copies it out. Returns false if empty.
+        template<typename Visitor>
+        bool tryPop(Visitor &&visitor)
+        {
+            std::size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+            Cell *cell;
+
+            for (;;) {
+                cell = &m_cells[pos & m_mask];
+                const std::size_t seq = cell->sequence.load(std::memory_order_acquire);
+                const auto diff = static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos + 1);
+
+                if (diff == 0) {
+                    if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = m_dequeuePos.load(std::memory_order_relaxed);
+                }
+            }
+
+            visitor(static_cast<const Record &>(cell->record));
+
+            cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        // True until the oldest record is published, for the writer
+        // deciding whether to sleep.
+        [[nodiscard]] bool isEmpty() const
+        {
+            const std::size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+            return m_cells[pos & m_mask].sequence.load(std::memory_order_seq_cst) != pos + 1;
+        }
+
+        // True while a push would fail, for producers deciding to wait.
+        [[nodiscard]] bool isFull() const
+        {
+            const std::size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+            const std::size_t seq = m_cells[pos & m_mask].sequence.load(std::memory_order_acquire);
+            return static_cast<std::intptr_t>(seq) - static_cast<std::intptr_t>(pos) < 0;
+        }
+
+        // Number of pushes that have claimed a cell so far.
+        [[nodiscard]] std::size_t getEnqueuedCount() const
+        {
+            return m_enqueuePos.load(std::memory_order_acquire);
+        }
+
+        [[nodiscard]] std::size_t getCapacity() const { return m_mask + 1; }
+
+    private:
+        struct alignas(64) Cell
+        {
+            std::atomic<std::size_t> sequence{0};
+            Record record;
+        };
+
+        static std::size_t roundUpToPowerOfTwo(std::size_t value)
+        {
+            std::size_t result = 2;
+            while (result < value) {
+                result <<= 1U;
+            }
+            return result;
+        }
+
+        const std::size_t m_mask;
+        std::unique_ptr<Cell[]> m_cells;
+
+        // Producers and the consumer hammer different ends of the queue,
+        // keep the two positions on separate cache lines.
+        alignas(64) std::atomic<std::size_t> m_enqueuePos{0};
+        alignas(64) std::atomic<std::size_t> m_dequeuePos{0};
+    };
+
+// -----------------------------------------------------------------------------
+    class AsyncLogger final : public Logger
+    {
+    public:
+        enum class OverflowPolicy : char {
+            BLOCK = 0, DROP_NEWEST, DROP_OLDEST
+        };
+
+        AsyncLogger() = delete;
+
+        /**************************************************************
+         * @brief Decorates backend so that logging calls only copy the
+         * message into a bounded queue, a writer thread owned by this
+         * logger drains the queue and calls backend. Lines are stamped
+         * with the time the record was logged, not written.
+         *
+         * @Note: backend must outlive the AsyncLogger, it is only ever
+         * called from the writer thread (or from the caller once
+         * shutdown() has been called).
+         *************************************************************/
+        [[maybe_unused]] explicit AsyncLogger(
+                Logger &backend,
+                std::size_t queueCapacity = 8192,
+                OverflowPolicy overflowPolicy = OverflowPolicy::BLOCK)
+                : Logger(backend.getLogLevel()),
+                  m_backend(backend),
+                  m_overflowPolicy(overflowPolicy),
+                  m_queue(queueCapacity)
+        {
+            m_worker = std::thread([this] { run(); });
+        }
+
+        ~AsyncLogger() override { shutdown(); }
+
+        AsyncLogger(const AsyncLogger &) = delete;            // non construction-copyable
+        AsyncLogger(AsyncLogger &&) = delete;                 // non movable
+        AsyncLogger &operator=(const AsyncLogger &) = delete; // non copyable
+        AsyncLogger &operator=(AsyncLogger &&) = delete;      // move assignment
+
+    private:
+        Logger &m_backend;
+        const OverflowPolicy m_overflowPolicy;
+        AsyncRecordQueue m_queue;
+        detail::PerThread<RecordArena> m_arenas{[] { return std::make_unique<RecordArena>(); }};
+        std::string m_message;  // the writer's, reused for every record
+
+        // Records that have left the queue, written or dropped.
+        alignas(64) std::atomic<std::uint64_t> m_completed{0};
+        std::atomic<int> m_flushWaiters{0};
+        std::atomic<int> m_spaceWaiters{0};
+        std::atomic<bool> m_stopped{false};
+
+        detail::Wakeup m_wakeup;
+        std::condition_variable m_drained;
+        std::condition_variable m_spaceAvailable;
+        bool m_wakeRequested{false};
+        bool m_stopRequested{false};
+
+        std::thread m_worker;
+
+        static constexpr int SpinsBeforeWaiting = 16;
+        static constexpr std::uint64_t SpaceNotifyInterval = 64;
+
+    public:
+        // Getters -------------------------------------------------------------
+        [[nodiscard]] OverflowPolicy getOverflowPolicy() const { return m_overflowPolicy; }
+
+        // ---------------------------------------------------------------------
+        // Records discarded by DROP_NEWEST or DROP_OLDEST since construction.
+        [[nodiscard]] std::uint64_t getDroppedCount() const
+        {
+            return getMetrics().dropped;
+        }
+
+        // ---------------------------------------------------------------------
+        void log(LogLevel level, const std::string &message) override { push(level, message); }
+
+        // ---------------------------------------------------------------------
+        // Formats into this thread's line buffer before a queue cell is
+        // claimed, a formatter that throws or takes its time then holds up
+        // nobody but the caller.
+        void vlog(LogLevel level, fmt::string_view format, fmt::format_args args) override
+        {
+            if (!m_backend.isEnabled(level)) {
+                return;
+            }
+            auto &buffer = detail::lineBuffer();
+            buffer.clear();
+            fmt::vformat_to(std::back_inserter(buffer), format, args);
+            const std::string_view message(buffer.data(), buffer.size());
+
+            push(level, message, [&] { m_backend.log(level, std::string(message)); });
+        }
+
+        // ---------------------------------------------------------------------
+        // Returns once every record pushed before the call has been written
+        // (or dropped) and the backend has been flushed.
+        void flush() override
+        {
+            if (m_stopped.load(std::memory_order_acquire)) {
+                m_backend.flush();
+                return;
+            }
+
+            const std::uint64_t target = m_queue.getEnqueuedCount();
+
+            std::unique_lock<std::mutex> guard(m_wakeup.getMutex());
+            m_flushWaiters.fetch_add(1);
+            m_wakeRequested = true;
+            m_wakeup.wake();
+            m_drained.wait(guard, [&] { return m_completed.load() >= target; });
+            m_flushWaiters.fetch_sub(1);
+            guard.unlock();
+
+            m_backend.flush();
+        }
+
+        // ---------------------------------------------------------------------
+        // What the backend has buffered goes first, then what is still
+        // queued is written raw to fd as "[LEVEL]: message" lines, there
+        // is no formatting it safely in a signal handler.
+        void flushFromSignal(int fd) override
+        {
+            m_backend.flushFromSignal(fd);
+
+            while (m_queue.tryPop([fd](const AsyncRecordQueue::Record &record) {
+                const std::string_view tag = getLevelTag(record.level);
+                detail::writeFromSignal(fd, tag.data(), tag.size());
+                if (record.spill == nullptr) {
+                    detail::writeFromSignal(fd, record.text, record.length);
+                }
+                for (const RecordArena::Block *block = record.spill; block != nullptr; block = block->next) {
+                    detail::writeFromSignal(fd, block->data(), block->used);
+                }
+                detail::writeFromSignal(fd, "\n", 1);
+            })) {
+            }
+        }
+
+        // ---------------------------------------------------------------------
+        // Drains the queue and stops the writer thread. Anything logged
+        // afterwards goes straight to the backend on the caller's thread.
+        void shutdown()
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+                if (m_stopRequested) {
+                    return;
+                }
+                m_stopRequested = true;
+            }
+            m_wakeup.wake();
+
+            if (m_worker.joinable()) {
+                m_worker.join();
+            }
+            m_stopped.store(true, std::memory_order_release);
+            {
+                std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+                m_spaceAvailable.notify_all();
+            }
+
+            // Pushes that raced with the writer's final drain.
+            drain();
+            m_backend.flush();
+        }
+
+    private:
+        // ---------------------------------------------------------------------
+        void push(LogLevel level, const std::string &message)
+        {
+            push(level, message, [&] { m_backend.log(level, message); });
+        }
+
+        // ---------------------------------------------------------------------
+        // Copies message into a claimed cell, direct writes the record to
+        // the backend on this thread once the writer thread has stopped.
+        template<typename Direct>
+        void push(LogLevel level, std::string_view message, Direct &&direct)
+        {
+            // Don't queue what the backend would throw away.
+            if (!m_backend.isEnabled(level)) {
+                return;
+            }
+
+            if (m_stopped.load(std::memory_order_acquire)) {
+                direct();
+                return;
+            }
+
+            timespec now{};
+            ::clock_gettime(CLOCK_REALTIME, &now);
+
+            // A long message goes into this thread's arena before a cell
+            // is claimed, allocating may throw. Only the chain is queued.
+            RecordArena::Block *spill = nullptr;
+            if (message.size() > AsyncRecordQueue::MessageCapacity) {
+                spill = m_arenas.local().allocate(message.size());
+                RecordArena::copyInto(spill, message);
+            }
+            auto unqueued = [spill] {
+                if (spill != nullptr) {
+                    RecordArena::ReturnBatch().add(spill);
+                }
+            };
+
+            auto writer = [message, spill, &now](AsyncRecordQueue::Record &record) noexcept {
+                record.time = now;
+                record.length = static_cast<std::uint32_t>(message.size());
+                if (spill == nullptr) {
+                    std::memcpy(record.text, message.data(), message.size());
+                } else {
+                    record.spill = spill;
+                }
+            };
+
+            std::optional<std::chrono::steady_clock::time_point> blockedSince;
+            int spins = 0;
+            while (!m_queue.tryEmplace(level, writer)) {
+                switch (m_overflowPolicy) {
+                    case OverflowPolicy::BLOCK:
+                        if (!blockedSince) {
+                            blockedSince = std::chrono::steady_clock::now();
+                        }
+                        if (m_stopped.load(std::memory_order_acquire)) {
+                            m_metrics.countBlocked(std::chrono::steady_clock::now() - *blockedSince);
+                            unqueued();
+                            direct();
+                            return;
+                        }
+                        if (spins < SpinsBeforeWaiting) {
+                            ++spins;
+                            std::this_thread::yield();
+                        } else {
+                            waitForSpace();
+                        }
+                        break;
+                    case OverflowPolicy::DROP_NEWEST:
+                        unqueued();
+                        m_metrics.countDropped();
+                        return;
+                    case OverflowPolicy::DROP_OLDEST:
+                        if (m_queue.tryPop([](const AsyncRecordQueue::Record &record) {
+                            if (record.spill != nullptr) {
+                                RecordArena::ReturnBatch().add(record.spill);
+                            }
+                        })) {
+                            m_metrics.countDropped();
+                            m_completed.fetch_add(1);
+                        }
+                        break;
+                }
+            }
+
+            m_wakeup.notify();
+
+            if (blockedSince) {
+                m_metrics.countBlocked(std::chrono::steady_clock::now() - *blockedSince);
+            }
+            m_metrics.countRecord(static_cast<std::size_t>(level));
+        }
+
+        // ---------------------------------------------------------------------
+        // BLOCK once yielding hasn't helped: sleeps until the writer has
+        // made room or stopped.
+        void waitForSpace()
+        {
+            // Read-modify-writes on both sides, so either the writer sees
+            // us waiting or we see the room it made.
+            m_spaceWaiters.fetch_add(1, std::memory_order_acq_rel);
+
+            std::unique_lock<std::mutex> guard(m_wakeup.getMutex());
+            m_spaceAvailable.wait(guard, [this] {
+                return !m_queue.isFull() || m_stopped.load(std::memory_order_acquire);
+            });
+            guard.unlock();
+            m_spaceWaiters.fetch_sub(1);
+        }
+
+        // ---------------------------------------------------------------------
+        // Wakes the producers waiting for space, if there are any.
+        void notifySpace()
+        {
+            if (m_spaceWaiters.fetch_add(0, std::memory_order_acq_rel) != 0) {
+                std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+                m_spaceAvailable.notify_all();
+            }
+        }
+
+        // ---------------------------------------------------------------------
+        std::uint64_t drain()
+        {
+            std::uint64_t count = 0;
+            RecordArena::ReturnBatch returned;
+
+            // Waiting, or being written by a producer about to finish.
+            m_metrics.noteQueueDepth(m_queue.getEnqueuedCount() - m_completed.load());
+
+            while (m_queue.tryPop([&](const AsyncRecordQueue::Record &record) {
+                if (record.spill == nullptr) {
+                    m_message.assign(record.text, record.length);
+                } else {
+                    m_message.clear();
+                    RecordArena::appendTo(m_message, record.spill);
+                    returned.add(record.spill);
+                }
+                m_backend.logAt(record.level, record.time, m_message);
+            })) {
+                if (++count % SpaceNotifyInterval == 0) {
+                    notifySpace();
+                }
+            }
+
+            if (count != 0) {
+                m_completed.fetch_add(count);
+                notifySpace();
+            }
+            return count;
+        }
+
+        // ---------------------------------------------------------------------
+        void run()
+        {
+            for (;;) {
+                const std::uint64_t written = drain();
+
+                if (m_flushWaiters.load() != 0) {
+                    std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+                    m_drained.notify_all();
+                }
+
+                if (written != 0) {
+                    continue;
+                }
+
+                // Asleep until a push finds it so, or a flush or a stop.
+                std::unique_lock<std::mutex> guard(m_wakeup.getMutex());
+                if (m_stopRequested) {
+                    break;
+                }
+                m_wakeup.sleep(guard, [this] {
+                    return m_wakeRequested || m_stopRequested || !m_queue.isEmpty();
+                });
+                m_wakeRequested = false;
+            }
+
+            // Anything pushed while we were stopping.
+            drain();
+            std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+            m_drained.notify_all();
+        }
+    };
+}// namespace gc
+
+#endif //GCLOG_ASYNCLOGGER_HPP
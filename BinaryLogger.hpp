@@ -0,0 +1,1102 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: BinaryLogger.hpp                                            //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_BINARYLOGGER_HPP
+#define GCLOG_BINARYLOGGER_HPP
+
+#include "Logger.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <istream>
+#include <string_view>
+#include <type_traits>
+
+#include <fmt/args.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+namespace gc {
+namespace binlog {
+    // Argument encodings. Integers are widened to 64 bits and floating
+    // point to double, strings are copied as a u32 length and the bytes.
+    enum class ArgType : std::uint8_t {
+        BOOL = 0, CHAR, INT64, UINT64, DOUBLE, STRING
+    };
+
+    template<typename T>
+    inline constexpr bool AlwaysFalse = false;
+
+    template<typename T>
+    constexpr ArgType argTypeOf() {
+        using U = std::remove_cvref_t<T>;
+        if constexpr (std::is_same_v<U, bool>) {
+            return ArgType::BOOL;
+        } else if constexpr (std::is_same_v<U, char>) {
+            return ArgType::CHAR;
+        } else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>) {
+            return ArgType::INT64;
+        } else if constexpr (std::is_integral_v<U>) {
+            return ArgType::UINT64;
+        } else if constexpr (std::is_floating_point_v<U>) {
+            return ArgType::DOUBLE;
+        } else if constexpr (std::is_convertible_v<const U &, std::string_view>) {
+            return ArgType::STRING;
+        } else {
+            static_assert(AlwaysFalse<U>, "gclog: binary logging only takes arithmetic and string arguments");
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    template<typename T>
+    std::size_t encodedSize(const T &value) {
+        constexpr ArgType type = argTypeOf<T>();
+        if constexpr (type == ArgType::STRING) {
+            return sizeof(std::uint32_t) + std::string_view(value).size();
+        } else if constexpr (type == ArgType::BOOL || type == ArgType::CHAR) {
+            return 1;
+        } else {
+            return 8;
+        }
+    }
+
+    template<typename T>
+    char *encode(char *out, const T &value) {
+        constexpr ArgType type = argTypeOf<T>();
+        if constexpr (type == ArgType::BOOL || type == ArgType::CHAR) {
+            *out = static_cast<char>(value);
+            return out + 1;
+        } else if constexpr (type == ArgType::INT64) {
+            const auto widened = static_cast<std::int64_t>(value);
+            std::memcpy(out, &widened, sizeof(widened));
+            return out + sizeof(widened);
+        } else if constexpr (type == ArgType::UINT64) {
+            const auto widened = static_cast<std::uint64_t>(value);
+            std::memcpy(out, &widened, sizeof(widened));
+            return out + sizeof(widened);
+        } else if constexpr (type == ArgType::DOUBLE) {
+            const auto widened = static_cast<double>(value);
+            std::memcpy(out, &widened, sizeof(widened));
+            return out + sizeof(widened);
+        } else {
+            const std::string_view text(value);
+            const auto length = static_cast<std::uint32_t>(text.size());
+            std::memcpy(out, &length, sizeof(length));
+            std::memcpy(out + sizeof(length), text.data(), text.size());
+            return out + sizeof(length) + text.size();
+        }
+    }
+
+// -----------------------------------------------------------------------------
+    // Everything about a log statement that doesn't change between calls,
+    // recorded once and referred to by id afterwards.
+    struct CallSite
+    {
+        std::uint32_t id{0};
+        Logger::LogLevel level{Logger::LogLevel::INFO};
+        std::string format;
+        std::string file;
+        std::uint32_t line{0};
+        std::vector<ArgType> types;
+    };
+
+    // Process wide table of call sites, ids start at 1.
+    class CallSiteRegistry
+    {
+    public:
+        static CallSiteRegistry &instance() {
+            static CallSiteRegistry registry;
+            return registry;
+        }
+
+        std::uint32_t add(CallSite site) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            site.id = static_cast<std::uint32_t>(m_sites.size() + 1);
+            const CallSite &added = m_sites.emplace_back(std::move(site));
+
+            const std::size_t index = added.id - 1;
+            if (index < ChunkSize * m_index.size()) {
+                Chunk *chunk = m_index[index / ChunkSize].load(std::memory_order_relaxed);
+                if (chunk == nullptr) {
+                    chunk = &m_chunks.emplace_back();
+                    m_index[index / ChunkSize].store(chunk, std::memory_order_release);
+                }
+                (*chunk)[index % ChunkSize].store(&added, std::memory_order_release);
+            }
+            return added.id;
+        }
+
+        // Sites are never removed and a deque never moves its elements,
+        // so the pointer stays valid. Takes no lock, a crash handler
+        // looks sites up too.
+        [[nodiscard]] const CallSite *find(std::uint32_t id) const {
+            const std::size_t index = std::size_t{id} - 1;
+            if (id == 0 || index >= ChunkSize * m_index.size()) {
+                return nullptr;
+            }
+            const Chunk *chunk = m_index[index / ChunkSize].load(std::memory_order_acquire);
+            return chunk == nullptr ? nullptr : (*chunk)[index % ChunkSize].load(std::memory_order_acquire);
+        }
+
+    private:
+        // Site pointers by id in chunks made as ids reach them, enough
+        // chunks for 1 << 20 sites, more than any program has.
+        static constexpr std::size_t ChunkSize = 1024;
+        using Chunk = std::array<std::atomic<const CallSite *>, ChunkSize>;
+
+        mutable std::mutex m_mutex;
+        std::deque<CallSite> m_sites;
+        std::deque<Chunk> m_chunks;
+        std::array<std::atomic<Chunk *>, 1024> m_index{};
+    };
+
+// -----------------------------------------------------------------------------
+    // Formats a record's message from its call site and encoded payload.
+    // Returns false if the payload doesn't match the call site.
+    inline bool appendMessage(fmt::memory_buffer &out, const CallSite &site,
+                              std::string_view payload) {
+        fmt::dynamic_format_arg_store<fmt::format_context> args;
+        args.reserve(site.types.size(), 0);
+
+        const char *pos = payload.data();
+        const char *const end = pos + payload.size();
+        auto take = [&](auto &value) {
+            if (static_cast<std::size_t>(end - pos) < sizeof(value)) {
+                return false;
+            }
+            std::memcpy(&value, pos, sizeof(value));
+            pos += sizeof(value);
+            return true;
+        };
+
+        for (const ArgType type : site.types) {
+            switch (type) {
+                case ArgType::BOOL: {
+                    char value{};
+                    if (!take(value)) return false;
+                    args.push_back(value != 0);
+                    break;
+                }
+                case ArgType::CHAR: {
+                    char value{};
+                    if (!take(value)) return false;
+                    args.push_back(value);
+                    break;
+                }
+                case ArgType::INT64: {
+                    std::int64_t value{};
+                    if (!take(value)) return false;
+                    args.push_back(value);
+                    break;
+                }
+                case ArgType::UINT64: {
+                    std::uint64_t value{};
+                    if (!take(value)) return false;
+                    args.push_back(value);
+                    break;
+                }
+                case ArgType::DOUBLE: {
+                    double value{};
+                    if (!take(value)) return false;
+                    args.push_back(value);
+                    break;
+                }
+                case ArgType::STRING: {
+                    std::uint32_t length{};
+                    if (!take(length) || static_cast<std::size_t>(end - pos) < length) {
+                        return false;
+                    }
+                    // The payload outlives the vformat_to below.
+                    args.push_back(fmt::string_view(pos, length));
+                    pos += length;
+                    break;
+                }
+            }
+        }
+
+        try {
+            fmt::vformat_to(std::back_inserter(out), site.format, args);
+        } catch (const fmt::format_error &) {
+            return false;
+        }
+        return true;
+    }
+
+    // -------------------------------------------------------------------------
+    // Renders a record as the line the text loggers would have written,
+    // using format's date/time settings.
+    inline void appendLine(fmt::memory_buffer &out, const Logger &format,
+                           const CallSite &site, const timespec &time,
+                           std::string_view payload) {
+        const std::string_view tag = Logger::getLevelTag(site.level);
+        out.append(tag.data(), tag.data() + tag.size());
+        if (!appendMessage(out, site, payload)) {
+            constexpr std::string_view garbled = "<undecodable record>";
+            out.append(garbled.data(), garbled.data() + garbled.size());
+        }
+        char stamp[Time::MaxFormattedSize];
+        out.append(stamp, stamp + format.writeDateTime(stamp, time));
+        out.push_back('\n');
+    }
+
+// -----------------------------------------------------------------------------
+    // Binary file layout, all integers in the writer's native byte order:
+    //
+    //   "GCLOGB1\n"
+    //   'M' u32 id, u8 level, u32 line, u16 argc, argc x u8 type,
+    //       u32 length + format, u32 length + file     (once per call site)
+    //   'R' u32 id, u64 nanoseconds since epoch, u32 length + payload
+    //
+    // Each logger opening the file appends a segment of its own, starting
+    // with the magic again. Ids are the writing process's, so a segment
+    // starts with no call sites known.
+    inline constexpr std::string_view FileMagic = "GCLOGB1\n";
+
+    // More call sites than a program has, ids past it mark a corrupt file.
+    inline constexpr std::uint32_t MaxSiteId = 1U << 20U;
+
+    template<typename T>
+    void appendRaw(fmt::memory_buffer &out, const T &value) {
+        const auto *bytes = reinterpret_cast<const char *>(&value);
+        out.append(bytes, bytes + sizeof(value));
+    }
+
+    inline void appendString(fmt::memory_buffer &out, std::string_view text) {
+        appendRaw(out, static_cast<std::uint32_t>(text.size()));
+        out.append(text.data(), text.data() + text.size());
+    }
+
+    inline void appendSiteEntry(fmt::memory_buffer &out, const CallSite &site) {
+        out.push_back('M');
+        appendRaw(out, site.id);
+        appendRaw(out, static_cast<std::uint8_t>(site.level));
+        appendRaw(out, site.line);
+        appendRaw(out, static_cast<std::uint16_t>(site.types.size()));
+        for (const ArgType type : site.types) {
+            appendRaw(out, static_cast<std::uint8_t>(type));
+        }
+        appendString(out, site.format);
+        appendString(out, site.file);
+    }
+
+    inline void appendRecordEntry(fmt::memory_buffer &out, std::uint32_t id,
+                                  std::uint64_t nanoseconds, std::string_view payload) {
+        out.push_back('R');
+        appendRaw(out, id);
+        appendRaw(out, nanoseconds);
+        appendString(out, payload);
+    }
+
+    // -------------------------------------------------------------------------
+    // The same two entries written straight to fd from a crash handler,
+    // nothing allocated.
+    inline void writeSiteEntry(int fd, const CallSite &site) {
+        static_assert(sizeof(ArgType) == 1);
+        const auto level = static_cast<std::uint8_t>(site.level);
+        const auto argc = static_cast<std::uint16_t>(site.types.size());
+        const auto formatLength = static_cast<std::uint32_t>(site.format.size());
+        const auto fileLength = static_cast<std::uint32_t>(site.file.size());
+
+        char head[1 + sizeof(site.id) + sizeof(level) + sizeof(site.line) + sizeof(argc)];
+        head[0] = 'M';
+        std::memcpy(head + 1, &site.id, sizeof(site.id));
+        std::memcpy(head + 5, &level, sizeof(level));
+        std::memcpy(head + 6, &site.line, sizeof(site.line));
+        std::memcpy(head + 10, &argc, sizeof(argc));
+
+        iovec parts[]{
+                {head, sizeof(head)},
+                {const_cast<ArgType *>(site.types.data()), site.types.size()},
+                {const_cast<std::uint32_t *>(&formatLength), sizeof(formatLength)},
+                {const_cast<char *>(site.format.data()), site.format.size()},
+                {const_cast<std::uint32_t *>(&fileLength), sizeof(fileLength)},
+                {const_cast<char *>(site.file.data()), site.file.size()}};
+        detail::writeAll(fd, parts, std::size(parts));
+    }
+
+    inline void writeRecordEntry(int fd, std::uint32_t id, std::uint64_t nanoseconds,
+                                 std::string_view payload) {
+        const auto length = static_cast<std::uint32_t>(payload.size());
+        char head[1 + sizeof(id) + sizeof(nanoseconds) + sizeof(length)];
+        head[0] = 'R';
+        std::memcpy(head + 1, &id, sizeof(id));
+        std::memcpy(head + 5, &nanoseconds, sizeof(nanoseconds));
+        std::memcpy(head + 13, &length, sizeof(length));
+
+        iovec parts[]{{head, sizeof(head)}, {const_cast<char *>(payload.data()), payload.size()}};
+        detail::writeAll(fd, parts, std::size(parts));
+    }
+
+    // -------------------------------------------------------------------------
+    // Reads a binary log written by BinaryLogger and calls
+    // onRecord(const CallSite &, const timespec &, std::string_view payload)
+    // for each record. Returns false if the stream is not a binary log or
+    // ends in the middle of an entry.
+    template<typename OnRecord>
+    bool readFile(std::istream &in, OnRecord &&onRecord) {
+        char magic[FileMagic.size()];
+        if (!in.read(magic, sizeof(magic)) || std::string_view(magic, sizeof(magic)) != FileMagic) {
+            return false;
+        }
+
+        auto read = [&in](auto &value) {
+            return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+        };
+        auto readString = [&](std::string &text) {
+            std::uint32_t length{};
+            if (!read(length)) {
+                return false;
+            }
+            text.resize(length);
+            return length == 0 || static_cast<bool>(in.read(text.data(), length));
+        };
+
+        std::vector<CallSite> sites;
+        std::string payload;
+        char kind{};
+
+        while (in.get(kind)) {
+            if (kind == FileMagic.front()) {
+                if (!in.read(magic + 1, sizeof(magic) - 1)
+                    || std::string_view(magic, sizeof(magic)) != FileMagic) {
+                    return false;
+                }
+                sites.clear();
+            } else if (kind == 'M') {
+                CallSite site;
+                std::uint8_t level{};
+                std::uint16_t argc{};
+                if (!read(site.id) || !read(level) || !read(site.line) || !read(argc)) {
+                    return false;
+                }
+                site.level = static_cast<Logger::LogLevel>(level);
+                for (std::uint16_t i = 0; i < argc; ++i) {
+                    std::uint8_t type{};
+                    if (!read(type)) {
+                        return false;
+                    }
+                    site.types.push_back(static_cast<ArgType>(type));
+                }
+                if (!readString(site.format) || !readString(site.file)) {
+                    return false;
+                }
+                // Sites can arrive out of order, ids are only bounded.
+                if (site.id == 0 || site.id > MaxSiteId) {
+                    return false;
+                }
+                if (sites.size() < site.id) {
+                    sites.resize(site.id);
+                }
+                sites[site.id - 1] = std::move(site);
+            } else if (kind == 'R') {
+                std::uint32_t id{};
+                std::uint64_t nanoseconds{};
+                if (!read(id) || !read(nanoseconds) || !readString(payload)) {
+                    return false;
+                }
+                if (id == 0 || id > sites.size() || sites[id - 1].id != id) {
+                    return false;
+                }
+                timespec time{};
+                time.tv_sec = static_cast<time_t>(nanoseconds / 1000000000U);
+                time.tv_nsec = static_cast<long>(nanoseconds % 1000000000U);
+                onRecord(static_cast<const CallSite &>(sites[id - 1]), time,
+                         std::string_view(payload));
+            } else {
+                return false;
+            }
+        }
+        return true;
+    }
+
+// -----------------------------------------------------------------------------
+    // Raw timestamps for the hot path. On x86 this is the TSC, which the
+    // writer thread maps back to wall clock time, elsewhere it is
+    // CLOCK_REALTIME in nanoseconds.
+    class TickClock
+    {
+    public:
+        static std::uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return realtimeNanoseconds();
+#endif
+        }
+
+        static std::uint64_t realtimeNanoseconds() {
+            timespec time{};
+            ::clock_gettime(CLOCK_REALTIME, &time);
+            return static_cast<std::uint64_t>(time.tv_sec) * 1000000000U
+                   + static_cast<std::uint64_t>(time.tv_nsec);
+        }
+
+        TickClock() : m_baseTicks(now()), m_baseNanoseconds(realtimeNanoseconds()) {}
+
+        // Re-measures the tick rate against the wall clock over everything
+        // since construction. Called by the writer thread now and then,
+        // assumes an invariant TSC.
+        void calibrate() {
+#if defined(__x86_64__) || defined(__i386__)
+            const std::uint64_t ticks = now();
+            const std::uint64_t nanoseconds = realtimeNanoseconds();
+            if (nanoseconds > m_baseNanoseconds && ticks > m_baseTicks) {
+                m_ticksPerNanosecond = static_cast<double>(ticks - m_baseTicks)
+                                       / static_cast<double>(nanoseconds - m_baseNanoseconds);
+            }
+#endif
+        }
+
+        [[nodiscard]] std::uint64_t toNanoseconds(std::uint64_t ticks) const {
+#if defined(__x86_64__) || defined(__i386__)
+            const double offset = (static_cast<double>(ticks) - static_cast<double>(m_baseTicks))
+                                  / m_ticksPerNanosecond;
+            return static_cast<std::uint64_t>(static_cast<double>(m_baseNanoseconds) + offset);
+#else
+            return ticks;
+#endif
+        }
+
+    private:
+        std::uint64_t m_baseTicks;
+        std::uint64_t m_baseNanoseconds;
+        double m_ticksPerNanosecond{1.0};
+    };
+
+// -----------------------------------------------------------------------------
+    // Single producer, single consumer byte ring holding one thread's
+    // records. Each record starts with a Header and is padded to 8 bytes,
+    // a header with id 0 marks the unused tail before a wrap.
+    class ThreadBuffer
+    {
+    public:
+        struct Header
+        {
+            std::uint32_t size;
+            std::uint32_t id;
+            std::uint64_t ticks;
+        };
+
+        explicit ThreadBuffer(std::size_t capacity)
+                : m_capacity(roundUp(capacity)),
+                  m_data(std::make_unique<char[]>(m_capacity)) {}
+
+        // Producer side ---------------------------------------------------
+        //
+        // Space for a record of size bytes (header included), or nullptr if
+        // the ring is full. Must be followed by commit().
+        char *reserve(std::size_t size) {
+            size = alignedSize(size);
+            const std::uint64_t head = m_head.load(std::memory_order_relaxed);
+            const std::size_t offset = head & (m_capacity - 1);
+            const std::size_t contiguous = m_capacity - offset;
+            const std::size_t padding = size > contiguous ? contiguous : 0;
+
+            if (head + padding + size - m_cachedTail > m_capacity) {
+                m_cachedTail = m_tail.load(std::memory_order_acquire);
+                if (head + padding + size - m_cachedTail > m_capacity) {
+                    return nullptr;
+                }
+            }
+
+            if (padding != 0) {
+                const Header marker{static_cast<std::uint32_t>(padding), 0, 0};
+                std::memcpy(m_data.get() + offset, &marker, sizeof(std::uint32_t) * 2);
+                m_reserved = head + padding;
+                return m_data.get();
+            }
+            m_reserved = head;
+            return m_data.get() + offset;
+        }
+
+        // seq_cst for a consumer deciding whether to sleep, see
+        // detail::Wakeup.
+        void commit(std::size_t size) {
+            m_head.store(m_reserved + alignedSize(size), std::memory_order_seq_cst);
+        }
+
+        // Consumer side ---------------------------------------------------
+        //
+        // Calls onRecord(const Header &, std::string_view payload) for each
+        // published record and returns how many there were.
+        template<typename OnRecord>
+        std::size_t drain(OnRecord &&onRecord) {
+            const std::uint64_t head = m_head.load(std::memory_order_acquire);
+            std::uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            std::size_t count = 0;
+
+            while (tail < head) {
+                const char *record = m_data.get() + (tail & (m_capacity - 1));
+                Header header{};
+                std::memcpy(&header, record, sizeof(std::uint32_t) * 2);
+                if (header.id != 0) {
+                    std::memcpy(&header, record, sizeof(header));
+                    onRecord(static_cast<const Header &>(header),
+                             std::string_view(record + sizeof(Header), header.size - sizeof(Header)));
+                    ++count;
+                }
+                tail += alignedSize(header.size);
+            }
+
+            m_tail.store(tail, std::memory_order_release);
+            return count;
+        }
+
+        // -----------------------------------------------------------------
+        // drain() leaving the records in place, for a crash handler that
+        // can't wait for the consumer. One the consumer is draining at
+        // the same moment may come out twice.
+        template<typename OnRecord>
+        void peek(OnRecord &&onRecord) const {
+            const std::uint64_t head = m_head.load(std::memory_order_acquire);
+            for (std::uint64_t tail = m_tail.load(std::memory_order_acquire); tail < head;) {
+                const char *record = m_data.get() + (tail & (m_capacity - 1));
+                Header header{};
+                std::memcpy(&header, record, sizeof(std::uint32_t) * 2);
+                if (header.size < sizeof(std::uint32_t) * 2
+                    || header.size > m_capacity - (tail & (m_capacity - 1))) {
+                    return;  // overwritten under us
+                }
+                if (header.id != 0) {
+                    std::memcpy(&header, record, sizeof(header));
+                    onRecord(static_cast<const Header &>(header),
+                             std::string_view(record + sizeof(Header), header.size - sizeof(Header)));
+                }
+                tail += alignedSize(header.size);
+            }
+        }
+
+        // -----------------------------------------------------------------
+        // True until a record is committed that hasn't been consumed.
+        [[nodiscard]] bool isEmpty() const {
+            return m_head.load(std::memory_order_seq_cst) == m_tail.load(std::memory_order_relaxed);
+        }
+
+        // -----------------------------------------------------------------
+        // The oldest published record without consuming it, false if there
+        // is none. pop() consumes it. For a consumer taking records one at
+        // a time, e.g. merging several buffers, instead of drain().
+        bool front(Header &header, std::string_view &payload) {
+            for (;;) {
+                const std::uint64_t tail = m_tail.load(std::memory_order_relaxed);
+                if (tail >= m_cachedHead) {
+                    m_cachedHead = m_head.load(std::memory_order_acquire);
+                    if (tail >= m_cachedHead) {
+                        return false;
+                    }
+                }
+
+                const char *record = m_data.get() + (tail & (m_capacity - 1));
+                std::memcpy(&header, record, sizeof(std::uint32_t) * 2);
+                if (header.id != 0) {
+                    std::memcpy(&header, record, sizeof(header));
+                    payload = std::string_view(record + sizeof(Header), header.size - sizeof(Header));
+                    return true;
+                }
+                m_tail.store(tail + alignedSize(header.size), std::memory_order_release);
+            }
+        }
+
+        void pop() {
+            const std::uint64_t tail = m_tail.load(std::memory_order_relaxed);
+            std::uint32_t size = 0;
+            std::memcpy(&size, m_data.get() + (tail & (m_capacity - 1)), sizeof(size));
+            m_tail.store(tail + alignedSize(size), std::memory_order_release);
+        }
+
+        [[nodiscard]] std::size_t getCapacity() const { return m_capacity; }
+
+        static constexpr std::size_t alignedSize(std::size_t size) {
+            return (size + 7U) & ~std::size_t{7U};
+        }
+
+    private:
+        static std::size_t roundUp(std::size_t value) {
+            std::size_t result = 64;
+            while (result < value) {
+                result <<= 1U;
+            }
+            return result;
+        }
+
+        const std::size_t m_capacity;
+        std::unique_ptr<char[]> m_data;
+
+        // Producer's cache line.
+        alignas(64) std::atomic<std::uint64_t> m_head{0};
+        std::uint64_t m_reserved{0};
+        std::uint64_t m_cachedTail{0};
+
+        // Consumer's cache line.
+        alignas(64) std::atomic<std::uint64_t> m_tail{0};
+        std::uint64_t m_cachedHead{0};
+    };
+}// namespace binlog
+
+// -----------------------------------------------------------------------------
+    class BinaryLogger final : public Logger
+    {
+    public:
+        enum class Encoding : char {
+            TEXT = 0, BINARY
+        };
+        enum class OverflowPolicy : char {
+            BLOCK = 0, DROP_NEWEST
+        };
+
+        static constexpr std::size_t DefaultThreadBufferSize = 1U << 20U;
+
+        BinaryLogger() = delete;
+
+        /**************************************************************
+         * @brief Deferred logger: a GCLOG_BINARY_* statement copies its
+         * call site id, a raw timestamp and its arguments into the
+         * calling thread's buffer, a writer thread owned by the logger
+         * does all formatting and I/O.
+         *
+         * @Note: TEXT writes the same lines as the other loggers, BINARY
+         * writes the compact format read by gclog_decode. fd is not
+         * closed by the logger.
+         *************************************************************/
+        [[maybe_unused]] BinaryLogger(
+                LogLevel logLevel,
+                int fd,
+                Encoding encoding = Encoding::TEXT,
+                std::size_t threadBufferSize = DefaultThreadBufferSize,
+                OverflowPolicy overflowPolicy = OverflowPolicy::DROP_NEWEST)
+                : Logger(logLevel),
+                  m_fd(fd),
+                  m_encoding(encoding),
+                  m_overflowPolicy(overflowPolicy),
+                  m_buffers([threadBufferSize] {
+                      return std::make_unique<binlog::ThreadBuffer>(threadBufferSize);
+                  })
+        {
+            start();
+        }
+
+        // Appends to filename, a BINARY file as a new segment (see
+        // FileMagic). Throws std::system_error if it can't be opened.
+        [[maybe_unused]] BinaryLogger(
+                LogLevel logLevel,
+                const std::string &filename,
+                Encoding encoding = Encoding::BINARY,
+                std::size_t threadBufferSize = DefaultThreadBufferSize,
+                OverflowPolicy overflowPolicy = OverflowPolicy::DROP_NEWEST)
+                : BinaryLogger(logLevel, openFile(filename), encoding,
+                               threadBufferSize, overflowPolicy)
+        {
+            m_ownsFd = true;
+        }
+
+        ~BinaryLogger() override
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+                m_stopRequested = true;
+            }
+            m_wakeup.wake();
+            m_writer.join();
+
+            if (m_ownsFd) {
+                ::close(m_fd);
+            }
+        }
+
+        BinaryLogger(const BinaryLogger &) = delete;            // non construction-copyable
+        BinaryLogger(BinaryLogger &&) = delete;                 // non movable
+        BinaryLogger &operator=(const BinaryLogger &) = delete; // non copyable
+        BinaryLogger &operator=(BinaryLogger &&) = delete;      // move assignment
+
+    private:
+        int m_fd;
+        bool m_ownsFd{false};
+        const Encoding m_encoding;
+        const OverflowPolicy m_overflowPolicy;
+        detail::PerThread<binlog::ThreadBuffer> m_buffers;
+
+        // Writer thread state.
+        binlog::TickClock m_clock;
+        std::vector<binlog::ThreadBuffer *> m_snapshot;
+        std::vector<const binlog::CallSite *> m_sites;
+        std::vector<bool> m_sitesWritten;
+        fmt::memory_buffer m_output;
+        bool m_headerWritten{false};
+
+        detail::Wakeup m_wakeup;
+        std::condition_variable m_passDone;
+        std::uint64_t m_passes{0};
+        bool m_wakeRequested{false};
+        bool m_stopRequested{false};
+        std::thread m_writer;
+
+        static constexpr std::size_t OutputFlushSize = 64 * 1024;
+
+    public:
+        // ---------------------------------------------------------------------
+        // Called through the GCLOG_BINARY_* macros. Site is a lambda type
+        // unique to the statement, so the static below is registered once
+        // per statement no matter how many loggers it reaches.
+        template<typename Site, typename... Args>
+        void write(Site, LogLevel level, const char *file, std::uint32_t line,
+                   fmt::format_string<const Args &...> format, const Args &...args)
+        {
+            static const std::uint32_t id = registerSite<Args...>(level, fmt::string_view(format), file, line);
+            push(level, id, args...);
+        }
+
+        // ---------------------------------------------------------------------
+        // Plain messages are stored as a single string argument, each
+        // level from a call site of its own.
+        void log(LogLevel level, const std::string &message) override {
+            if (!isEnabled(level)) {
+                return;
+            }
+            switch (level) {
+                case LogLevel::TRACE:
+                    write([] {}, LogLevel::TRACE, __FILE__, __LINE__, "{}", message);
+                    break;
+                case LogLevel::DEBUG:
+                    write([] {}, LogLevel::DEBUG, __FILE__, __LINE__, "{}", message);
+                    break;
+                case LogLevel::INFO:
+                    write([] {}, LogLevel::INFO, __FILE__, __LINE__, "{}", message);
+                    break;
+                case LogLevel::WARN:
+                    write([] {}, LogLevel::WARN, __FILE__, __LINE__, "{}", message);
+                    break;
+                case LogLevel::ERROR:
+                    write([] {}, LogLevel::ERROR, __FILE__, __LINE__, "{}", message);
+                    break;
+            }
+        }
+
+        // ---------------------------------------------------------------------
+        // Type erased arguments can't be deferred, they are formatted here
+        // and stored like a plain message.
+        void vlog(LogLevel level, fmt::string_view format, fmt::format_args args) override
+        {
+            auto &buffer = detail::lineBuffer();
+            buffer.clear();
+            fmt::vformat_to(std::back_inserter(buffer), format, args);
+            log(level, std::string(buffer.data(), buffer.size()));
+        }
+
+        // ---------------------------------------------------------------------
+        // Returns once everything logged before the call has been written.
+        void flush() override
+        {
+            std::unique_lock<std::mutex> guard(m_wakeup.getMutex());
+            // A pass that was already running may have missed our records,
+            // the one after it can't have.
+            const std::uint64_t target = m_passes + 2;
+            m_wakeRequested = true;
+            m_wakeup.wake();
+            m_passDone.wait(guard, [&] { return m_passes >= target || m_stopRequested; });
+        }
+
+        // ---------------------------------------------------------------------
+        // Writes what the writer thread has encoded but not written yet
+        // and, in a BINARY file, every record still in a thread's buffer,
+        // encoded here without allocating. TEXT records would need
+        // formatting, CrashHandler::add() turns a TEXT logger down.
+        void flushFromSignal([[maybe_unused]] int fd) override
+        {
+            detail::writeFromSignal(m_fd, m_output.data(), m_output.size());
+            if (m_encoding != Encoding::BINARY) {
+                return;
+            }
+
+            if (!m_headerWritten) {
+                detail::writeFromSignal(m_fd, binlog::FileMagic.data(), binlog::FileMagic.size());
+                m_headerWritten = true;
+            }
+            // Sites new since the writer last grew m_sitesWritten, a
+            // few of them remembered here, past that written per record.
+            std::array<std::uint32_t, 64> newSites{};
+            std::size_t newSiteCount = 0;
+            auto isWritten = [&](std::uint32_t id) {
+                if (id < m_sitesWritten.size()) {
+                    return static_cast<bool>(m_sitesWritten[id]);
+                }
+                const std::uint32_t *first = newSites.data();
+                return std::find(first, first + newSiteCount, id) != first + newSiteCount;
+            };
+
+            m_buffers.forEachFromSignal([&](const binlog::ThreadBuffer &buffer) {
+                buffer.peek([&](const binlog::ThreadBuffer::Header &header, std::string_view payload) {
+                    const binlog::CallSite *site = binlog::CallSiteRegistry::instance().find(header.id);
+                    if (site == nullptr) {
+                        return;
+                    }
+                    if (!isWritten(header.id)) {
+                        binlog::writeSiteEntry(m_fd, *site);
+                        if (header.id < m_sitesWritten.size()) {
+                            m_sitesWritten[header.id] = true;
+                        } else if (newSiteCount < newSites.size()) {
+                            newSites[newSiteCount++] = header.id;
+                        }
+                    }
+                    binlog::writeRecordEntry(m_fd, header.id, m_clock.toNanoseconds(header.ticks), payload);
+                });
+            });
+        }
+
+        [[nodiscard]] bool flushesFromSignal() const override { return m_encoding == Encoding::BINARY; }
+
+        // ---------------------------------------------------------------------
+        // Records dropped because a thread's buffer was full.
+        [[nodiscard]] std::uint64_t getDroppedCount() const
+        {
+            return getMetrics().dropped;
+        }
+
+    private:
+        // ---------------------------------------------------------------------
+        static int openFile(const std::string &filename)
+        {
+            const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+            if (fd < 0) {
+                throw std::system_error(errno, std::generic_category(),
+                                        "gclog: can't open " + filename);
+            }
+            return fd;
+        }
+
+        // ---------------------------------------------------------------------
+        template<typename... Args>
+        static std::uint32_t registerSite(LogLevel level, fmt::string_view format,
+                                          const char *file, std::uint32_t line)
+        {
+            binlog::CallSite site;
+            site.level = level;
+            site.format.assign(format.data(), format.size());
+            site.file = file;
+            site.line = line;
+            site.types = {binlog::argTypeOf<Args>()...};
+            return binlog::CallSiteRegistry::instance().add(std::move(site));
+        }
+
+        // ---------------------------------------------------------------------
+        template<typename... Args>
+        void push(LogLevel level, std::uint32_t id, const Args &...args)
+        {
+            const std::uint64_t ticks = binlog::TickClock::now();
+            const std::size_t size = sizeof(binlog::ThreadBuffer::Header)
+                                     + (std::size_t{0} + ... + binlog::encodedSize(args));
+
+            binlog::ThreadBuffer &buffer = m_buffers.local();
+            if (size > buffer.getCapacity() / 2) {
+                m_metrics.countDropped();
+                return;
+            }
+
+            char *out = buffer.reserve(size);
+            if (out == nullptr) {
+                const auto blockedSince = std::chrono::steady_clock::now();
+                while (out == nullptr) {
+                    if (m_overflowPolicy == OverflowPolicy::DROP_NEWEST) {
+                        m_metrics.countDropped();
+                        return;
+                    }
+                    std::this_thread::yield();
+                    out = buffer.reserve(size);
+                }
+                m_metrics.countBlocked(std::chrono::steady_clock::now() - blockedSince);
+            }
+
+            const binlog::ThreadBuffer::Header header{static_cast<std::uint32_t>(size), id, ticks};
+            std::memcpy(out, &header, sizeof(header));
+            out += sizeof(header);
+            ((out = binlog::encode(out, args)), ...);
+
+            buffer.commit(size);
+            m_wakeup.notify();
+            m_metrics.countRecord(static_cast<std::size_t>(level));
+        }
+
+        // ---------------------------------------------------------------------
+        void start()
+        {
+            m_writer = std::thread([this] { run(); });
+        }
+
+        // ---------------------------------------------------------------------
+        const binlog::CallSite *findSite(std::uint32_t id)
+        {
+            if (id >= m_sites.size()) {
+                m_sites.resize(id + 1, nullptr);
+            }
+            if (m_sites[id] == nullptr) {
+                m_sites[id] = binlog::CallSiteRegistry::instance().find(id);
+            }
+            return m_sites[id];
+        }
+
+        // ---------------------------------------------------------------------
+        void handle(const binlog::ThreadBuffer::Header &header, std::string_view payload)
+        {
+            const binlog::CallSite *site = findSite(header.id);
+            if (site == nullptr) {
+                return;
+            }
+            const std::uint64_t nanoseconds = m_clock.toNanoseconds(header.ticks);
+
+            if (m_encoding == Encoding::TEXT) {
+                timespec time{};
+                time.tv_sec = static_cast<time_t>(nanoseconds / 1000000000U);
+                time.tv_nsec = static_cast<long>(nanoseconds % 1000000000U);
+                binlog::appendLine(m_output, *this, *site, time, payload);
+            } else {
+                if (!m_headerWritten) {
+                    m_output.append(binlog::FileMagic.data(),
+                                    binlog::FileMagic.data() + binlog::FileMagic.size());
+                    m_headerWritten = true;
+                }
+                if (header.id >= m_sitesWritten.size()) {
+                    m_sitesWritten.resize(header.id + 1, false);
+                }
+                if (!m_sitesWritten[header.id]) {
+                    binlog::appendSiteEntry(m_output, *site);
+                    m_sitesWritten[header.id] = true;
+                }
+                binlog::appendRecordEntry(m_output, header.id, nanoseconds, payload);
+            }
+
+            if (m_output.size() >= OutputFlushSize) {
+                writeOutput();
+            }
+        }
+
+        // ---------------------------------------------------------------------
+        void writeOutput()
+        {
+            if (m_output.size() == 0) {
+                return;
+            }
+            m_metrics.countBytes(m_output.size());
+            const auto start = std::chrono::steady_clock::now();
+
+            const char *data = m_output.data();
+            std::size_t remaining = m_output.size();
+            while (remaining != 0) {
+                const ssize_t written = ::write(m_fd, data, remaining);
+                if (written < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    break;
+                }
+                data += written;
+                remaining -= static_cast<std::size_t>(written);
+            }
+            m_output.clear();
+            m_metrics.countFlush(std::chrono::steady_clock::now() - start);
+        }
+
+        // ---------------------------------------------------------------------
+        std::size_t drainAll()
+        {
+            m_buffers.snapshot(m_snapshot);
+            std::size_t count = 0;
+            for (auto *buffer : m_snapshot) {
+                count += buffer->drain([this](const binlog::ThreadBuffer::Header &header,
+                                              std::string_view payload) {
+                    handle(header, payload);
+                });
+            }
+            writeOutput();
+            m_metrics.noteQueueDepth(count);
+            return count;
+        }
+
+        // ---------------------------------------------------------------------
+        bool hasRecords()
+        {
+            m_buffers.snapshot(m_snapshot);
+            return std::any_of(m_snapshot.begin(), m_snapshot.end(), [](const binlog::ThreadBuffer *buffer) {
+                return !buffer->isEmpty();
+            });
+        }
+
+        // ---------------------------------------------------------------------
+        void run()
+        {
+            // Give the tick rate a few milliseconds of baseline before the
+            // first record is converted, it is refined on every pass.
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+            for (;;) {
+                m_clock.calibrate();
+                const std::size_t count = drainAll();
+
+                std::unique_lock<std::mutex> guard(m_wakeup.getMutex());
+                ++m_passes;
+                m_passDone.notify_all();
+                if (m_stopRequested) {
+                    break;
+                }
+                if (count == 0) {
+                    // Asleep until a record is committed, or a flush or a stop.
+                    m_wakeup.sleep(guard, [this] {
+                        return m_wakeRequested || m_stopRequested || hasRecords();
+                    });
+                    m_wakeRequested = false;
+                }
+            }
+
+            drainAll();
+        }
+    };
+}// namespace gc
+
+// Binary logging macros -------------------------------------------------------
+//
+// GCLOG_BINARY_INFO(log, "user {} took {} ms", id, ms) with log a
+// gc::BinaryLogger. Arguments must be arithmetic or convertible to
+// std::string_view, they are copied raw and formatted on the writer thread.
+#define GCLOG_BINARY_LOG_AT_(logger, level, ...)                                \
+    do {                                                                       \
+        if constexpr (::gc::Logger::isCompiledIn(level)) {                     \
+            auto &gclogLogger_ = (logger);                                     \
+            if (gclogLogger_.isEnabled(level)) {                               \
+                gclogLogger_.write([] {}, level, __FILE__, __LINE__,           \
+                                   __VA_ARGS__);                               \
+            }                                                                  \
+        }                                                                      \
+    } while (false)
+
+#define GCLOG_BINARY_TRACE(logger, ...) \
+    GCLOG_BINARY_LOG_AT_(logger, ::gc::Logger::LogLevel::TRACE, __VA_ARGS__)
+#define GCLOG_BINARY_DEBUG(logger, ...) \
+    GCLOG_BINARY_LOG_AT_(logger, ::gc::Logger::LogLevel::DEBUG, __VA_ARGS__)
+#define GCLOG_BINARY_INFO(logger, ...) \
+    GCLOG_BINARY_LOG_AT_(logger, ::gc::Logger::LogLevel::INFO, __VA_ARGS__)
+#define GCLOG_BINARY_WARN(logger, ...) \
+    GCLOG_BINARY_LOG_AT_(logger, ::gc::Logger::LogLevel::WARN, __VA_ARGS__)
+#define GCLOG_BINARY_ERROR(logger, ...) \
+    GCLOG_BINARY_LOG_AT_(logger, ::gc::Logger::LogLevel::ERROR, __VA_ARGS__)
+
+#endif //GCLOG_BINARYLOGGER_HPP
@@ -0,0 +1,106 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: CategoryLogger.hpp                                          //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_CATEGORYLOGGER_HPP
+#define GCLOG_CATEGORYLOGGER_HPP
+
+#include "Logger.hpp"
+#include "Registry.hpp"
+
+#include <string>
+
+namespace gc {
+
+// -----------------------------------------------------------------------------
+// A named level in front of a shared backend, e.g. one for "net" and one
+// for "db" writing through the same SinkLogger, each with its own
+// threshold.
+//
+// The category decides alone, records it lets through go to the backend's
+// vlog()/vlogFields() without the backend's level being tested again.
+class CategoryLogger final : public Logger
+{
+public:
+    CategoryLogger() = delete;
+
+    // backend must outlive the category.
+    [[maybe_unused]] CategoryLogger(std::string name, Logger &backend, LogLevel logLevel)
+            : Logger(logLevel), m_name(std::move(name)), m_backend(backend) {}
+
+    ~CategoryLogger() override = default;
+
+    CategoryLogger(const CategoryLogger &) = delete;            // non construction-copyable
+    CategoryLogger(CategoryLogger &&) = delete;                 // non movable
+    CategoryLogger &operator=(const CategoryLogger &) = delete; // non copyable
+    CategoryLogger &operator=(CategoryLogger &&) = delete;      // move assignment
+
+private:
+    const std::string m_name;
+    Logger &m_backend;
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] const std::string &getName() const { return m_name; }
+
+    [[nodiscard]] Logger &getBackend() const { return m_backend; }
+
+    // -------------------------------------------------------------------------
+    void log(LogLevel level, const std::string &message) override { write(level, message); }
+
+    // -------------------------------------------------------------------------
+    void flush() override { m_backend.flush(); }
+
+    void flushFromSignal(int fd) override { m_backend.flushFromSignal(fd); }
+
+    // -------------------------------------------------------------------------
+    void vlog(LogLevel level, fmt::string_view format, fmt::format_args args) override {
+        m_metrics.countRecord(static_cast<std::size_t>(level));
+        m_backend.vlog(level, format, args);
+    }
+
+    // -------------------------------------------------------------------------
+    void vlogFields(LogLevel level, std::string_view message, std::span<const Field> fields) override {
+        m_metrics.countRecord(static_cast<std::size_t>(level));
+        m_backend.vlogFields(level, message, fields);
+    }
+
+private:
+    // -------------------------------------------------------------------------
+    void write(LogLevel level, const std::string &message) {
+        if (isEnabled(level)) {
+            vlog(level, "{}", fmt::make_format_args(message));
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Named categories over one backend, created on first use at the root's
+// level: a LoggerRegistry made over the backend, so categories nest by
+// dotted name and are configured like any registry logger.
+//
+//   gc::CategoryRegistry categories(backend, gc::Logger::LogLevel::WARN);
+//   categories.setLevel("db", gc::Logger::LogLevel::DEBUG);
+//   categories.get("db").debug("query {}", id);
+using CategoryRegistry = LoggerRegistry;
+
+}//namespace gc
+
+#endif //GCLOG_CATEGORYLOGGER_HPP
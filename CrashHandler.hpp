@@ -0,0 +1,281 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: CrashHandler.hpp                                            //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef GCLOG_CRASHHANDLER_HPP
+#define GCLOG_CRASHHANDLER_HPP
+
+#include "Logger.hpp"
+
+#include <csignal>
+#include <exception>
+
+#include <pthread.h>
+
+#if __has_include(<execinfo.h>)
+#include <execinfo.h>
+#define GCLOG_HAS_EXECINFO 1
+#endif
+
+namespace gc {
+
+namespace detail {
+    // -------------------------------------------------------------------------
+    // What the crash handlers need, set up front by CrashHandler::install().
+    inline std::atomic<int> crashFd{STDERR_FILENO};
+    inline std::atomic<std::terminate_handler> previousTerminate{nullptr};
+
+    // The thread that crashed first, zero until one has.
+    inline std::atomic<pthread_t> crashOwner{};
+}
+
+// -----------------------------------------------------------------------------
+// Flushes the registered loggers when the process dies on SIGSEGV,
+// SIGABRT, SIGBUS or SIGFPE or through std::terminate, appends a fatal
+// marker line with a stack trace, then lets the process die the way it
+// would have without the handler:
+//
+//   gc::CrashHandler::install();
+//   gc::CrashHandler::add(log);
+//
+// Only async-signal-safe calls run in the handlers: sinks write what they
+// have buffered with raw write(), records still queued in an AsyncLogger
+// go to the policy's fd unformatted, nothing allocates or takes a lock.
+// Which also makes it best effort, a record another thread was writing
+// at the time may come out torn.
+class CrashHandler
+{
+public:
+    struct CrashPolicy
+    {
+        int fd{STDERR_FILENO};  // the marker, the trace and raw records
+        bool fatalSignals{true};
+        bool terminate{true};
+    };
+
+    CrashHandler() = delete;
+
+    /**************************************************************
+     * @brief Installs the handlers for the whole process, call it
+     * early from the main thread.
+     *
+     * @Note: the signal handlers run on an alternate stack, so a
+     * stack overflow can still be reported, but only on the thread
+     * that called install(). Other threads crash on their own stack.
+     *************************************************************/
+    [[maybe_unused]] static void install(CrashPolicy policy) {
+        detail::crashFd.store(policy.fd, std::memory_order_relaxed);
+
+#ifdef GCLOG_HAS_EXECINFO
+        // The first backtrace() loads libgcc, which allocates, so it
+        // has to happen now rather than in the handler.
+        void *frame[1];
+        ::backtrace(frame, 1);
+#endif
+
+        if (policy.fatalSignals) {
+            alignas(16) static char alternateStack[64 * 1024];
+            stack_t stack{};
+            stack.ss_sp = alternateStack;
+            stack.ss_size = sizeof(alternateStack);
+            ::sigaltstack(&stack, nullptr);
+
+            struct sigaction action{};
+            action.sa_sigaction = &onSignal;
+            action.sa_flags = static_cast<int>(SA_SIGINFO | SA_ONSTACK | SA_RESETHAND);
+            sigemptyset(&action.sa_mask);
+            for (const auto &signal : FatalSignals) {
+                ::sigaction(signal.number, &action, nullptr);
+            }
+        }
+
+        if (policy.terminate) {
+            const std::terminate_handler previous = std::set_terminate(&onTerminate);
+            if (previous != &onTerminate) {
+                detail::previousTerminate.store(previous);
+            }
+        }
+    }
+
+    // Both kinds of handler, writing to stderr.
+    [[maybe_unused]] static void install() { install(CrashPolicy{}); }
+
+    // -------------------------------------------------------------------------
+    // Registers logger to be flushed on a crash, in the order added.
+    // Returns false when all detail::crashLoggers slots are taken, or for
+    // a logger that can't flush from a signal handler (a TEXT
+    // BinaryLogger). An AsyncLogger flushes its backend itself, adding
+    // it is enough.
+    [[maybe_unused]] static bool add(Logger &logger) {
+        if (!logger.flushesFromSignal()) {
+            return false;
+        }
+        for (auto &slot : detail::crashLoggers) {
+            if (slot.load() == &logger) {
+                return true;
+            }
+        }
+        for (auto &slot : detail::crashLoggers) {
+            Logger *expected = nullptr;
+            if (slot.compare_exchange_strong(expected, &logger)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // -------------------------------------------------------------------------
+    // Loggers take themselves out when destroyed, this is for earlier.
+    [[maybe_unused]] static void remove(Logger &logger) {
+        for (auto &slot : detail::crashLoggers) {
+            Logger *expected = &logger;
+            slot.compare_exchange_strong(expected, nullptr);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // What the handlers do before writing the marker, async-signal-safe.
+    static void flushAll(int fd) {
+        for (auto &slot : detail::crashLoggers) {
+            if (Logger *logger = slot.load(std::memory_order_acquire)) {
+                logger->flushFromSignal(fd);
+            }
+        }
+    }
+
+private:
+    struct FatalSignal
+    {
+        int number;
+        std::string_view name;
+    };
+
+    static constexpr std::array<FatalSignal, 4> FatalSignals{{
+            {SIGSEGV, "SIGSEGV"},
+            {SIGABRT, "SIGABRT"},
+            {SIGBUS, "SIGBUS"},
+            {SIGFPE, "SIGFPE"},
+    }};
+
+    // -------------------------------------------------------------------------
+    // True for the first thread to crash. Any other thread crashing
+    // meanwhile waits for the first to take the process down, the first
+    // crashing again (abort() after the terminate hook) goes on to die.
+    static bool claim() {
+        const pthread_t self = ::pthread_self();
+        pthread_t owner{};
+        if (detail::crashOwner.compare_exchange_strong(owner, self)) {
+            return true;
+        }
+        if (::pthread_equal(owner, self)) {
+            return false;
+        }
+        for (;;) {
+            ::pause();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    static void writeText(int fd, std::string_view text) {
+        detail::writeFromSignal(fd, text.data(), text.size());
+    }
+
+    // -------------------------------------------------------------------------
+    // fmt isn't async-signal-safe, so the digits are worked out here.
+    static void writeNumber(int fd, unsigned value) {
+        char digits[10];
+        std::size_t first = sizeof(digits);
+        do {
+            digits[--first] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        detail::writeFromSignal(fd, digits + first, sizeof(digits) - first);
+    }
+
+    // -------------------------------------------------------------------------
+    static void writeStackTrace(int fd) {
+#ifdef GCLOG_HAS_EXECINFO
+        void *frames[64];
+        const int depth = ::backtrace(frames, static_cast<int>(std::size(frames)));
+        ::backtrace_symbols_fd(frames, depth, fd);
+#else
+        writeText(fd, "no stack trace on this platform\n");
+#endif
+    }
+
+    // -------------------------------------------------------------------------
+    // SA_RESETHAND has put the default action back, so the signal raised
+    // again on the way out ends the process as it would have, core dump
+    // and exit status included.
+    static void onSignal(int signal, [[maybe_unused]] siginfo_t *info, [[maybe_unused]] void *context) {
+        if (claim()) {
+            const int fd = detail::crashFd.load(std::memory_order_relaxed);
+            flushAll(fd);
+
+            std::string_view name = "unknown signal";
+            for (const auto &fatal : FatalSignals) {
+                if (fatal.number == signal) {
+                    name = fatal.name;
+                }
+            }
+            writeText(fd, "[FATAL]: caught ");
+            writeText(fd, name);
+            writeText(fd, " (signal ");
+            writeNumber(fd, static_cast<unsigned>(signal));
+            writeText(fd, ")\n");
+            writeStackTrace(fd);
+        }
+        ::raise(signal);
+    }
+
+    // -------------------------------------------------------------------------
+    // Not a signal context, but the heap may be what broke, so it sticks
+    // to the same raw writes. Only naming the exception may allocate.
+    [[noreturn]] static void onTerminate() {
+        if (claim()) {
+            const int fd = detail::crashFd.load(std::memory_order_relaxed);
+            flushAll(fd);
+
+            writeText(fd, "[FATAL]: std::terminate called");
+            if (const std::exception_ptr current = std::current_exception()) {
+                try {
+                    std::rethrow_exception(current);
+                } catch (const std::exception &exception) {
+                    writeText(fd, " after throwing: ");
+                    writeText(fd, exception.what());
+                } catch (...) {
+                    writeText(fd, " after throwing a non std::exception");
+                }
+            }
+            writeText(fd, "\n");
+            writeStackTrace(fd);
+        }
+
+        if (const std::terminate_handler previous = detail::previousTerminate.load()) {
+            previous();
+        }
+        std::abort();
+    }
+};
+
+}//namespace gc
+
+#endif //GCLOG_CRASHHANDLER_HPP
@@ -0,0 +1,270 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: Fields.hpp                                                  //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_FIELDS_HPP
+#define GCLOG_FIELDS_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <string_view>
+#include <type_traits>
+
+#include <fmt/format.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace gc {
+
+// -----------------------------------------------------------------------------
+// A typed key/value pair logged next to a message,
+// log.info("request done", kv("status", 200), kv("ms", 3.2)).
+//
+// Fields only borrow their key and string value, they are made and used
+// within the one logging statement.
+class Field
+{
+public:
+    enum class Type : char {
+        BOOL = 0, INT64, UINT64, DOUBLE, STRING
+    };
+
+    constexpr Field(std::string_view key, bool value)
+            : m_key(key), m_type(Type::BOOL) { m_value.boolean = value; }
+
+    constexpr Field(std::string_view key, std::int64_t value)
+            : m_key(key), m_type(Type::INT64) { m_value.signedInt = value; }
+
+    constexpr Field(std::string_view key, std::uint64_t value)
+            : m_key(key), m_type(Type::UINT64) { m_value.unsignedInt = value; }
+
+    constexpr Field(std::string_view key, double value)
+            : m_key(key), m_type(Type::DOUBLE) { m_value.real = value; }
+
+    constexpr Field(std::string_view key, std::string_view value)
+            : m_key(key), m_type(Type::STRING), m_size(value.size()) { m_value.text = value.data(); }
+
+private:
+    std::string_view m_key;
+    Type m_type;
+    union {
+        bool boolean;
+        std::int64_t signedInt;
+        std::uint64_t unsignedInt;
+        double real;
+        const char *text;
+    } m_value{};
+    std::size_t m_size{0};
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] constexpr std::string_view getKey() const { return m_key; }
+
+    [[nodiscard]] constexpr Type getType() const { return m_type; }
+
+    [[nodiscard]] constexpr bool getBool() const { return m_value.boolean; }
+
+    [[nodiscard]] constexpr std::int64_t getInt() const { return m_value.signedInt; }
+
+    [[nodiscard]] constexpr std::uint64_t getUint() const { return m_value.unsignedInt; }
+
+    [[nodiscard]] constexpr double getDouble() const { return m_value.real; }
+
+    [[nodiscard]] constexpr std::string_view getString() const { return {m_value.text, m_size}; }
+};
+
+// -----------------------------------------------------------------------------
+// True for the arguments of the field overloads, log.info("msg", kv(...)).
+template<typename T>
+concept FieldArg = std::is_same_v<std::remove_cvref_t<T>, Field>;
+
+// -----------------------------------------------------------------------------
+// Makes a Field of any integer, bool, float, double, char or string like
+// value.
+template<typename T>
+constexpr Field kv(std::string_view key, const T &value)
+{
+    if constexpr (std::is_same_v<T, bool>) {
+        return {key, value};
+    } else if constexpr (std::is_same_v<T, char>) {
+        return {key, std::string_view(&value, 1)};
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>) {
+        return {key, std::int64_t{value}};
+    } else if constexpr (std::is_integral_v<T>) {
+        return {key, std::uint64_t{value}};
+    } else if constexpr (std::is_same_v<T, float> || std::is_same_v<T, double>) {
+        return {key, double{value}};
+    } else if constexpr (std::is_convertible_v<const T &, std::string_view>) {
+        return {key, std::string_view(value)};
+    } else {
+        static_assert(std::is_same_v<T, bool>,
+                      "gclog: fields take integers, bool, float, double, char and strings");
+    }
+}
+
+namespace detail {
+    // -------------------------------------------------------------------------
+    // Appends the JSON escape of one character.
+    inline void appendEscapedChar(fmt::memory_buffer &out, char c) {
+        switch (c) {
+            case '"':
+                out.append(std::string_view("\\\""));
+                return;
+            case '\\':
+                out.append(std::string_view("\\\\"));
+                return;
+            case '\n':
+                out.append(std::string_view("\\n"));
+                return;
+            case '\r':
+                out.append(std::string_view("\\r"));
+                return;
+            case '\t':
+                out.append(std::string_view("\\t"));
+                return;
+            default:
+                fmt::format_to(std::back_inserter(out), "\\u{:04x}",
+                               static_cast<unsigned>(static_cast<unsigned char>(c)));
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] constexpr bool needsEscape(char c) {
+        return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+    }
+
+    // -------------------------------------------------------------------------
+    // Appends text escaped for a JSON (or logfmt) string, quotes not
+    // included. Bytes from 0x80 up pass through, so UTF-8 stays as is.
+    //
+    // With SSE2 16 bytes are checked at a time and runs without anything
+    // to escape are copied whole.
+    inline void appendEscaped(fmt::memory_buffer &out, std::string_view text) {
+        const char *data = text.data();
+        std::size_t size = text.size();
+
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i control = _mm_set1_epi8(0x1F);
+
+        while (size >= 16) {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            // Unsigned c <= 0x1F is max(c, 0x1F) == 0x1F.
+            const __m128i special = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+                    _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+            const auto mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+
+            if (mask == 0) {
+                out.append(data, data + 16);
+                data += 16;
+                size -= 16;
+                continue;
+            }
+
+            const auto clean = static_cast<std::size_t>(__builtin_ctz(mask));
+            out.append(data, data + clean);
+            appendEscapedChar(out, data[clean]);
+            data += clean + 1;
+            size -= clean + 1;
+        }
+#endif
+
+        const char *run = data;
+        for (const char *end = data + size; data != end; ++data) {
+            if (needsEscape(*data)) {
+                out.append(run, data);
+                appendEscapedChar(out, *data);
+                run = data + 1;
+            }
+        }
+        out.append(run, data);
+    }
+
+    // -------------------------------------------------------------------------
+    // logfmt leaves a value bare unless it is empty or has a space, '=',
+    // a quote or anything that must be escaped.
+    [[nodiscard]] inline bool needsQuoting(std::string_view text) {
+        if (text.empty()) {
+            return true;
+        }
+        for (const char c : text) {
+            if (c == ' ' || c == '=' || needsEscape(c)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // -------------------------------------------------------------------------
+    // Appends a field's value, as a JSON value or as a logfmt one.
+    inline void appendFieldValue(fmt::memory_buffer &out, const Field &field, bool json) {
+        auto it = std::back_inserter(out);
+        switch (field.getType()) {
+            case Field::Type::BOOL:
+                out.append(std::string_view(field.getBool() ? "true" : "false"));
+                return;
+            case Field::Type::INT64:
+                fmt::format_to(it, "{}", field.getInt());
+                return;
+            case Field::Type::UINT64:
+                fmt::format_to(it, "{}", field.getUint());
+                return;
+            case Field::Type::DOUBLE:
+                if (json && !std::isfinite(field.getDouble())) {
+                    out.append(std::string_view("null"));
+                } else {
+                    fmt::format_to(it, "{}", field.getDouble());
+                }
+                return;
+            case Field::Type::STRING:
+                break;
+        }
+
+        const std::string_view text = field.getString();
+        if (!json && !needsQuoting(text)) {
+            out.append(text);
+            return;
+        }
+        out.push_back('"');
+        appendEscaped(out, text);
+        out.push_back('"');
+    }
+
+    // -------------------------------------------------------------------------
+    // " key=value" for each field, how they read in plain text lines.
+    inline void appendFieldsText(fmt::memory_buffer &out, std::span<const Field> fields) {
+        for (const auto &field : fields) {
+            out.push_back(' ');
+            out.append(field.getKey());
+            out.push_back('=');
+            appendFieldValue(out, field, false);
+        }
+    }
+}
+
+}//namespace gc
+
+#endif //GCLOG_FIELDS_HPP
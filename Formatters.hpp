@@ -0,0 +1,146 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: Formatters.hpp                                              //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_FORMATTERS_HPP
+#define GCLOG_FORMATTERS_HPP
+
+#include "Logger.hpp"
+
+namespace gc {
+
+namespace detail {
+    // -------------------------------------------------------------------------
+    // Level names as machine readable encodings spell them.
+    constexpr std::string_view getLevelName(Logger::LogLevel level) {
+        switch (level) {
+            case Logger::LogLevel::TRACE:
+                return "trace";
+            case Logger::LogLevel::DEBUG:
+                return "debug";
+            case Logger::LogLevel::INFO:
+                return "info";
+            case Logger::LogLevel::WARN:
+                return "warn";
+            case Logger::LogLevel::ERROR:
+                break;
+        }
+        return "error";
+    }
+
+    // -------------------------------------------------------------------------
+    // Wall clock time as seconds since the epoch with microseconds,
+    // cheaper to write and to parse than a calendar date. The record's
+    // time if it was taken earlier (see Logger::logAt()).
+    inline void appendEpochTime(fmt::memory_buffer &out) {
+        timespec now{};
+        if (const timespec *time = recordTime()) {
+            now = *time;
+        } else {
+            clock_gettime(CLOCK_REALTIME, &now);
+        }
+        fmt::format_to(std::back_inserter(out), "{}.{:06}",
+                       now.tv_sec, now.tv_nsec / 1000);
+    }
+
+    // -------------------------------------------------------------------------
+    // The formatted message, rendered on its own so it can be escaped.
+    inline std::string_view formatMessage(fmt::string_view format, fmt::format_args args) {
+        thread_local fmt::memory_buffer message;
+        message.clear();
+        fmt::vformat_to(std::back_inserter(message), format, args);
+        return {message.data(), message.size()};
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Newline delimited JSON, one object a line:
+// {"ts":1760764624.123456,"level":"info","msg":"request done","status":200}
+//
+// The logger's date/time settings don't apply, every line has ts.
+class JsonFormatter final : public Formatter
+{
+public:
+    LogLine format(fmt::memory_buffer &out,
+                   [[maybe_unused]] const Logger &logger,
+                   Logger::LogLevel level,
+                   fmt::string_view format,
+                   fmt::format_args args,
+                   std::span<const Field> fields) const override
+    {
+        out.append(std::string_view(R"({"ts":)"));
+        detail::appendEpochTime(out);
+        out.append(std::string_view(R"(,"level":")"));
+        out.append(detail::getLevelName(level));
+        out.append(std::string_view(R"(","msg":")"));
+        detail::appendEscaped(out, detail::formatMessage(format, args));
+        out.push_back('"');
+
+        for (const auto &field : fields) {
+            out.append(std::string_view(R"(,")"));
+            detail::appendEscaped(out, field.getKey());
+            out.append(std::string_view(R"(":)"));
+            detail::appendFieldValue(out, field, true);
+        }
+
+        out.push_back('}');
+        const std::size_t bodySize = out.size();
+        out.push_back('\n');
+
+        return {level, {out.data(), out.size()}, 0, bodySize};
+    }
+};
+
+// -----------------------------------------------------------------------------
+// logfmt, one record a line:
+// ts=1760764624.123456 level=info msg="request done" status=200
+//
+// The logger's date/time settings don't apply, every line has ts. Keys
+// are written as given, they should not contain spaces, '=' or quotes.
+class LogfmtFormatter final : public Formatter
+{
+public:
+    LogLine format(fmt::memory_buffer &out,
+                   [[maybe_unused]] const Logger &logger,
+                   Logger::LogLevel level,
+                   fmt::string_view format,
+                   fmt::format_args args,
+                   std::span<const Field> fields) const override
+    {
+        out.append(std::string_view("ts="));
+        detail::appendEpochTime(out);
+        out.append(std::string_view(" level="));
+        const std::size_t tagSize = out.size() + detail::getLevelName(level).size();
+        out.append(detail::getLevelName(level));
+
+        out.append(std::string_view(" msg="));
+        detail::appendFieldValue(out, Field("msg", detail::formatMessage(format, args)), false);
+        detail::appendFieldsText(out, fields);
+
+        const std::size_t bodySize = out.size();
+        out.push_back('\n');
+
+        return {level, {out.data(), out.size()}, tagSize, bodySize};
+    }
+};
+
+}//namespace gc
+
+#endif //GCLOG_FORMATTERS_HPP
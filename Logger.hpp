@@ -25,9 +25,50 @@
 #include <iostream>
 #include <sstream>
 #include <ctime>
+#include <iterator>
 #include <utility>
-#include <fstream>
 #include <mutex>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <list>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <chrono>
+#include <condition_variable>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fmt/format.h>
+
+#include "Fields.hpp"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+// Compile-time level threshold -----------------------------------------------
+//
+// Define GCLOG_MIN_LEVEL (e.g. -DGCLOG_MIN_LEVEL=GCLOG_LEVEL_INFO) to strip
+// every level below it from the build, the GCLOG_* macros then expand to
+// nothing that is evaluated and the logger methods to an empty body.
+#define GCLOG_LEVEL_TRACE 0
+#define GCLOG_LEVEL_DEBUG 1
+#define GCLOG_LEVEL_INFO 2
+#define GCLOG_LEVEL_WARN 3
+#define GCLOG_LEVEL_ERROR 4
+#define GCLOG_LEVEL_OFF 5
+
+#ifndef GCLOG_MIN_LEVEL
+#define GCLOG_MIN_LEVEL GCLOG_LEVEL_TRACE
+#endif
 
 namespace gc {
     enum ConsoleColorCode : unsigned char {
@@ -57,7 +98,7 @@ namespace gc {
         BG_MAGENTA [[maybe_unused]] = 45,
         BG_CYAN [[maybe_unused]] = 46,
         BG_LIGHT_GRAY [[maybe_unused]] = 47,
-        BG_DARK_GRAY [[maybe_unused]] = 90,
+        BG_DARK_GRAY [[maybe_unused]] = 100,
         BG_LIGHT_RED [[maybe_unused]] = 101,
         BG_LIGHT_GREEN [[maybe_unused]] = 102,
         BG_LIGHT_YELLOW [[maybe_unused]] = 103,
@@ -68,174 +109,2149 @@ namespace gc {
         BG_ORANGE [[maybe_unused]] = 214
     };
 
+namespace detail {
+    // -------------------------------------------------------------------------
+    // A short string built at compile time and copied with one memcpy,
+    // for the escape sequences and level prefixes of console output.
+    template<std::size_t Capacity>
+    struct FixedString
+    {
+        std::array<char, Capacity> chars{};
+        std::size_t size{0};
+
+        constexpr FixedString &append(std::string_view text) {
+            for (const char c : text) {
+                chars[size++] = c;
+            }
+            return *this;
+        }
+
+        constexpr FixedString &appendNumber(unsigned value) {
+            char digits[10]{};
+            std::size_t count = 0;
+            do {
+                digits[count++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value != 0);
+            while (count != 0) {
+                chars[size++] = digits[--count];
+            }
+            return *this;
+        }
+
+        [[nodiscard]] constexpr std::string_view view() const { return {chars.data(), size}; }
+    };
+
+    // "\033[38;2;255;255;255m" is the longest.
+    using ColorEscape = FixedString<20>;
+
+    // -------------------------------------------------------------------------
+    // Codes SGR takes as they are, everything else is a 256 color index.
+    constexpr bool isBasicColorCode(unsigned code) {
+        return (code >= 30 && code <= 37) || code == 39 || (code >= 40 && code <= 47) || code == 49
+               || (code >= 90 && code <= 97) || (code >= 100 && code <= 107);
+    }
+
+    // -------------------------------------------------------------------------
+    constexpr ColorEscape makePaletteEscape(unsigned index, bool background) {
+        ColorEscape escape;
+        escape.append(background ? "\033[48;5;" : "\033[38;5;").appendNumber(index).append("m");
+        return escape;
+    }
+
+    // -------------------------------------------------------------------------
+    // The escape selecting code. The ones past the basic range are 256
+    // color indexes, foreground except BG_ORANGE.
+    constexpr ColorEscape makeColorEscape(unsigned code) {
+        if (!isBasicColorCode(code)) {
+            return makePaletteEscape(code, code == BG_ORANGE);
+        }
+        ColorEscape escape;
+        escape.append("\033[").appendNumber(code).append("m");
+        return escape;
+    }
+
+    // -------------------------------------------------------------------------
+    // Every ConsoleColorCode's escape, indexed by the code.
+    inline constexpr std::array<ColorEscape, 256> ColorEscapes = [] {
+        std::array<ColorEscape, 256> escapes{};
+        for (unsigned code = 0; code < escapes.size(); ++code) {
+            escapes[code] = makeColorEscape(code);
+        }
+        return escapes;
+    }();
+}
+
 // -----------------------------------------------------------------------------
+    // A console color as its escape sequence, worked out when the color
+    // is made (at compile time for constants) rather than per line.
     class ConsoleColor {
+    public:
+        [[maybe_unused]] constexpr explicit ConsoleColor(ConsoleColorCode code)
+                : m_escape(detail::ColorEscapes[code]) {}
+
+        // One of the 256 palette colors.
+        [[nodiscard]] static constexpr ConsoleColor palette(std::uint8_t index, bool background = false) {
+            return ConsoleColor(detail::makePaletteEscape(index, background));
+        }
+
+        // A 24 bit color, for terminals that support truecolor.
+        [[nodiscard]] static constexpr ConsoleColor rgb(std::uint8_t red, std::uint8_t green, std::uint8_t blue,
+                                                        bool background = false) {
+            detail::ColorEscape escape;
+            escape.append(background ? "\033[48;2;" : "\033[38;2;")
+                    .appendNumber(red).append(";").appendNumber(green).append(";").appendNumber(blue)
+                    .append("m");
+            return ConsoleColor(escape);
+        }
+
+        [[nodiscard]] constexpr std::string_view getEscape() const { return m_escape.view(); }
+
+        // Appends the escape sequence selecting this color.
+        void appendTo(fmt::memory_buffer &out) const {
+            out.append(m_escape.view());
+        }
+
+        friend std::ostream &
+        operator<<(std::ostream &os, const ConsoleColor &mod) {
+            return os << mod.getEscape();
+        }
+
+    private:
+        constexpr explicit ConsoleColor(const detail::ColorEscape &escape) : m_escape(escape) {}
+
+        detail::ColorEscape m_escape;
+    };
+// -----------------------------------------------------------------------------
+class Time
+{
+public:
+    enum class Precision : char {
+        SECONDS = 0, MILLISECONDS, MICROSECONDS, NANOSECONDS
+    };
+
+    // Longest output of format(): " HH:MM:SS.nnnnnnnnn DD/MM/YYYY".
+    static constexpr std::size_t MaxFormattedSize = 32;
+
+    /**************************************************************
+     * @brief Writes " HH:MM:SS[.fraction]" and/or " DD/MM/YYYY",
+     * zero padded and fixed width, into out, which must hold at
+     * least MaxFormattedSize chars. Returns the number written.
+     *
+     * @Note: the calendar part is rendered with localtime_r at most
+     * once per second per thread and cached, every other call is a
+     * clock read and a couple of memcpys. Nothing is allocated.
+     *************************************************************/
+    static std::size_t format(char *out, bool withTime, bool withDate,
+                              Precision precision = Precision::SECONDS) {
+        timespec now{};
+        ::clock_gettime(precision == Precision::SECONDS ? CoarseClock : CLOCK_REALTIME, &now);
+        return formatAt(out, now, withTime, withDate, precision);
+    }
+
+    // -------------------------------------------------------------------------
+    // As format(), for a wall clock time taken earlier.
+    static std::size_t formatAt(char *out, const timespec &now, bool withTime,
+                                bool withDate, Precision precision = Precision::SECONDS) {
+        thread_local CachedSecond cache;
+        if (now.tv_sec != cache.second) {
+            cache.render(now.tv_sec);
+        }
+
+        char *pos = out;
+        if (withTime) {
+            pos = std::copy(std::begin(cache.time), std::end(cache.time), pos);
+
+            switch (precision) {
+                case Precision::SECONDS:
+                    break;
+                case Precision::MILLISECONDS:
+                    *pos++ = '.';
+                    pos = writeDigits(pos, now.tv_nsec / 1000000, 3);
+                    break;
+                case Precision::MICROSECONDS:
+                    *pos++ = '.';
+                    pos = writeDigits(pos, now.tv_nsec / 1000, 6);
+                    break;
+                case Precision::NANOSECONDS:
+                    *pos++ = '.';
+                    pos = writeDigits(pos, now.tv_nsec, 9);
+                    break;
+            }
+        }
+        if (withDate) {
+            pos = std::copy(std::begin(cache.date), std::end(cache.date), pos);
+        }
+
+        return static_cast<std::size_t>(pos - out);
+    }
+
+    // -------------------------------------------------------------------------
+    // The original stream based helpers, kept for existing callers. Each
+    // call allocates, prefer format() on anything hot.
+    inline static std::string getTime() {
+        std::ostringstream oss;
+
+        // Current date/time based on current system.
+        time_t now = time(nullptr);
+
+        // Broken down local time, localtime_r rather than localtime
+        // so concurrent callers don't share a static tm.
+        tm ltm{};
+        localtime_r(&now, &ltm);
+
+        // Fill oss stream with various time components
+        // of tm structure.
+        oss << ' ' << ltm.tm_hour << ':'
+            << ltm.tm_min << ':'
+            << ltm.tm_sec;
+
+        return oss.str();
+    }
+
+// -----------------------------------------------------------------------------
+    inline static std::string getDate() {
+        std::ostringstream oss;
+
+        // Current date/time based on current system.
+        time_t now = time(nullptr);
+
+        // Broken down local time, localtime_r rather than localtime
+        // so concurrent callers don't share a static tm.
+        tm ltm{};
+        localtime_r(&now, &ltm);
+
+        // Fill oss stream with various date components
+        // of tm structure.
+        oss << ' ' << ltm.tm_mday << '/'
+            << 1 + ltm.tm_mon << '/'
+            << 1900 + ltm.tm_year;
+
+        return oss.str();
+    }
+
+private:
+#ifdef CLOCK_REALTIME_COARSE
+    // Served from the vDSO without reading the TSC, good enough when
+    // only whole seconds are printed.
+    static constexpr clockid_t CoarseClock = CLOCK_REALTIME_COARSE;
+#else
+    static constexpr clockid_t CoarseClock = CLOCK_REALTIME;
+#endif
+
+    // Rendered " HH:MM:SS" and " DD/MM/YYYY" for one second.
+    struct CachedSecond
+    {
+        time_t second{-1};
+        char time[9]{};
+        char date[11]{};
+
+        void render(time_t now) {
+            tm ltm{};
+            localtime_r(&now, &ltm);
+
+            time[0] = ' ';
+            writeDigits(time + 1, ltm.tm_hour, 2);
+            time[3] = ':';
+            writeDigits(time + 4, ltm.tm_min, 2);
+            time[6] = ':';
+            writeDigits(time + 7, ltm.tm_sec, 2);
+
+            date[0] = ' ';
+            writeDigits(date + 1, ltm.tm_mday, 2);
+            date[3] = '/';
+            writeDigits(date + 4, ltm.tm_mon + 1, 2);
+            date[6] = '/';
+            writeDigits(date + 7, ltm.tm_year + 1900, 4);
+
+            second = now;
+        }
+    };
+
+    // Writes exactly width decimal digits of value, zero padded.
+    static char *writeDigits(char *out, long value, int width) {
+        for (int i = width - 1; i >= 0; --i) {
+            out[i] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        }
+        return out + width;
+    }
+};
+// -----------------------------------------------------------------------------
+class Logger;
+
+namespace detail {
+    // Scratch space each thread renders its log lines into, it grows to
+    // the longest line seen and is then reused without allocating.
+    inline fmt::memory_buffer &lineBuffer() {
+        thread_local fmt::memory_buffer buffer;
+        return buffer;
+    }
+
+    // -------------------------------------------------------------------------
+    // When this thread writes a record that was taken earlier, the time
+    // it was taken, nullptr otherwise. See Logger::logAt().
+    inline const timespec *&recordTime() {
+        thread_local const timespec *time = nullptr;
+        return time;
+    }
+
+    // -------------------------------------------------------------------------
+    // Writes parts to fd, retrying short writes and EINTR. Other errors
+    // drop the data, a logger has nowhere sensible to report its own
+    // failures.
+    inline void writeAll(int fd, iovec *parts, std::size_t count) {
+        while (count != 0) {
+            const ssize_t written = ::writev(fd, parts, static_cast<int>(count));
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+
+            auto remaining = static_cast<std::size_t>(written);
+            while (count != 0 && remaining >= parts->iov_len) {
+                remaining -= parts->iov_len;
+                ++parts;
+                --count;
+            }
+            if (count != 0) {
+                parts->iov_base = static_cast<char *>(parts->iov_base) + remaining;
+                parts->iov_len -= remaining;
+            }
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // writeAll() for crash handlers, plain write() being on the list of
+    // async-signal-safe calls and writev() not.
+    inline void writeFromSignal(int fd, const char *data, std::size_t size) {
+        while (size != 0) {
+            const ssize_t written = ::write(fd, data, size);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return;
+            }
+            data += written;
+            size -= static_cast<std::size_t>(written);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // The loggers CrashHandler flushes, a fixed table so a signal handler
+    // walks it without locking or allocating. A logger takes itself out
+    // when it is destroyed.
+    inline std::array<std::atomic<Logger *>, 16> crashLoggers{};
+
+    // -------------------------------------------------------------------------
+    // Lets a background thread sleep until it has work instead of polling.
+    // The thread calls sleep() or sleepUntil() under the lock once it has
+    // found nothing to do, producers call notify() after publishing. When
+    // the producer publishes and hasWork reads with seq_cst operations,
+    // either the thread sees the work or the producer sees it asleep, so
+    // nothing is missed. notify() is one load of a flag that only changes
+    // when the thread sleeps, the lock is only taken to wake it.
+    class Wakeup
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        Wakeup() = default;
+
+        Wakeup(const Wakeup &) = delete;
+        Wakeup &operator=(const Wakeup &) = delete;
+
+        // Also guards what the owner asks of the thread, a flush or a stop.
+        [[nodiscard]] std::mutex &getMutex() { return m_mutex; }
+
+        // Producers, after publishing. Only the first to see the thread
+        // asleep takes the lock.
+        void notify() {
+            if (m_sleeping.load(std::memory_order_seq_cst)
+                && m_sleeping.exchange(false, std::memory_order_seq_cst)) {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_condition.notify_one();
+            }
+        }
+
+        // The owner, after changing what hasWork reads under the lock.
+        void wake() { m_condition.notify_one(); }
+
+        // Returns once hasWork() is true.
+        template<typename HasWork>
+        void sleep(std::unique_lock<std::mutex> &guard, HasWork &&hasWork) {
+            sleepUntil(guard, std::nullopt, hasWork);
+        }
+
+        // Returns once hasWork() is true or at deadline, if there is one.
+        template<typename HasWork>
+        void sleepUntil(std::unique_lock<std::mutex> &guard,
+                        std::optional<Clock::time_point> deadline, HasWork &&hasWork) {
+            for (;;) {
+                m_sleeping.store(true, std::memory_order_seq_cst);
+                if (hasWork()) {
+                    break;
+                }
+                if (!deadline) {
+                    m_condition.wait(guard);
+                } else if (m_condition.wait_until(guard, *deadline) == std::cv_status::timeout) {
+                    break;
+                }
+            }
+            m_sleeping.store(false, std::memory_order_relaxed);
+        }
+
     private:
-        ConsoleColorCode code;
+        std::mutex m_mutex;
+        std::condition_variable m_condition;
+        alignas(64) std::atomic<bool> m_sleeping{false};
+    };
+
+    // -------------------------------------------------------------------------
+    // One T per thread per owner, made on the thread's first local() call.
+    // When the thread exits its T goes back to the owner, through release
+    // if one was given, and the next new thread takes it over, so an
+    // owner has no more Ts than threads using it at once. The owner keeps
+    // every T until it is destroyed, a reader can still drain what an
+    // exited thread left.
+    template<typename T>
+    class PerThread
+    {
     public:
-        [[maybe_unused]] explicit ConsoleColor(ConsoleColorCode pCode) : code(pCode) {}
+        explicit PerThread(std::function<std::unique_ptr<T>()> factory,
+                           std::function<void(T &)> release = {})
+                : m_factory(std::move(factory))
+        {
+            m_shared->release = std::move(release);
+        }
+
+        ~PerThread() { releaseSlot(m_slot); }
+
+        PerThread(const PerThread &) = delete;
+        PerThread &operator=(const PerThread &) = delete;
+
+        // The calling thread's T, a compare and a load once registered.
+        // Each owner has a cache slot of its own in every thread, so a
+        // thread going back and forth between any number of owners, a
+        // logger and its sinks, keeps hitting.
+        T &local() {
+            if (m_slot < t_cacheSize) {
+                const Entry &entry = t_cache[m_slot];
+                if (entry.owner == m_id) {
+                    return *entry.value;
+                }
+            }
+            return *lookup().value;
+        }
+
+        // Refreshes values with every T registered so far. Cheap when
+        // nothing was registered since the previous call.
+        void snapshot(std::vector<T *> &values) const {
+            if (m_shared->count.load(std::memory_order_acquire) == values.size()) {
+                return;
+            }
+            std::lock_guard<std::mutex> guard(m_shared->mutex);
+            values.clear();
+            for (const auto &value : m_shared->values) {
+                values.push_back(value.get());
+            }
+        }
+
+        // Calls visit(const T &) for every T made so far without locking
+        // or allocating, for a crash handler. One being made at the same
+        // time may be missed.
+        template<typename Visit>
+        void forEachFromSignal(Visit &&visit) const {
+            for (const Node *node = m_shared->head.load(std::memory_order_acquire);
+                 node != nullptr; node = node->next) {
+                visit(static_cast<const T &>(*node->value));
+            }
+        }
+
+        // How many Ts there are, the most threads that used it at once.
+        [[nodiscard]] std::size_t size() const {
+            return m_shared->count.load(std::memory_order_acquire);
+        }
+
+    private:
+        struct Entry
+        {
+            std::uint64_t owner{0};
+            T *value{nullptr};
+        };
+
+        // Every T newest first, for readers that can't take the mutex.
+        struct Node
+        {
+            const T *value;
+            const Node *next;
+        };
+
+        // What exiting threads hand their Ts back to, outliving the owner
+        // while one does.
+        struct Shared
+        {
+            std::function<void(T &)> release;  // called by the exiting thread
+            std::mutex mutex;
+            std::vector<std::unique_ptr<T>> values;
+            std::vector<T *> released;
+            std::atomic<std::size_t> count{0};
+            std::list<Node> nodes;  // never moved once added
+            std::atomic<const Node *> head{nullptr};
+        };
+
+        struct Registration
+        {
+            Entry entry;
+            std::weak_ptr<Shared> shared;
+        };
+
+        // A thread's Ts, returned to their owners when the thread exits.
+        struct Registrations
+        {
+            Registrations() = default;
+            Registrations(const Registrations &) = delete;
+            Registrations &operator=(const Registrations &) = delete;
+
+            ~Registrations() {
+                t_exiting = true;
+                t_cache = nullptr;
+                t_cacheSize = 0;
+                for (const Registration &registration : list) {
+                    if (const auto shared = registration.shared.lock()) {
+                        if (shared->release) {
+                            shared->release(*registration.entry.value);
+                        }
+                        std::lock_guard<std::mutex> guard(shared->mutex);
+                        shared->released.push_back(registration.entry.value);
+                    }
+                }
+            }
+
+            std::vector<Registration> list;
+            std::vector<Entry> cache;  // by owner slot, t_cache points at it
+        };
+
+        // Slot numbers of the live owners, reused once an owner is gone
+        // so that the caches stay as long as the most owners alive at once.
+        struct Slots
+        {
+            std::mutex mutex;
+            std::vector<std::size_t> released;
+            std::size_t next{0};
+        };
+
+        // Plain pointer and size, still safe to read once the thread's
+        // Registrations are destroyed.
+        inline static thread_local Entry *t_cache{nullptr};
+        inline static thread_local std::size_t t_cacheSize{0};
+        inline static thread_local bool t_exiting{false};
+
+        static std::uint64_t nextId() {
+            static std::atomic<std::uint64_t> next{1};
+            return next.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        static Slots &slots() {
+            static Slots slots;
+            return slots;
+        }
+
+        static std::size_t takeSlot() {
+            Slots &all = slots();
+            std::lock_guard<std::mutex> guard(all.mutex);
+            if (all.released.empty()) {
+                return all.next++;
+            }
+            const std::size_t slot = all.released.back();
+            all.released.pop_back();
+            return slot;
+        }
+
+        static void releaseSlot(std::size_t slot) {
+            Slots &all = slots();
+            std::lock_guard<std::mutex> guard(all.mutex);
+            all.released.push_back(slot);
+        }
+
+        // Owner ids are never reused, so what a destroyed owner left in
+        // a cache slot is never matched by the next owner of the slot.
+        // Its registrations are dropped here.
+        Entry lookup() {
+            if (t_exiting) {
+                // Logging from another thread_local's destructor, after
+                // the registrations are gone. Kept, never handed back.
+                return {m_id, take()};
+            }
+
+            thread_local Registrations registrations;
+            std::erase_if(registrations.list, [](const Registration &registration) {
+                return registration.shared.expired();
+            });
+            if (registrations.cache.size() <= m_slot) {
+                registrations.cache.resize(m_slot + 1);
+                t_cache = registrations.cache.data();
+                t_cacheSize = registrations.cache.size();
+            }
+
+            Entry &cached = registrations.cache[m_slot];
+            for (const Registration &registration : registrations.list) {
+                if (registration.entry.owner == m_id) {
+                    cached = registration.entry;
+                    return cached;
+                }
+            }
+
+            cached = Entry{m_id, take()};
+            registrations.list.push_back({cached, m_shared});
+            return cached;
+        }
+
+        // A T an exited thread handed back, or a new one.
+        T *take() {
+            {
+                std::lock_guard<std::mutex> guard(m_shared->mutex);
+                if (!m_shared->released.empty()) {
+                    T *value = m_shared->released.back();
+                    m_shared->released.pop_back();
+                    return value;
+                }
+            }
+
+            std::unique_ptr<T> created = m_factory();
+            T *value = created.get();
+            std::lock_guard<std::mutex> guard(m_shared->mutex);
+            m_shared->values.push_back(std::move(created));
+            m_shared->count.store(m_shared->values.size(), std::memory_order_release);
+            m_shared->nodes.push_back({value, m_shared->head.load(std::memory_order_relaxed)});
+            m_shared->head.store(&m_shared->nodes.back(), std::memory_order_release);
+            return value;
+        }
+
+        const std::uint64_t m_id{nextId()};
+        const std::size_t m_slot{takeSlot()};
+        std::function<std::unique_ptr<T>()> m_factory;
+        const std::shared_ptr<Shared> m_shared{std::make_shared<Shared>()};
+    };
+}
+
+// -----------------------------------------------------------------------------
+// What a logger or a sink has done since it was made, summed over every
+// thread. Whatever doesn't apply to it stays 0.
+struct MetricsSnapshot
+{
+    // Upper bounds of the flush latency buckets in nanoseconds, one more
+    // bucket takes everything slower.
+    static constexpr std::array<std::uint64_t, 11> LatencyBounds{
+            1'000, 4'000, 16'000, 64'000, 256'000, 1'000'000, 4'000'000,
+            16'000'000, 64'000'000, 256'000'000, 1'000'000'000};
+
+    std::array<std::uint64_t, 5> records{};  // written, by level
+    std::uint64_t dropped{0};                // lost to a full queue or ring
+    std::uint64_t suppressed{0};             // deduplicated or rate limited
+    std::uint64_t bytes{0};
+    std::uint64_t queueHighWater{0};         // most records found waiting
+    std::uint64_t flushes{0};
+    std::array<std::uint64_t, LatencyBounds.size() + 1> flushLatency{};  // flushes per bucket
+    std::uint64_t flushNanoseconds{0};
+    std::uint64_t blockedNanoseconds{0};     // producers waiting for room
+
+    [[nodiscard]] std::uint64_t getRecordCount() const {
+        std::uint64_t count = 0;
+        for (const std::uint64_t level : records) {
+            count += level;
+        }
+        return count;
+    }
+
+    // -------------------------------------------------------------------------
+    // For sinks that hand their flushing to another sink.
+    void addFlushes(const MetricsSnapshot &other) {
+        flushes += other.flushes;
+        flushNanoseconds += other.flushNanoseconds;
+        for (std::size_t i = 0; i < flushLatency.size(); ++i) {
+            flushLatency[i] += other.flushLatency[i];
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Counters each thread keeps for itself, summed when they are read. An
+// update is a relaxed load and store to a cache line no other thread
+// writes, no read-modify-write and no contention. A snapshot may catch an
+// update half done, a counter is then one short until the next.
+//
+// An exited thread's cell keeps its counts and goes on counting for the
+// next new thread (see detail::PerThread), so there are only as many
+// cells as threads logging at once and nothing is lost.
+class Metrics
+{
+public:
+    Metrics() = default;
+
+    Metrics(const Metrics &) = delete;            // non construction-copyable
+    Metrics(Metrics &&) = delete;                 // non movable
+    Metrics &operator=(const Metrics &) = delete; // non copyable
+    Metrics &operator=(Metrics &&) = delete;      // move assignment
+
+private:
+    using Counter = std::atomic<std::uint64_t>;
+
+    struct alignas(64) Cell
+    {
+        std::array<Counter, 5> records{};
+        Counter dropped{0};
+        Counter suppressed{0};
+        Counter bytes{0};
+        Counter queueHighWater{0};
+        Counter flushes{0};
+        std::array<Counter, MetricsSnapshot::LatencyBounds.size() + 1> flushLatency{};
+        Counter flushNanoseconds{0};
+        Counter blockedNanoseconds{0};
+    };
+
+    detail::PerThread<Cell> m_cells{[] { return std::make_unique<Cell>(); }};
+
+    static void add(Counter &counter, std::uint64_t count) {
+        counter.store(counter.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+    }
+
+public:
+    // -------------------------------------------------------------------------
+    // level is a Logger::LogLevel's value.
+    void countRecord(std::size_t level) { add(m_cells.local().records[level], 1); }
+
+    void countDropped(std::uint64_t count = 1) { add(m_cells.local().dropped, count); }
+
+    void countSuppressed(std::uint64_t count = 1) { add(m_cells.local().suppressed, count); }
+
+    void countBytes(std::uint64_t count) { add(m_cells.local().bytes, count); }
+
+    void countBlocked(std::chrono::nanoseconds time) {
+        add(m_cells.local().blockedNanoseconds, static_cast<std::uint64_t>(time.count()));
+    }
+
+    // -------------------------------------------------------------------------
+    void countFlush(std::chrono::nanoseconds latency) {
+        Cell &cell = m_cells.local();
+        const auto nanoseconds = static_cast<std::uint64_t>(latency.count());
+        std::size_t bucket = 0;
+        while (bucket < MetricsSnapshot::LatencyBounds.size()
+               && nanoseconds > MetricsSnapshot::LatencyBounds[bucket]) {
+            ++bucket;
+        }
+        add(cell.flushes, 1);
+        add(cell.flushLatency[bucket], 1);
+        add(cell.flushNanoseconds, nanoseconds);
+    }
+
+    // -------------------------------------------------------------------------
+    void noteQueueDepth(std::uint64_t depth) {
+        Counter &highWater = m_cells.local().queueHighWater;
+        if (depth > highWater.load(std::memory_order_relaxed)) {
+            highWater.store(depth, std::memory_order_relaxed);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] MetricsSnapshot snapshot() const {
+        std::vector<Cell *> cells;
+        m_cells.snapshot(cells);
+
+        MetricsSnapshot total;
+        for (const Cell *cell : cells) {
+            for (std::size_t i = 0; i < total.records.size(); ++i) {
+                total.records[i] += cell->records[i].load(std::memory_order_relaxed);
+            }
+            total.dropped += cell->dropped.load(std::memory_order_relaxed);
+            total.suppressed += cell->suppressed.load(std::memory_order_relaxed);
+            total.bytes += cell->bytes.load(std::memory_order_relaxed);
+            total.queueHighWater = std::max(total.queueHighWater,
+                                            cell->queueHighWater.load(std::memory_order_relaxed));
+            total.flushes += cell->flushes.load(std::memory_order_relaxed);
+            for (std::size_t i = 0; i < total.flushLatency.size(); ++i) {
+                total.flushLatency[i] += cell->flushLatency[i].load(std::memory_order_relaxed);
+            }
+            total.flushNanoseconds += cell->flushNanoseconds.load(std::memory_order_relaxed);
+            total.blockedNanoseconds += cell->blockedNanoseconds.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+};
+// -----------------------------------------------------------------------------
+class Logger
+{
+public:
+    enum class LogLevel : char {
+        TRACE = 0, DEBUG = 1, INFO = 2, WARN = 3, ERROR = 4
+    };
+    enum class AppendDateTimeFormat : char {
+        NONE = 0, TIME_ONLY, DATE_ONLY, DATE_TIME
+    };
+
+    Logger() = delete;
+    explicit Logger(LogLevel logLevel)
+            : m_logLevel(logLevel), m_enabledLevels(getEnabledMask(logLevel)) {}
+
+    Logger(LogLevel logLevel, AppendDateTimeFormat dateTimeFormat)
+            : m_dateTimeFormat(dateTimeFormat), m_logLevel(logLevel),
+              m_enabledLevels(getEnabledMask(logLevel)) {}
+
+    virtual ~Logger()
+    {
+        for (auto &slot : detail::crashLoggers) {
+            Logger *self = this;
+            slot.compare_exchange_strong(self, nullptr);
+        }
+    }
+
+    Logger(const Logger &) = delete;            // non construction-copyable
+    Logger(Logger &&) = delete;                 // non movable
+    Logger &operator=(const Logger &) = delete; // non copyable
+    Logger &operator=(Logger &&) = delete;      // move assignment
+
+private:
+    AppendDateTimeFormat m_dateTimeFormat{AppendDateTimeFormat::DATE_TIME};
+    Time::Precision m_timePrecision{Time::Precision::SECONDS};
+    std::atomic<LogLevel> m_logLevel{LogLevel::INFO};
+    std::atomic<std::uint8_t> m_enabledLevels{getEnabledMask(LogLevel::INFO)};
+    std::atomic<bool> m_passesAllLevels{false};
+
+protected:
+    // Counted by the subclasses, where records are written or lost.
+    Metrics m_metrics;
+
+    // -------------------------------------------------------------------------
+    // Lets records below the level through to vlog()/vlogFields() as well,
+    // for loggers that keep them (see SinkLogger::enableBacktrace()).
+    void setPassesAllLevels(bool passesAll)
+    {
+        m_passesAllLevels.store(passesAll, std::memory_order_relaxed);
+        Logger::setLevel(getLogLevel());
+    }
+
+public:
+    // Setters -----------------------------------------------------------------
+    //
+    /**************************************************************
+     * @brief Sets the lowest level written, records below it are
+     * dropped.
+     *
+     * @Note: safe to call while other threads log, e.g. from a
+     * SIGHUP handler's thread. Both stores are relaxed, a record
+     * racing with the change sees either the old or the new level.
+     * Virtual for loggers whose level is kept elsewhere (see
+     * NamedLogger).
+     *************************************************************/
+    [[maybe_unused]] virtual void setLevel(LogLevel level)
+    {
+        const bool passesAll = m_passesAllLevels.load(std::memory_order_relaxed);
+        m_enabledLevels.store(getEnabledMask(passesAll ? LogLevel::TRACE : level),
+                              std::memory_order_relaxed);
+        m_logLevel.store(level, std::memory_order_relaxed);
+    }
+
+    // -------------------------------------------------------------------------
+    void setAppendDateTime(AppendDateTimeFormat level)
+    {
+        m_dateTimeFormat = level;
+    }
+
+    // -------------------------------------------------------------------------
+    // Sub-second digits appended to the time, only used when the time
+    // is appended at all.
+    [[maybe_unused]] void setTimePrecision(Time::Precision precision)
+    {
+        m_timePrecision = precision;
+    }
+
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] LogLevel getLogLevel() const { return m_logLevel.load(std::memory_order_relaxed); }
+
+    // -------------------------------------------------------------------------
+    // What this logger has written, dropped and waited for so far, summed
+    // over the threads that logged through it. Takes a lock, meant for
+    // the occasional read (see MetricsExporter).
+    [[nodiscard]] MetricsSnapshot getMetrics() const { return m_metrics.snapshot(); }
+
+    // -------------------------------------------------------------------------
+    // For records refused before they reach the logger, which is how
+    // GCLOG_ERROR_LIMITED() and friends report theirs.
+    void countSuppressed(std::uint64_t count) { m_metrics.countSuppressed(count); }
+
+    // -------------------------------------------------------------------------
+    // False for levels stripped by GCLOG_MIN_LEVEL, always a constant.
+    static constexpr bool isCompiledIn(LogLevel level)
+    {
+        return static_cast<int>(level) >= GCLOG_MIN_LEVEL;
+    }
+
+    // -------------------------------------------------------------------------
+    // One bit per level, set for threshold and every level above it.
+    static constexpr std::uint8_t getEnabledMask(LogLevel threshold)
+    {
+        return static_cast<std::uint8_t>((0x1F << static_cast<int>(threshold)) & 0x1F);
+    }
+
+    // -------------------------------------------------------------------------
+    // The test every logger applies before writing a record at level,
+    // true for level and above (and for every level while a backtrace
+    // keeps the ones below). One relaxed load and one bit test.
+    [[nodiscard]] bool isEnabled(LogLevel level) const
+    {
+        return isCompiledIn(level)
+               && (m_enabledLevels.load(std::memory_order_relaxed) >> static_cast<int>(level) & 1) != 0;
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] Time::Precision getTimePrecision() const { return m_timePrecision; }
+
+    // -------------------------------------------------------------------------
+    // Writes the configured date/time suffix into out, which must hold
+    // Time::MaxFormattedSize chars, and returns its length.
+    std::size_t writeDateTime(char *out) const {
+        if (const timespec *time = detail::recordTime()) {
+            return writeDateTime(out, *time);
+        }
+        switch (m_dateTimeFormat) {
+            case AppendDateTimeFormat::TIME_ONLY:
+                return Time::format(out, true, false, m_timePrecision);
+            case AppendDateTimeFormat::DATE_ONLY:
+                return Time::format(out, false, true, m_timePrecision);
+            case AppendDateTimeFormat::DATE_TIME:
+                return Time::format(out, true, true, m_timePrecision);
+            case AppendDateTimeFormat::NONE:
+                break;
+        }
+        return 0;
+    }
+
+    // -------------------------------------------------------------------------
+    // As writeDateTime(out) for a wall clock time taken earlier.
+    std::size_t writeDateTime(char *out, const timespec &time) const {
+        switch (m_dateTimeFormat) {
+            case AppendDateTimeFormat::TIME_ONLY:
+                return Time::formatAt(out, time, true, false, m_timePrecision);
+            case AppendDateTimeFormat::DATE_ONLY:
+                return Time::formatAt(out, time, false, true, m_timePrecision);
+            case AppendDateTimeFormat::DATE_TIME:
+                return Time::formatAt(out, time, true, true, m_timePrecision);
+            case AppendDateTimeFormat::NONE:
+                break;
+        }
+        return 0;
+    }
+
+    // -------------------------------------------------------------------------
+    inline std::string getDateTimeString() {
+        char date_time[Time::MaxFormattedSize];
+        return {date_time, writeDateTime(date_time)};
+    }
+
+    // -------------------------------------------------------------------------
+    // The "[LEVEL]: " tag each line starts with.
+    static constexpr std::string_view getLevelTag(LogLevel level) {
+        switch (level) {
+            case LogLevel::TRACE:
+                return "[TRACE]: ";
+            case LogLevel::DEBUG:
+                return "[DEBUG]: ";
+            case LogLevel::INFO:
+                return "[INFO]: ";
+            case LogLevel::WARN:
+                return "[WARN]: ";
+            case LogLevel::ERROR:
+                return "[ERROR]: ";
+        }
+        return "";
+    }
+
+    // The one method a logger overrides to write a record, every other
+    // string, fmt style and field overload ends up here or in vlog().
+    // Not pure virtual so you can use as a null logger if you want.
+    // Called for any level, loggers check isEnabled() themselves.
+    virtual void log([[maybe_unused]] LogLevel level, [[maybe_unused]] const std::string &message) {};
+
+    // -------------------------------------------------------------------------
+    void trace(const std::string &message) { log(LogLevel::TRACE, message); }
+
+    void debug(const std::string &message) { log(LogLevel::DEBUG, message); }
+
+    void error(const std::string &message) { log(LogLevel::ERROR, message); }
+
+    void warn(const std::string &message) { log(LogLevel::WARN, message); }
+
+    void info(const std::string &message) { log(LogLevel::INFO, message); }
+
+    // Blocks until everything logged so far has been handed to the
+    // destination, loggers that write synchronously have nothing to do.
+    virtual void flush() {};
+
+    // -------------------------------------------------------------------------
+    // flush() for CrashHandler, with async-signal-safe calls only: no
+    // locks, no allocation, no formatting. Best effort, a line another
+    // thread is writing at the time may be torn. Records that can't
+    // reach their destination that way are written raw to fd.
+    virtual void flushFromSignal([[maybe_unused]] int fd) {};
+
+    // False for a logger whose flushFromSignal() would lose what it
+    // holds, CrashHandler::add() turns those down.
+    [[nodiscard]] virtual bool flushesFromSignal() const { return true; }
+
+    // -------------------------------------------------------------------------
+    // Writes one record whose message is format applied to args, called
+    // by the fmt style overloads below once the level is known to be
+    // enabled. The default formats the message on its own and passes it
+    // to log(), loggers that render whole lines override it to format
+    // the message straight into the line.
+    virtual void vlog(LogLevel level, fmt::string_view format, fmt::format_args args)
+    {
+        auto &buffer = detail::lineBuffer();
+        buffer.clear();
+        fmt::vformat_to(std::back_inserter(buffer), format, args);
+        log(level, std::string(buffer.data(), buffer.size()));
+    }
+
+    // -------------------------------------------------------------------------
+    // Writes one record of a message and typed fields, called by the
+    // field overloads below once the level is known to be enabled. The
+    // default appends the fields as " key=value" text and passes the
+    // result to vlog(), loggers that encode fields override it.
+    virtual void vlogFields(LogLevel level, std::string_view message, std::span<const Field> fields)
+    {
+        fmt::memory_buffer text;
+        text.append(message);
+        detail::appendFieldsText(text, fields);
+        const std::string_view view(text.data(), text.size());
+        vlog(level, "{}", fmt::make_format_args(view));
+    }
+
+    // fmt style overloads -----------------------------------------------------
+    //
+    // log.info("user {} took {} ms", id, ms). The format string is checked
+    // at compile time, and the arguments are only formatted if the level
+    // is enabled.
+    template<typename... Args>
+        requires (sizeof...(Args) > 0 && (!FieldArg<Args> && ...))
+    void trace(fmt::format_string<Args...> format, Args &&...args)
+    {
+        if (isEnabled(LogLevel::TRACE)) {
+            vlog(LogLevel::TRACE, format, fmt::make_format_args(args...));
+        }
+    }
+
+    template<typename... Args>
+        requires (sizeof...(Args) > 0 && (!FieldArg<Args> && ...))
+    void debug(fmt::format_string<Args...> format, Args &&...args)
+    {
+        if (isEnabled(LogLevel::DEBUG)) {
+            vlog(LogLevel::DEBUG, format, fmt::make_format_args(args...));
+        }
+    }
+
+    template<typename... Args>
+        requires (sizeof...(Args) > 0 && (!FieldArg<Args> && ...))
+    void error(fmt::format_string<Args...> format, Args &&...args)
+    {
+        if (isEnabled(LogLevel::ERROR)) {
+            vlog(LogLevel::ERROR, format, fmt::make_format_args(args...));
+        }
+    }
+
+    template<typename... Args>
+        requires (sizeof...(Args) > 0 && (!FieldArg<Args> && ...))
+    void warn(fmt::format_string<Args...> format, Args &&...args)
+    {
+        if (isEnabled(LogLevel::WARN)) {
+            vlog(LogLevel::WARN, format, fmt::make_format_args(args...));
+        }
+    }
+
+    template<typename... Args>
+        requires (sizeof...(Args) > 0 && (!FieldArg<Args> && ...))
+    void info(fmt::format_string<Args...> format, Args &&...args)
+    {
+        if (isEnabled(LogLevel::INFO)) {
+            vlog(LogLevel::INFO, format, fmt::make_format_args(args...));
+        }
+    }
+
+    // Field overloads ---------------------------------------------------------
+    //
+    // log.info("request done", kv("status", 200), kv("ms", 3.2)). The
+    // fields are kept in an array on the stack for the call, nothing is
+    // allocated per field.
+    template<FieldArg... Fields>
+        requires (sizeof...(Fields) > 0)
+    void trace(std::string_view message, const Fields &...fields)
+    {
+        if (isEnabled(LogLevel::TRACE)) {
+            const std::array<Field, sizeof...(Fields)> list{fields...};
+            vlogFields(LogLevel::TRACE, message, list);
+        }
+    }
+
+    template<FieldArg... Fields>
+        requires (sizeof...(Fields) > 0)
+    void debug(std::string_view message, const Fields &...fields)
+    {
+        if (isEnabled(LogLevel::DEBUG)) {
+            const std::array<Field, sizeof...(Fields)> list{fields...};
+            vlogFields(LogLevel::DEBUG, message, list);
+        }
+    }
+
+    template<FieldArg... Fields>
+        requires (sizeof...(Fields) > 0)
+    void error(std::string_view message, const Fields &...fields)
+    {
+        if (isEnabled(LogLevel::ERROR)) {
+            const std::array<Field, sizeof...(Fields)> list{fields...};
+            vlogFields(LogLevel::ERROR, message, list);
+        }
+    }
+
+    template<FieldArg... Fields>
+        requires (sizeof...(Fields) > 0)
+    void warn(std::string_view message, const Fields &...fields)
+    {
+        if (isEnabled(LogLevel::WARN)) {
+            const std::array<Field, sizeof...(Fields)> list{fields...};
+            vlogFields(LogLevel::WARN, message, list);
+        }
+    }
+
+    template<FieldArg... Fields>
+        requires (sizeof...(Fields) > 0)
+    void info(std::string_view message, const Fields &...fields)
+    {
+        if (isEnabled(LogLevel::INFO)) {
+            const std::array<Field, sizeof...(Fields)> list{fields...};
+            vlogFields(LogLevel::INFO, message, list);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // log() for a record taken at time, which its line is stamped with
+    // rather than the time it gets written. How the loggers that queue
+    // records hand them to their backend.
+    void logAt(LogLevel level, const timespec &time, const std::string &message)
+    {
+        struct Restore
+        {
+            const timespec *previous;
+
+            ~Restore() { detail::recordTime() = previous; }
+        } restore{std::exchange(detail::recordTime(), &time)};
+
+        log(level, message);
+    }
+};
+// -----------------------------------------------------------------------------
+// One rendered line, as a Formatter left it and every Sink receives it.
+struct LogLine
+{
+    Logger::LogLevel level;
+    std::string_view text;  // the whole line, '\n' included
+    std::size_t tagSize;    // text starts with the level tag
+    std::size_t bodySize;   // tag, message and date/time, without the line end
+};
+
+// -----------------------------------------------------------------------------
+class Formatter
+{
+public:
+    Formatter() = default;
+    virtual ~Formatter() = default;
+
+    Formatter(const Formatter &) = delete;            // non construction-copyable
+    Formatter(Formatter &&) = delete;                 // non movable
+    Formatter &operator=(const Formatter &) = delete; // non copyable
+    Formatter &operator=(Formatter &&) = delete;      // move assignment
+
+    /**************************************************************
+     * @brief Renders "[LEVEL]: message key=value date/time\n" into
+     * out, which the caller has cleared, taking the date/time
+     * settings from logger, and says where the tag and the body end.
+     * fields is empty for records logged without any.
+     *
+     * @Note: called concurrently by every thread logging through
+     * the owning logger, overrides must not keep state.
+     *************************************************************/
+    virtual LogLine format(fmt::memory_buffer &out,
+                           const Logger &logger,
+                           Logger::LogLevel level,
+                           fmt::string_view format,
+                           fmt::format_args args,
+                           std::span<const Field> fields) const
+    {
+        const std::string_view tag = Logger::getLevelTag(level);
+        out.append(tag.data(), tag.data() + tag.size());
+        fmt::vformat_to(std::back_inserter(out), format, args);
+        detail::appendFieldsText(out, fields);
+
+        char stamp[Time::MaxFormattedSize];
+        out.append(stamp, stamp + logger.writeDateTime(stamp));
+        const std::size_t bodySize = out.size();
+        out.push_back('\n');
+
+        return {level, {out.data(), out.size()}, tag.size(), bodySize};
+    }
+};
+
+// -----------------------------------------------------------------------------
+// A destination for rendered lines. One sink can be shared by several
+// loggers, so write() and flush() are called from any thread and each
+// sink does its own locking.
+class Sink
+{
+public:
+    Sink() = default;
+    virtual ~Sink() = default;
+
+    Sink(const Sink &) = delete;            // non construction-copyable
+    Sink(Sink &&) = delete;                 // non movable
+    Sink &operator=(const Sink &) = delete; // non copyable
+    Sink &operator=(Sink &&) = delete;      // move assignment
+
+    virtual void write(const LogLine &line) = 0;
+
+    // Hands anything the sink buffers to its destination.
+    virtual void flush() {};
+
+    // flush() from a crash handler, see Logger::flushFromSignal().
+    virtual void flushFromSignal() {};
+
+    // What the sink has written and flushed so far, see Logger::getMetrics().
+    [[nodiscard]] virtual MetricsSnapshot getMetrics() const { return m_metrics.snapshot(); }
+
+protected:
+    Metrics m_metrics;
+};
+
+// -----------------------------------------------------------------------------
+class NullSink final : public Sink
+{
+public:
+    void write([[maybe_unused]] const LogLine &line) override {}
+};
+
+// -----------------------------------------------------------------------------
+// Keeps every line, without its '\n', mostly for tests.
+class MemorySink final : public Sink
+{
+private:
+    mutable std::mutex m_mutex;
+    std::vector<std::pair<Logger::LogLevel, std::string>> m_lines;
+
+public:
+    void write(const LogLine &line) override {
+        m_metrics.countBytes(line.text.size());
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_lines.emplace_back(line.level, line.text.substr(0, line.bodySize));
+    }
+
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] std::vector<std::pair<Logger::LogLevel, std::string>> getLines() const {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_lines;
+    }
+
+    // -------------------------------------------------------------------------
+    void clear() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_lines.clear();
+    }
+};
+
+// -----------------------------------------------------------------------------
+class FileSink final : public Sink
+{
+public:
+    // When buffered lines are handed to the kernel. Whatever is set,
+    // a line that does not fit in the buffer forces a write.
+    struct FlushPolicy {
+        std::size_t everyRecords{0};                 // 0 = off
+        std::chrono::milliseconds everyInterval{0};  // 0 = off
+        std::optional<Logger::LogLevel> atLevel{Logger::LogLevel::WARN};
+        bool onShutdown{true};
+    };
+
+    static constexpr std::size_t DefaultBufferSize = 64 * 1024;
+
+    FileSink() = delete;
+
+    [[maybe_unused]] explicit FileSink(std::string filename)
+            : FileSink(std::move(filename), DefaultBufferSize, FlushPolicy{}) {}
+
+    /**************************************************************
+     * @brief Appends to filename through a raw descriptor opened
+     * with O_APPEND, so several processes can share one file, each
+     * write() lands whole lines at the current end of the file.
+     *
+     * @Note: throws std::system_error if the file can't be opened.
+     *************************************************************/
+    [[maybe_unused]] FileSink(
+            std::string filename,
+            std::size_t bufferSize,
+            FlushPolicy flushPolicy)
+            : FileSink(openForAppend(filename), filename, bufferSize, flushPolicy) {}
+
+    // Writes to fd, which the sink closes when it is done, name is only
+    // reported by getFilename().
+    [[maybe_unused]] FileSink(
+            int fd,
+            std::string name,
+            std::size_t bufferSize,
+            FlushPolicy flushPolicy)
+            : m_filename(std::move(name)),
+              m_flushPolicy(flushPolicy),
+              m_fd(fd),
+              m_buffer(std::max<std::size_t>(bufferSize, 1))
+    {
+        if (m_flushPolicy.everyInterval.count() > 0) {
+            m_flusher = std::thread([this] { runIntervalFlush(); });
+        }
+    }
+
+    ~FileSink() override
+    {
+        if (m_flusher.joinable()) {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_stopFlusher = true;
+            }
+            m_flusherWakeup.notify_one();
+            m_flusher.join();
+        }
+
+        if (m_flushPolicy.onShutdown) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            flushLocked();
+        }
+        ::close(m_fd);
+    }
+
+    FileSink(const FileSink &) = delete;            // non construction-copyable
+    FileSink(FileSink &&) = delete;                 // non movable
+    FileSink &operator=(const FileSink &) = delete; // non copyable
+    FileSink &operator=(FileSink &&) = delete;      // move assignment
+
+private:
+    std::mutex m_mutex;
+    std::string m_filename;
+    FlushPolicy m_flushPolicy;
+    int m_fd{-1};
+
+    std::vector<char> m_buffer;
+    std::size_t m_used{0};
+    std::size_t m_recordsSinceFlush{0};
+
+    std::thread m_flusher;
+    std::condition_variable m_flusherWakeup;
+    bool m_stopFlusher{false};
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] const std::string &getFilename() const { return m_filename; }
+
+    [[nodiscard]] const FlushPolicy &getFlushPolicy() const { return m_flushPolicy; }
+
+    // -------------------------------------------------------------------------
+    void flush() override {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        flushLocked();
+    }
+
+    // -------------------------------------------------------------------------
+    // Without the lock, the crashing thread may be holding it.
+    void flushFromSignal() override {
+        detail::writeFromSignal(m_fd, m_buffer.data(), m_used);
+        m_used = 0;
+    }
+
+    // -------------------------------------------------------------------------
+    void write(const LogLine &line) override {
+        m_metrics.countBytes(line.text.size());
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (m_used + line.text.size() > m_buffer.size()) {
+            // Doesn't fit, hand the kernel the buffer and this line in
+            // one call rather than copying a large line around.
+            iovec parts[] = {
+                    {m_buffer.data(), m_used},
+                    {const_cast<char *>(line.text.data()), line.text.size()}};
+            const auto start = std::chrono::steady_clock::now();
+            detail::writeAll(m_fd, parts, std::size(parts));
+            m_metrics.countFlush(std::chrono::steady_clock::now() - start);
+            m_used = 0;
+            m_recordsSinceFlush = 0;
+            return;
+        }
+
+        std::copy(line.text.begin(), line.text.end(), m_buffer.data() + m_used);
+        m_used += line.text.size();
+        ++m_recordsSinceFlush;
+
+        if ((m_flushPolicy.atLevel && line.level >= *m_flushPolicy.atLevel)
+            || (m_flushPolicy.everyRecords != 0
+                && m_recordsSinceFlush >= m_flushPolicy.everyRecords)) {
+            flushLocked();
+        }
+    }
+
+private:
+    // -------------------------------------------------------------------------
+    void flushLocked() {
+        if (m_used != 0) {
+            iovec part{m_buffer.data(), m_used};
+            const auto start = std::chrono::steady_clock::now();
+            detail::writeAll(m_fd, &part, 1);
+            m_metrics.countFlush(std::chrono::steady_clock::now() - start);
+            m_used = 0;
+        }
+        m_recordsSinceFlush = 0;
+    }
+
+    // -------------------------------------------------------------------------
+    static int openForAppend(const std::string &filename) {
+        const int fd = ::open(filename.c_str(),
+                              O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(),
+                                    "gclog: can't open " + filename);
+        }
+        return fd;
+    }
+
+    // -------------------------------------------------------------------------
+    void runIntervalFlush() {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        while (!m_stopFlusher) {
+            m_flusherWakeup.wait_for(guard, m_flushPolicy.everyInterval);
+            flushLocked();
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Writes each line to the console in one write() of its own, lines up
+// to PIPE_BUF bytes can't interleave with other writers even on a pipe.
+// When the output isn't a terminal the escapes are left out and lines
+// are batched, interval flushed, through a FileSink on the descriptor.
+//
+// Goes to the descriptor directly, mixing it with std::cout output
+// that is still buffered can reorder the two.
+class ConsoleSink final : public Sink
+{
+public:
+    enum class ColorizeConsoleOutput : char {
+        NO_COLOR = 0, LEVEL_ONLY, ALL
+    };
+
+    // What a colored line with the standard "[LEVEL]: " tag starts with.
+    using LevelPrefix = detail::FixedString<40>;
+
+    // Ends the colored part of a line.
+    static constexpr ConsoleColor ResetColor{FG_DEFAULT};
+
+    struct OutputPolicy {
+        int fd{STDOUT_FILENO};
+        std::optional<bool> terminal;                 // isatty(fd) when unset
+        std::chrono::milliseconds batchInterval{100}; // 0 = write every line
+        std::size_t batchSize{FileSink::DefaultBufferSize};
+    };
+
+    ConsoleSink() : ConsoleSink(OutputPolicy{}) {}
+
+    [[maybe_unused]] explicit ConsoleSink(OutputPolicy outputPolicy)
+            : ConsoleSink(ColorizeConsoleOutput::NO_COLOR,
+                          ConsoleColor(FG_LIGHT_BLUE), ConsoleColor(FG_DEFAULT),
+                          ConsoleColor(FG_RED), ConsoleColor(FG_GREEN),
+                          ConsoleColor(FG_YELLOW), outputPolicy) {}
+
+    [[maybe_unused]] ConsoleSink(
+            ColorizeConsoleOutput colorizeOutput,
+            ConsoleColor traceColor,
+            ConsoleColor debugColor,
+            ConsoleColor errorColor,
+            ConsoleColor warnColor,
+            ConsoleColor infoColor)
+            : ConsoleSink(colorizeOutput, traceColor, debugColor,
+                          errorColor, warnColor, infoColor, OutputPolicy{}) {}
+
+    [[maybe_unused]] ConsoleSink(
+            ColorizeConsoleOutput colorizeOutput,
+            ConsoleColor traceColor,
+            ConsoleColor debugColor,
+            ConsoleColor errorColor,
+            ConsoleColor warnColor,
+            ConsoleColor infoColor,
+            OutputPolicy outputPolicy)
+            : m_colorizeStyle(colorizeOutput),
+              m_traceColor(traceColor),
+              m_debugColor(debugColor),
+              m_errorColor(errorColor),
+              m_warnColor(warnColor),
+              m_infoColor(infoColor),
+              m_outputPolicy(outputPolicy),
+              m_terminal(outputPolicy.terminal.value_or(::isatty(outputPolicy.fd) == 1))
+    {
+        updatePrefixes();
+
+        // The batch gets a descriptor of its own to close. Without one
+        // lines just aren't batched.
+        if (!m_terminal && m_outputPolicy.batchInterval.count() > 0) {
+            const int fd = ::fcntl(m_outputPolicy.fd, F_DUPFD_CLOEXEC, 0);
+            if (fd >= 0) {
+                FileSink::FlushPolicy flushPolicy;
+                flushPolicy.everyInterval = m_outputPolicy.batchInterval;
+                flushPolicy.atLevel = Logger::LogLevel::ERROR;
+                m_batch = std::make_unique<FileSink>(fd, "<console>",
+                                                     m_outputPolicy.batchSize, flushPolicy);
+            }
+        }
+    }
+
+private:
+    ColorizeConsoleOutput m_colorizeStyle{
+            ColorizeConsoleOutput::NO_COLOR};
+
+    ConsoleColor m_traceColor{FG_LIGHT_BLUE};
+    ConsoleColor m_debugColor{FG_DEFAULT};
+    ConsoleColor m_errorColor{FG_RED};
+    ConsoleColor m_warnColor{FG_GREEN};
+    ConsoleColor m_infoColor{FG_YELLOW};
+
+    // Indexed by level, rebuilt whenever a color or the style changes.
+    std::array<LevelPrefix, 5> m_prefixes{};
+
+    OutputPolicy m_outputPolicy;
+    bool m_terminal;
+    std::unique_ptr<FileSink> m_batch;
+
+public:
+    // -------------------------------------------------------------------------
+    // The escape, tag and reset a line at level starts with in style, in
+    // one piece so writing it is a single copy.
+    static constexpr LevelPrefix makeLevelPrefix(const ConsoleColor &color,
+                                                 Logger::LogLevel level,
+                                                 ColorizeConsoleOutput style) {
+        LevelPrefix prefix;
+        if (style != ColorizeConsoleOutput::NO_COLOR) {
+            prefix.append(color.getEscape());
+        }
+        prefix.append(Logger::getLevelTag(level));
+        if (style == ColorizeConsoleOutput::LEVEL_ONLY) {
+            prefix.append(ResetColor.getEscape());
+        }
+        return prefix;
+    }
+
+    // Setters -----------------------------------------------------------------
+    //
+    // Neither is synchronized with write(), set them before logging.
+    void setColorizeStyle(ColorizeConsoleOutput style) {
+        m_colorizeStyle = style;
+        updatePrefixes();
+    }
+
+    // -------------------------------------------------------------------------
+    void setColor(Logger::LogLevel level, ConsoleColor color) {
+        getColor(level) = color;
+        updatePrefixes();
+    }
+
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] ColorizeConsoleOutput getColorizeStyle() const { return m_colorizeStyle; }
+
+    [[nodiscard]] const OutputPolicy &getOutputPolicy() const { return m_outputPolicy; }
+
+    // True if lines get colors and are written one by one.
+    [[nodiscard]] bool isTerminal() const { return m_terminal; }
+
+    // -------------------------------------------------------------------------
+    void flush() override {
+        if (m_batch) {
+            m_batch->flush();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void flushFromSignal() override {
+        if (m_batch) {
+            m_batch->flushFromSignal();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // The batch's writes are the flushes, lines written one by one aren't.
+    [[nodiscard]] MetricsSnapshot getMetrics() const override {
+        MetricsSnapshot snapshot = m_metrics.snapshot();
+        if (m_batch) {
+            snapshot.addFlushes(m_batch->getMetrics());
+        }
+        return snapshot;
+    }
+
+    // -------------------------------------------------------------------------
+    void write(const LogLine &line) override
+    {
+        /**************************************************************
+         * @brief Wraps the plain line in escapes, in a buffer of its
+         * own as the line itself sits in the thread's line buffer,
+         * and hands it to the descriptor in one write.
+         *
+         * @Note: anything but a terminal gets the plain line as is,
+         * there is nothing to render, and so does a terminal when
+         * colors are off.
+         *************************************************************/
+        if (!m_terminal || m_colorizeStyle == ColorizeConsoleOutput::NO_COLOR) {
+            m_metrics.countBytes(line.text.size());
+            if (m_batch) {
+                m_batch->write(line);
+            } else {
+                iovec part{const_cast<char *>(line.text.data()), line.text.size()};
+                detail::writeAll(m_outputPolicy.fd, &part, 1);
+            }
+            return;
+        }
+
+        thread_local fmt::memory_buffer out;
+        out.clear();
+
+        const char *text = line.text.data();
+        const std::string_view tag(text, line.tagSize);
+
+        // Other formatters tag lines their own way, their tag is
+        // wrapped as it comes.
+        if (tag == Logger::getLevelTag(line.level)) {
+            out.append(m_prefixes[static_cast<std::size_t>(line.level)].view());
+        } else {
+            getColor(line.level).appendTo(out);
+            out.append(tag);
+            if (m_colorizeStyle == ColorizeConsoleOutput::LEVEL_ONLY) {
+                ResetColor.appendTo(out);
+            }
+        }
+
+        out.append(text + line.tagSize, text + line.bodySize);
+        if (m_colorizeStyle == ColorizeConsoleOutput::ALL) {
+            ResetColor.appendTo(out);
+        }
+        out.append(text + line.bodySize, text + line.text.size());
+
+        m_metrics.countBytes(out.size());
+        iovec part{out.data(), out.size()};
+        detail::writeAll(m_outputPolicy.fd, &part, 1);
+    }
+
+private:
+    // -------------------------------------------------------------------------
+    void updatePrefixes() {
+        for (std::size_t index = 0; index < m_prefixes.size(); ++index) {
+            const auto level = static_cast<Logger::LogLevel>(index);
+            m_prefixes[index] = makeLevelPrefix(getColor(level), level, m_colorizeStyle);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] ConsoleColor &getColor(Logger::LogLevel level) {
+        switch (level) {
+            case Logger::LogLevel::TRACE:
+                return m_traceColor;
+            case Logger::LogLevel::DEBUG:
+                return m_debugColor;
+            case Logger::LogLevel::INFO:
+                return m_infoColor;
+            case Logger::LogLevel::WARN:
+                return m_warnColor;
+            case Logger::LogLevel::ERROR:
+                break;
+        }
+        return m_errorColor;
+    }
+};
+
+// -----------------------------------------------------------------------------
+// A token bucket of burst tokens refilled at perSecond, kept as the one
+// atomic "theoretical arrival time" of the generic cell rate algorithm so
+// that taking a token is a load and a compare-exchange, no lock.
+// GCLOG_ERROR_LIMITED() and friends keep one per call site.
+class RateLimiter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    RateLimiter() = delete;
 
-        friend std::ostream &
-        operator<<(std::ostream &os, const ConsoleColor &mod) {
-        return os << "\033[" << mod.code << "m";
+    explicit RateLimiter(std::uint32_t perSecond)
+            : RateLimiter(perSecond, perSecond) {}
+
+    RateLimiter(std::uint32_t perSecond, std::uint32_t burst)
+            : m_interval(1000000000 / std::max<std::int64_t>(perSecond, 1)),
+              m_tolerance(m_interval * (std::max<std::int64_t>(burst, 1) - 1)) {}
+
+    RateLimiter(const RateLimiter &) = delete;            // non construction-copyable
+    RateLimiter(RateLimiter &&) = delete;                 // non movable
+    RateLimiter &operator=(const RateLimiter &) = delete; // non copyable
+    RateLimiter &operator=(RateLimiter &&) = delete;      // move assignment
+
+private:
+    const std::int64_t m_interval;   // ns per token
+    const std::int64_t m_tolerance;  // ns of burst
+    std::atomic<std::int64_t> m_arrival{std::numeric_limits<std::int64_t>::min() / 2};
+    std::atomic<std::uint64_t> m_refused{0};
+
+public:
+    /**************************************************************
+     * @brief Takes a token if there is one.
+     *
+     * @Note: empty when over the limit, otherwise the number of
+     * calls refused since the last one that got a token.
+     *************************************************************/
+    std::optional<std::uint64_t> tryAcquire(Clock::time_point time = Clock::now()) {
+        const std::int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                time.time_since_epoch()).count();
+
+        std::int64_t arrival = m_arrival.load(std::memory_order_relaxed);
+        do {
+            if (arrival - m_tolerance > now) {
+                m_refused.fetch_add(1, std::memory_order_relaxed);
+                return std::nullopt;
+            }
+        } while (!m_arrival.compare_exchange_weak(arrival, std::max(arrival, now) + m_interval,
+                                                  std::memory_order_relaxed));
+
+        return m_refused.exchange(0, std::memory_order_relaxed);
     }
 };
+
 // -----------------------------------------------------------------------------
-class Time
+// Collapses a run of the same record into the record and one "last
+// message repeated N times" line. The same record means the same level
+// and format string (the same text for the string overloads), decided
+// before anything is formatted, so one statement logging different
+// arguments in a loop counts as repeating.
+//
+// Two relaxed atomics, no lock. Under contention a repeat can be counted
+// against a neighbouring run, the total stays right.
+class Deduplicator
 {
 public:
-    inline static std::string getTime() {
-        std::ostringstream oss;
+    struct Repeats {
+        std::uint64_t count;
+        Logger::LogLevel level;
+    };
 
-        // Current date/time based on current system.
-        time_t now = time(nullptr);
+    // -------------------------------------------------------------------------
+    // FNV-1a of text with the level in the low bits.
+    static constexpr std::uint64_t getKey(Logger::LogLevel level, std::string_view text) {
+        std::uint64_t hash = 0xcbf29ce484222325;
+        for (const char c : text) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+        }
+        return hash << 3 | static_cast<std::uint64_t>(level);
+    }
+
+    // -------------------------------------------------------------------------
+    // True if key repeats the previous record, which is then counted.
+    // Otherwise key becomes the previous record and ended is set to
+    // the repeats of the run it ends.
+    bool isRepeat(std::uint64_t key, Repeats &ended) {
+        if (m_last.load(std::memory_order_relaxed) == key) {
+            m_repeats.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        const std::uint64_t previous = m_last.exchange(key, std::memory_order_relaxed);
+        if (previous == key) {
+            m_repeats.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        ended = {m_repeats.exchange(0, std::memory_order_relaxed), getLevel(previous)};
+        return false;
+    }
 
-        // This returns a pointer to the time in the
-        // form of a tm structure.
-        // The time is represented in Coordinated Universal
-        // Time (UTC), which is essentially
-        // Greenwich Mean Time (GMT).
-        tm *ltm = localtime(&now);
+    // -------------------------------------------------------------------------
+    // Ends the current run, a later record with its key is not a repeat.
+    Repeats takeRepeats() {
+        const std::uint64_t previous = m_last.exchange(NoKey, std::memory_order_relaxed);
+        return {m_repeats.exchange(0, std::memory_order_relaxed), getLevel(previous)};
+    }
 
-        // Fill oss stream with various time components
-        // of tm structure.
-        oss << ' ' << ltm->tm_hour << ':'
-            << ltm->tm_min << ':'
-            << ltm->tm_sec;
+private:
+    // Never a key, those have a level (0 to 4) in the low bits.
+    static constexpr std::uint64_t NoKey = ~std::uint64_t{0};
 
-        return oss.str();
+    static constexpr Logger::LogLevel getLevel(std::uint64_t key) {
+        return key == NoKey ? Logger::LogLevel::INFO : static_cast<Logger::LogLevel>(key & 7);
     }
 
-// -----------------------------------------------------------------------------
-    inline static std::string getDate() {
-        std::ostringstream oss;
+    std::atomic<std::uint64_t> m_last{NoKey};
+    std::atomic<std::uint64_t> m_repeats{0};
+};
 
-        // Current date/time based on current system.
-        time_t now = time(nullptr);
+// -----------------------------------------------------------------------------
+// The last N rendered lines in fixed size slots, oldest overwritten
+// first. Not synchronised, Backtrace gives each thread its own or locks.
+class BacktraceRing
+{
+public:
+    BacktraceRing(std::size_t records, std::size_t recordSize)
+            : m_recordSize(std::max<std::size_t>(recordSize, 2)),
+              m_slots(std::max<std::size_t>(records, 1)),
+              m_text(m_slots.size() * m_recordSize) {}
 
-        // This returns a pointer to the time in the form
-        // of a tm structure.
-        // The time is represented in Coordinated Universal
-        // Time (UTC), which is essentially
-        // Greenwich Mean Time (GMT).
-        tm *ltm = localtime(&now);
+    // -------------------------------------------------------------------------
+    // Copies line into the next slot, cut to recordSize with its '\n'.
+    void push(const LogLine &line) {
+        Slot &slot = m_slots[m_next];
+        char *text = &m_text[m_next * m_recordSize];
+
+        if (line.text.size() <= m_recordSize) {
+            std::memcpy(text, line.text.data(), line.text.size());
+            slot.size = line.text.size();
+        } else {
+            std::memcpy(text, line.text.data(), m_recordSize - 1);
+            text[m_recordSize - 1] = '\n';
+            slot.size = m_recordSize;
+        }
+        slot.level = line.level;
+        slot.tagSize = std::min(line.tagSize, slot.size - 1);
+        slot.bodySize = std::min(line.bodySize, slot.size - 1);
 
-        // Fill oss stream with various date components
-        // of tm structure.
-        oss << ' ' << ltm->tm_mday << '/'
-            << 1 + ltm->tm_mon << '/'
-            << 1900 + ltm->tm_year;
+        m_next = (m_next + 1) % m_slots.size();
+        m_count = std::min(m_count + 1, m_slots.size());
+    }
 
-        return oss.str();
+    // -------------------------------------------------------------------------
+    // Hands every kept line to write, oldest first, and empties the ring.
+    template<typename Write>
+    void drain(Write &&write) {
+        std::size_t index = (m_next + m_slots.size() - m_count) % m_slots.size();
+        for (; m_count != 0; --m_count) {
+            const Slot &slot = m_slots[index];
+            write(LogLine{slot.level, {&m_text[index * m_recordSize], slot.size},
+                          slot.tagSize, slot.bodySize});
+            index = (index + 1) % m_slots.size();
+        }
     }
+
+    // -------------------------------------------------------------------------
+    // Forgets the kept lines, e.g. an exited thread's, nobody can dump them.
+    void clear() { m_count = 0; }
+
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] std::size_t getCount() const { return m_count; }
+
+private:
+    struct Slot
+    {
+        Logger::LogLevel level{Logger::LogLevel::TRACE};
+        std::size_t size{0};
+        std::size_t tagSize{0};
+        std::size_t bodySize{0};
+    };
+
+    std::size_t m_recordSize;
+    std::vector<Slot> m_slots;
+    std::vector<char> m_text;
+    std::size_t m_next{0};
+    std::size_t m_count{0};
 };
+
 // -----------------------------------------------------------------------------
-class Logger
+// Where a SinkLogger keeps the records below its level, one ring per
+// thread (no locking, a dump only sees the dumping thread's records) or
+// one ring for the logger behind a mutex.
+class Backtrace
 {
 public:
-    enum class LogLevel : char {
-        TRACE = 0, DEBUG = 1, INFO = 2, WARN = 3, ERROR = 4
-    };
-    enum class AppendDateTimeFormat : char {
-        NONE = 0, TIME_ONLY, DATE_ONLY, DATE_TIME
+    struct BacktracePolicy {
+        std::size_t records{32};                  // kept per ring
+        std::size_t recordSize{256};              // longer lines are cut
+        bool perThread{true};
+        Logger::LogLevel dumpAt{Logger::LogLevel::ERROR};
     };
 
-    Logger() = delete;
-    explicit Logger(LogLevel logLevel)
-            : m_logLevel(logLevel) {}
+    Backtrace() = delete;
 
-    Logger(LogLevel logLevel, AppendDateTimeFormat dateTimeFormat)
-            : m_dateTimeFormat(dateTimeFormat), m_logLevel(logLevel) {}
+    explicit Backtrace(BacktracePolicy backtracePolicy)
+            : m_backtracePolicy(backtracePolicy),
+              m_rings([backtracePolicy] {
+                  return std::make_unique<BacktraceRing>(backtracePolicy.records,
+                                                         backtracePolicy.recordSize);
+              }, [](BacktraceRing &ring) { ring.clear(); }),
+              m_shared(backtracePolicy.records, backtracePolicy.recordSize) {}
 
-    virtual ~Logger() = default;
+    Backtrace(const Backtrace &) = delete;            // non construction-copyable
+    Backtrace(Backtrace &&) = delete;                 // non movable
+    Backtrace &operator=(const Backtrace &) = delete; // non copyable
+    Backtrace &operator=(Backtrace &&) = delete;      // move assignment
 
-    Logger(const Logger &) = delete;            // non construction-copyable
-    Logger(Logger &&) = delete;                 // non movable
-    Logger &operator=(const Logger &) = delete; // non copyable
-    Logger &operator=(Logger &&) = delete;      // move assignment
+private:
+    BacktracePolicy m_backtracePolicy;
+    detail::PerThread<BacktraceRing> m_rings;
+    std::mutex m_sharedMutex;
+    BacktraceRing m_shared;
+    std::atomic<bool> m_dumpRequested{false};
 
-protected:
-    std::mutex lock;
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] const BacktracePolicy &getBacktracePolicy() const { return m_backtracePolicy; }
+
+    // -------------------------------------------------------------------------
+    void capture(const LogLine &line) {
+        if (m_backtracePolicy.perThread) {
+            m_rings.local().push(line);
+            return;
+        }
+        std::lock_guard<std::mutex> guard(m_sharedMutex);
+        m_shared.push(line);
+    }
+
+    // -------------------------------------------------------------------------
+    // Writes the kept records, oldest first, to sinks and forgets them.
+    void dumpTo(const std::vector<std::shared_ptr<Sink>> &sinks) {
+        m_dumpRequested.store(false, std::memory_order_relaxed);
+        const auto write = [&sinks](const LogLine &line) {
+            for (const auto &sink : sinks) {
+                sink->write(line);
+            }
+        };
+        if (m_backtracePolicy.perThread) {
+            m_rings.local().drain(write);
+            return;
+        }
+        std::lock_guard<std::mutex> guard(m_sharedMutex);
+        m_shared.drain(write);
+    }
+
+    // -------------------------------------------------------------------------
+    // Async-signal-safe, the next record logged dumps the backtrace first.
+    void requestDump() { m_dumpRequested.store(true, std::memory_order_relaxed); }
+
+    [[nodiscard]] bool isDumpRequested() const {
+        return m_dumpRequested.load(std::memory_order_relaxed);
+    }
+};
+
+// -----------------------------------------------------------------------------
+// A logger that renders each record once with its Formatter and hands the
+// line to all of its sinks, log.addSink(console); log.addSink(file);
+// replaces running a ConsoleLogger and a FileLogger side by side.
+class SinkLogger : public Logger
+{
+public:
+    SinkLogger() = delete;
+
+    [[maybe_unused]] explicit SinkLogger(LogLevel logLevel)
+            : Logger(logLevel) {}
+
+    [[maybe_unused]] SinkLogger(
+            LogLevel logLevel, AppendDateTimeFormat dateTimeFormat)
+            : Logger(logLevel, dateTimeFormat) {}
+
+    [[maybe_unused]] SinkLogger(
+            LogLevel logLevel, std::vector<std::shared_ptr<Sink>> sinks)
+            : Logger(logLevel), m_sinks(std::move(sinks)) {}
+
+    SinkLogger(const SinkLogger &) = delete;            // non construction-copyable
+    SinkLogger(SinkLogger &&) = delete;                 // non movable
+    SinkLogger &operator=(const SinkLogger &) = delete; // non copyable
+    SinkLogger &operator=(SinkLogger &&) = delete;      // move assignment
 
 private:
-    AppendDateTimeFormat m_dateTimeFormat{AppendDateTimeFormat::DATE_TIME};
-    LogLevel m_logLevel{LogLevel::INFO};
+    std::unique_ptr<const Formatter> m_formatter{std::make_unique<Formatter>()};
+    std::vector<std::shared_ptr<Sink>> m_sinks;
+    std::unique_ptr<Backtrace> m_backtrace;
+    std::unique_ptr<Deduplicator> m_deduplicator;
 
 public:
     // Setters -----------------------------------------------------------------
     //
-    [[maybe_unused]] void setLevel(LogLevel level) { m_logLevel = level; }
+    // Not synchronised with logging, put the pipeline together before
+    // the logger is shared between threads.
+    void addSink(std::shared_ptr<Sink> sink) { m_sinks.push_back(std::move(sink)); }
 
     // -------------------------------------------------------------------------
-    void setAppendDateTime(AppendDateTimeFormat level)
+    [[maybe_unused]] void setFormatter(std::unique_ptr<const Formatter> formatter)
     {
-        m_dateTimeFormat = level;
+        m_formatter = std::move(formatter);
+    }
+
+    // -------------------------------------------------------------------------
+    /**************************************************************
+     * @brief Keeps the records below the level in memory instead
+     * of dropping them, the last backtracePolicy.records of them,
+     * and writes them out ahead of the next record at dumpAt or
+     * above, or when dumpBacktrace() is called.
+     *
+     * @Note: every level then gets rendered, records below the
+     * level cost a format and a memcpy into the ring rather than
+     * a level check.
+     *************************************************************/
+    [[maybe_unused]] void enableBacktrace(Backtrace::BacktracePolicy backtracePolicy = {})
+    {
+        m_backtrace = std::make_unique<Backtrace>(backtracePolicy);
+        setPassesAllLevels(true);
+    }
+
+    // -------------------------------------------------------------------------
+    [[maybe_unused]] void disableBacktrace()
+    {
+        setPassesAllLevels(false);
+        m_backtrace.reset();
+    }
+
+    // -------------------------------------------------------------------------
+    // Collapses runs of the same record, see Deduplicator. A run still
+    // open is reported by the next different record or by flush().
+    [[maybe_unused]] void setDeduplicate(bool deduplicate)
+    {
+        m_deduplicator = deduplicate ? std::make_unique<Deduplicator>() : nullptr;
     }
 
     // Getters -----------------------------------------------------------------
-    [[nodiscard]] LogLevel getLogLevel() const { return m_logLevel; }
+    [[nodiscard]] const std::vector<std::shared_ptr<Sink>> &getSinks() const { return m_sinks; }
+
+    [[nodiscard]] const Formatter &getFormatter() const { return *m_formatter; }
+
+    // nullptr unless enableBacktrace() was called.
+    [[nodiscard]] Backtrace *getBacktrace() const { return m_backtrace.get(); }
 
     // -------------------------------------------------------------------------
-    inline std::string getDateTimeString() {
-        std::string date_time;
-        date_time.reserve(32);
+    // Writes out the records the backtrace kept, the calling thread's
+    // ones with a per thread backtrace. requestDump() on getBacktrace()
+    // is the way to ask for one from a signal handler.
+    [[maybe_unused]] void dumpBacktrace()
+    {
+        if (m_backtrace) {
+            m_backtrace->dumpTo(m_sinks);
+        }
+    }
 
-        switch (m_dateTimeFormat) {
-            case AppendDateTimeFormat::TIME_ONLY:
-                date_time += Time::getTime();
-                break;
-            case AppendDateTimeFormat::DATE_ONLY:
-                date_time += Time::getDate();
-                break;
-            case AppendDateTimeFormat::DATE_TIME:
-                date_time += Time::getTime();
-                date_time += Time::getDate();
-                break;
-            case AppendDateTimeFormat::NONE:
-                break;
+    // -------------------------------------------------------------------------
+    void log(LogLevel level, const std::string &message) override {
+        if (isEnabled(level) && !isRepeat(level, message)) {
+            render(level, "{}", fmt::make_format_args(message), {});
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void flush() override {
+        if (m_deduplicator) {
+            writeRepeats(m_deduplicator->takeRepeats());
+        }
+        for (const auto &sink : m_sinks) {
+            sink->flush();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void flushFromSignal([[maybe_unused]] int fd) override {
+        for (const auto &sink : m_sinks) {
+            sink->flushFromSignal();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void vlog(LogLevel level, fmt::string_view format, fmt::format_args args) override {
+        if (!isRepeat(level, {format.data(), format.size()})) {
+            render(level, format, args, {});
         }
+    }
 
-        return date_time;
+    // -------------------------------------------------------------------------
+    void vlogFields(LogLevel level, std::string_view message, std::span<const Field> fields) override {
+        if (!isRepeat(level, message)) {
+            render(level, "{}", fmt::make_format_args(message), fields);
+        }
     }
 
-    // Base Logger virtual methods, not pure virtual so you can use
-    // as a null logger if you want.
-    virtual void trace([[maybe_unused]] const std::string &message) {};
+private:
+    // -------------------------------------------------------------------------
+    void render(LogLevel level, fmt::string_view format, fmt::format_args args,
+                std::span<const Field> fields) {
+        auto &buffer = detail::lineBuffer();
+        buffer.clear();
 
-    virtual void debug([[maybe_unused]] const std::string &message) {};
+        emit(m_formatter->format(buffer, *this, level, format, args, fields));
+    }
 
-    virtual void error([[maybe_unused]] const std::string &message) {};
+    // -------------------------------------------------------------------------
+    // Only records that would be written take part, not the ones a
+    // backtrace keeps.
+    bool isRepeat(LogLevel level, std::string_view text) {
+        if (!m_deduplicator || level < getLogLevel()) {
+            return false;
+        }
+        Deduplicator::Repeats ended{};
+        if (m_deduplicator->isRepeat(Deduplicator::getKey(level, text), ended)) {
+            m_metrics.countSuppressed();
+            return true;
+        }
+        writeRepeats(ended);
+        return false;
+    }
 
-    virtual void warn([[maybe_unused]] const std::string &message) {};
+    // -------------------------------------------------------------------------
+    void writeRepeats(const Deduplicator::Repeats &repeats) {
+        if (repeats.count != 0) {
+            render(repeats.level, "last message repeated {} times",
+                   fmt::make_format_args(repeats.count), {});
+        }
+    }
 
-    virtual void info([[maybe_unused]] const std::string &message) {};
+    // -------------------------------------------------------------------------
+    void emit(const LogLine &line) {
+        if (m_backtrace) {
+            if (line.level < getLogLevel()) {
+                m_backtrace->capture(line);
+                return;
+            }
+            if (line.level >= m_backtrace->getBacktracePolicy().dumpAt
+                || m_backtrace->isDumpRequested()) {
+                m_backtrace->dumpTo(m_sinks);
+            }
+        }
+        m_metrics.countRecord(static_cast<std::size_t>(line.level));
+        for (const auto &sink : m_sinks) {
+            sink->write(line);
+        }
+    }
 };
+
 // -----------------------------------------------------------------------------
-class ConsoleLogger final : public Logger
+class ConsoleLogger final : public SinkLogger
 {
 public:
-    enum class ColorizeConsoleOutput : char {
-        NO_COLOR = 0, LEVEL_ONLY, ALL
-    };
+    using ColorizeConsoleOutput = ConsoleSink::ColorizeConsoleOutput;
 
     ConsoleLogger() = delete;
 
     [[maybe_unused]] explicit ConsoleLogger(LogLevel logLevel)
-            : Logger(logLevel) {}
+            : SinkLogger(logLevel) { addSink(m_sink); }
 
     [[maybe_unused]] ConsoleLogger(
             LogLevel logLevel, AppendDateTimeFormat dateTimeFormat)
-            : Logger(logLevel, dateTimeFormat) {}
+            : SinkLogger(logLevel, dateTimeFormat) { addSink(m_sink); }
 
     [[maybe_unused]] ConsoleLogger(
             LogLevel logLevel,
             ConsoleColor errorColor,
             ConsoleColor warnColor,
             ConsoleColor infoColor)
-            : Logger(logLevel),
-              m_errorColor(errorColor),
-              m_warnColor(warnColor),
-              m_infoColor(infoColor) {}
+            : SinkLogger(logLevel)
+    {
+        m_sink->setColor(LogLevel::ERROR, errorColor);
+        m_sink->setColor(LogLevel::WARN, warnColor);
+        m_sink->setColor(LogLevel::INFO, infoColor);
+        addSink(m_sink);
+    }
 
     [[maybe_unused]] ConsoleLogger(
             LogLevel logLevel,
@@ -246,209 +2262,135 @@ public:
             ConsoleColor errorColor,
             ConsoleColor warnColor,
             ConsoleColor infoColor)
-            : Logger(logLevel, dateTimeFormat),
-              m_colorizeStyle(colorizeOutput),
-              m_traceColor(traceColor),
-              m_debugColor(debugColor),
-              m_errorColor(errorColor),
-              m_warnColor(warnColor),
-              m_infoColor(infoColor) {}
-
+            : SinkLogger(logLevel, dateTimeFormat),
+              m_sink(std::make_shared<ConsoleSink>(
+                      colorizeOutput, traceColor, debugColor,
+                      errorColor, warnColor, infoColor))
+    {
+        addSink(m_sink);
+    }
 
-    ConsoleLogger(const ConsoleLogger &) = delete;      // non construction-copyable
+    ConsoleLogger(const ConsoleLogger &) = delete;            // non construction-copyable
     ConsoleLogger(ConsoleLogger &&) = delete;                 // non movable
     ConsoleLogger &operator=(const ConsoleLogger &) = delete; // non copyable
     ConsoleLogger &operator=(ConsoleLogger &&) = delete;      // move assignment
 
 private:
-    ColorizeConsoleOutput m_colorizeStyle{
-            ColorizeConsoleOutput::NO_COLOR};
-
-    ConsoleColor m_defaultColor{FG_DEFAULT};
-    ConsoleColor m_traceColor{FG_LIGHT_BLUE};
-    ConsoleColor m_debugColor{FG_DEFAULT};
-    ConsoleColor m_errorColor{FG_RED};
-    ConsoleColor m_warnColor{FG_GREEN};
-    ConsoleColor m_infoColor{FG_YELLOW};
+    std::shared_ptr<ConsoleSink> m_sink{std::make_shared<ConsoleSink>()};
 
 public:
     // -------------------------------------------------------------------------
     void setConsoleColourStyle(ColorizeConsoleOutput style) {
-        m_colorizeStyle = style;
-    }
-
-    // -------------------------------------------------------------------------
-    void trace(const std::string &message) override {
-        /**************************************************************
-         * @brief
-         *
-         * @Note: cout is thread safe, to avoid multiple threads
-         * interleaving on one line though, we make sure to only
-         * call the << operator once on std::cout otherwise the
-         * << operators from different threads could interleave
-         * obviously we dont care if flushes interleave
-         *************************************************************/
-
-        if (getLogLevel() >= LogLevel::TRACE) {
-            std::string date_time = getDateTimeString();
-
-            switch (m_colorizeStyle) {
-                case ColorizeConsoleOutput::NO_COLOR:
-                    std::cout << m_defaultColor << "[TRACE]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::LEVEL_ONLY:
-                    std::cout << m_traceColor << "[TRACE]: "
-                              << m_defaultColor << message << date_time << '\n';
-
-                    break;
-                case ColorizeConsoleOutput::ALL:
-                    std::cout << m_traceColor << "[TRACE]: " << message
-                              << date_time << m_defaultColor << '\n';
-                    break;
-            }
-
-            std::cout.flush();
-        }
-    }
-
-    // ---------------------------------------------------------------------
-    void debug(const std::string &message) override {
-        if (getLogLevel() >= LogLevel::DEBUG) {
-            std::string date_time = getDateTimeString();
-
-            switch (m_colorizeStyle) {
-                case ColorizeConsoleOutput::NO_COLOR:
-                    std::cout << m_defaultColor << "[DEBUG]]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::LEVEL_ONLY:
-                    std::cout << m_debugColor << "[DEBUG]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::ALL:
-                    std::cout << m_debugColor << "[DEBUG]: " << message
-                              << date_time << m_defaultColor << '\n';
-                    break;
-            }
-
-            std::cout.flush();
-        }
-    }
-
-    // ---------------------------------------------------------------------
-    void error(const std::string &message) override {
-        if (getLogLevel() >= LogLevel::ERROR) {
-            std::string date_time = getDateTimeString();
-
-            switch (m_colorizeStyle) {
-                case ColorizeConsoleOutput::NO_COLOR:
-                    std::cout << m_defaultColor << "[ERROR]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::LEVEL_ONLY:
-                    std::cout << m_errorColor << "[ERROR]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::ALL:
-                    std::cout << m_errorColor << "[ERROR]: " << message
-                              << date_time << m_defaultColor << '\n';
-                    break;
-            }
-
-            std::cout.flush();
-        }
-    }
-    // ---------------------------------------------------------------------
-    void warn(const std::string& message) override
-    {
-        if (getLogLevel() >= LogLevel::WARN) {
-            std::string date_time = getDateTimeString();
-
-            switch (m_colorizeStyle) {
-                case ColorizeConsoleOutput::NO_COLOR:
-                    std::cout << m_defaultColor << "[WARN]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::LEVEL_ONLY:
-                    std::cout << m_warnColor << "[WARN]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::ALL:
-                    std::cout << m_warnColor << "[WARN]: " << message
-                              << date_time << m_defaultColor << '\n';
-                    break;
-            }
-
-            std::cout.flush();
-        }
-    }
-    // ---------------------------------------------------------------------
-    void info(const std::string& message) override
-    {
-        if (getLogLevel() >= LogLevel::INFO)
-        {
-            std::string date_time = getDateTimeString();
-
-            switch (m_colorizeStyle)
-            {
-                case ColorizeConsoleOutput::NO_COLOR:
-                    std::cout << m_defaultColor << "[INFO]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::LEVEL_ONLY:
-                    std::cout << m_infoColor << "[INFO]: "
-                              << m_defaultColor << message << date_time << '\n';
-                    break;
-                case ColorizeConsoleOutput::ALL:
-                    std::cout << m_infoColor << "[INFO]: " << message
-                              << date_time << m_defaultColor << '\n';
-                    break;
-            }
-
-            std::cout.flush();
-        }
+        m_sink->setColorizeStyle(style);
     }
 };
 
-    class FileLogger final : public Logger {
+    class FileLogger final : public SinkLogger {
     public:
+        using FlushPolicy = FileSink::FlushPolicy;
+
+        static constexpr std::size_t DefaultBufferSize = FileSink::DefaultBufferSize;
+
         FileLogger() = delete;
 
         [[maybe_unused]] FileLogger(LogLevel logLevel, std::string filename)
-                : Logger(logLevel), m_filename(std::move(filename)) {}
-
-    private:
-        std::string m_filename;
-        std::ofstream m_file;
-    public:
-        void trace(const std::string &message) override {
-            std::cout << "[TRACE]: " << message << '\n';
+                : FileLogger(logLevel, std::move(filename),
+                             DefaultBufferSize, FlushPolicy{}) {}
+
+        // Throws std::system_error if the file can't be opened, see FileSink.
+        [[maybe_unused]] FileLogger(
+                LogLevel logLevel,
+                std::string filename,
+                std::size_t bufferSize,
+                FlushPolicy flushPolicy)
+                : SinkLogger(logLevel),
+                  m_sink(std::make_shared<FileSink>(
+                          std::move(filename), bufferSize, flushPolicy))
+        {
+            addSink(m_sink);
         }
 
-        // -------------------------------------------------------------------------
-        void debug(const std::string &message) override {
-            std::cout << "[DEBUG]: " << message << '\n';
-        }
+        FileLogger(const FileLogger &) = delete;            // non construction-copyable
+        FileLogger(FileLogger &&) = delete;                 // non movable
+        FileLogger &operator=(const FileLogger &) = delete; // non copyable
+        FileLogger &operator=(FileLogger &&) = delete;      // move assignment
 
-        // -------------------------------------------------------------------------
-        void error(const std::string &message) override {
-            std::cout << "[ERROR]: " << message << '\n';
-        }
+    private:
+        std::shared_ptr<FileSink> m_sink;
 
-        // -------------------------------------------------------------------------
-        void warn(const std::string &message) override {
-            std::cout << "[WARN]: " << message << '\n';
-        }
+    public:
+        // Getters -------------------------------------------------------------
+        [[nodiscard]] const std::string &getFilename() const { return m_sink->getFilename(); }
 
-        // -------------------------------------------------------------------------
-        void info(const std::string &message) override {
-            std::cout << "[INFO]: " << message << '\n';
-        }
+        [[nodiscard]] const FlushPolicy &getFlushPolicy() const { return m_sink->getFlushPolicy(); }
     };
 
+
 }//namespace gc
 
+// Logging macros --------------------------------------------------------------
+//
+// GCLOG_INFO(log, "took " + std::to_string(ms) + " ms") only evaluates its
+// message once log.isEnabled(INFO) has returned true, so a disabled call
+// costs one predictable branch, and no code at all for levels stripped by
+// GCLOG_MIN_LEVEL. The logger expression is evaluated once.
+#define GCLOG_LOG_AT_(logger, level, method, ...)                               \
+    do {                                                                       \
+        if constexpr (::gc::Logger::isCompiledIn(level)) {                     \
+            auto &gclogLogger_ = (logger);                                     \
+            if (gclogLogger_.isEnabled(level)) {                               \
+                gclogLogger_.method(__VA_ARGS__);                              \
+            }                                                                  \
+        }                                                                      \
+    } while (false)
+
+#define GCLOG_TRACE(logger, ...) \
+    GCLOG_LOG_AT_(logger, ::gc::Logger::LogLevel::TRACE, trace, __VA_ARGS__)
+#define GCLOG_DEBUG(logger, ...) \
+    GCLOG_LOG_AT_(logger, ::gc::Logger::LogLevel::DEBUG, debug, __VA_ARGS__)
+#define GCLOG_INFO(logger, ...) \
+    GCLOG_LOG_AT_(logger, ::gc::Logger::LogLevel::INFO, info, __VA_ARGS__)
+#define GCLOG_WARN(logger, ...) \
+    GCLOG_LOG_AT_(logger, ::gc::Logger::LogLevel::WARN, warn, __VA_ARGS__)
+#define GCLOG_ERROR(logger, ...) \
+    GCLOG_LOG_AT_(logger, ::gc::Logger::LogLevel::ERROR, error, __VA_ARGS__)
+
+// Rate limited logging macros -------------------------------------------------
+//
+// GCLOG_ERROR_LIMITED(log, 10, "db down: {}", reason) writes at most 10
+// records a second from this call site (bursts of up to 10), each call
+// site keeping its own RateLimiter. The first record let through after
+// some were refused is preceded by a line saying how many.
+#define GCLOG_LOG_LIMITED_AT_(logger, level, method, perSecond, ...)           \
+    do {                                                                       \
+        if constexpr (::gc::Logger::isCompiledIn(level)) {                     \
+            auto &gclogLogger_ = (logger);                                     \
+            if (gclogLogger_.isEnabled(level)) {                               \
+                static ::gc::RateLimiter gclogLimiter_(perSecond);             \
+                if (const auto gclogRefused_ = gclogLimiter_.tryAcquire()) {   \
+                    if (*gclogRefused_ != 0) {                                 \
+                        gclogLogger_.countSuppressed(*gclogRefused_);          \
+                        gclogLogger_.method(                                   \
+                                "{} messages suppressed by the rate limit",    \
+                                *gclogRefused_);                               \
+                    }                                                          \
+                    gclogLogger_.method(__VA_ARGS__);                          \
+                }                                                              \
+            }                                                                  \
+        }                                                                      \
+    } while (false)
+
+#define GCLOG_TRACE_LIMITED(logger, perSecond, ...) \
+    GCLOG_LOG_LIMITED_AT_(logger, ::gc::Logger::LogLevel::TRACE, trace, perSecond, __VA_ARGS__)
+#define GCLOG_DEBUG_LIMITED(logger, perSecond, ...) \
+    GCLOG_LOG_LIMITED_AT_(logger, ::gc::Logger::LogLevel::DEBUG, debug, perSecond, __VA_ARGS__)
+#define GCLOG_INFO_LIMITED(logger, perSecond, ...) \
+    GCLOG_LOG_LIMITED_AT_(logger, ::gc::Logger::LogLevel::INFO, info, perSecond, __VA_ARGS__)
+#define GCLOG_WARN_LIMITED(logger, perSecond, ...) \
+    GCLOG_LOG_LIMITED_AT_(logger, ::gc::Logger::LogLevel::WARN, warn, perSecond, __VA_ARGS__)
+#define GCLOG_ERROR_LIMITED(logger, perSecond, ...) \
+    GCLOG_LOG_LIMITED_AT_(logger, ::gc::Logger::LogLevel::ERROR, error, perSecond, __VA_ARGS__)
+
 
 
 #endif //GCLOG_LOGGER_HPP
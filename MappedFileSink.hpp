@@ -0,0 +1,463 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: MappedFileSink.hpp                                          //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_MAPPEDFILESINK_HPP
+#define GCLOG_MAPPEDFILESINK_HPP
+
+#include "Logger.hpp"
+
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace gc {
+
+// -----------------------------------------------------------------------------
+// Writes lines straight into a shared mapping of the file, no syscall and
+// no lock per line. A writer reserves its bytes with one fetch_add on the
+// file offset and copies the line in, a line crossing a chunk boundary is
+// copied in two parts.
+//
+// The file grows in chunks, a worker thread allocates and maps them ahead
+// of the offset and unmaps a chunk once every byte of it has been copied,
+// which each chunk counts. On destruction the file is cut back to what
+// was written.
+//
+// Offsets are handed out in one running sequence across rotations, each
+// file starting on a chunk boundary of it, so a writer never needs to
+// know which file its line lands in.
+class MappedFileSink final : public Sink
+{
+public:
+    struct MappingPolicy {
+        std::size_t chunkSize{16 * 1024 * 1024};     // rounded up to pages
+        std::size_t chunksAhead{2};                  // mapped past the current one
+        std::chrono::milliseconds syncInterval{1000};  // msync cadence, 0 = off
+    };
+
+    MappedFileSink() = delete;
+
+    [[maybe_unused]] explicit MappedFileSink(std::string filename)
+            : MappedFileSink(std::move(filename), MappingPolicy{}) {}
+
+    /**************************************************************
+     * @brief Appends to filename, mapping the chunks from the end
+     * of what is there before returning.
+     *
+     * @Note: throws std::system_error if the file can't be opened.
+     * Writers wait for the worker if they get more than chunksAhead
+     * chunks ahead of it, and lines in a chunk that could not be
+     * allocated or mapped are dropped and counted. Their bytes are
+     * blanked to spaces ending in a newline, as far as the disk
+     * takes them.
+     *************************************************************/
+    [[maybe_unused]] MappedFileSink(std::string filename, MappingPolicy mappingPolicy)
+            : m_filename(std::move(filename)),
+              m_mappingPolicy(mappingPolicy)
+    {
+        const auto pageSize = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        m_chunkSize = std::max<std::size_t>(
+                (m_mappingPolicy.chunkSize + pageSize - 1) / pageSize * pageSize, pageSize);
+        m_mappingPolicy.chunkSize = m_chunkSize;
+
+        // Chunks behind the current one stay mapped until their last
+        // writers are done, two slots of slack cover that.
+        m_slotCount = m_mappingPolicy.chunksAhead + 2;
+        m_slots = std::make_unique<Slot[]>(m_slotCount);
+
+        const int fd = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        struct stat status{};
+        if (fd < 0 || ::fstat(fd, &status) != 0) {
+            const int error = errno;
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            throw std::system_error(error, std::generic_category(),
+                                    "gclog: can't open " + m_filename);
+        }
+        m_startOffset = static_cast<std::uint64_t>(status.st_size);
+        m_offset.store(m_startOffset, std::memory_order_relaxed);
+        m_fd.store(fd, std::memory_order_relaxed);
+        m_nextChunk = m_startOffset / m_chunkSize;
+
+        mapAhead();
+        m_worker = std::thread([this] { runWorker(); });
+    }
+
+    ~MappedFileSink() override
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+            m_stopWorker = true;
+        }
+        m_wakeup.wake();
+        m_worker.join();
+
+        const std::uint64_t end = m_offset.load() - m_base.load(std::memory_order_relaxed);
+        for (std::size_t slot = 0; slot < m_slotCount; ++slot) {
+            releaseSlot(m_slots[slot], end);
+        }
+        // On failure the file keeps a zero filled tail, there is nowhere
+        // to report it.
+        const int fd = m_fd.load(std::memory_order_relaxed);
+        [[maybe_unused]] const int truncated = ::ftruncate(fd, static_cast<off_t>(end));
+        ::close(fd);
+    }
+
+    MappedFileSink(const MappedFileSink &) = delete;            // non construction-copyable
+    MappedFileSink(MappedFileSink &&) = delete;                 // non movable
+    MappedFileSink &operator=(const MappedFileSink &) = delete; // non copyable
+    MappedFileSink &operator=(MappedFileSink &&) = delete;      // move assignment
+
+private:
+    static constexpr std::uint64_t NoChunk = ~std::uint64_t{0};
+
+    // Where one chunk of the file is mapped. data is only read once
+    // chunk says the slot holds the chunk the reader wants, data is
+    // nullptr if the chunk couldn't be mapped.
+    struct Slot {
+        std::atomic<std::uint64_t> chunk{NoChunk};
+        std::atomic<char *> data{nullptr};
+        std::atomic<std::size_t> copied{0};
+
+        // The worker's, which file the chunk is of and where.
+        int fd{-1};
+        std::uint64_t position{0};
+        std::size_t existing{0};  // bytes the file held before we opened it
+    };
+
+    std::string m_filename;
+    MappingPolicy m_mappingPolicy;
+    std::size_t m_chunkSize{0};
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::size_t m_slotCount{0};
+    std::uint64_t m_startOffset{0};  // of the current file
+    std::uint64_t m_nextChunk{0};    // the worker's, the next chunk to map
+    alignas(64) std::atomic<std::uint64_t> m_offset{0};
+
+    // The current file and the offset it starts at, atomic for
+    // flushFromSignal(), which leaves the file alone mid rotation.
+    std::atomic<int> m_fd{-1};
+    std::atomic<std::uint64_t> m_base{0};
+    std::atomic<bool> m_rotating{false};
+
+    std::thread m_worker;
+    detail::Wakeup m_wakeup;
+    bool m_stopWorker{false};
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] const std::string &getFilename() const { return m_filename; }
+
+    [[nodiscard]] const MappingPolicy &getMappingPolicy() const { return m_mappingPolicy; }
+
+    [[nodiscard]] std::size_t getDroppedCount() const { return getMetrics().dropped; }
+
+    // -------------------------------------------------------------------------
+    // Writes back what has been copied into the mapped chunks so far.
+    void flush() override {
+        std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+        syncMapped(MS_SYNC);
+    }
+
+    // -------------------------------------------------------------------------
+    // The mapping outlives the process, only the allocated tail past
+    // what was written needs cutting off.
+    void flushFromSignal() override {
+        if (m_rotating.load(std::memory_order_relaxed)) {
+            return;
+        }
+        const std::uint64_t end = m_offset.load(std::memory_order_relaxed)
+                                  - m_base.load(std::memory_order_relaxed);
+        [[maybe_unused]] const int truncated =
+                ::ftruncate(m_fd.load(std::memory_order_relaxed), static_cast<off_t>(end));
+    }
+
+    // -------------------------------------------------------------------------
+    // A line is copied whole or, if any part of it falls in a chunk that
+    // couldn't be mapped, blanked wherever it could have gone. Only a line
+    // longer than the mapped window can be copied in part, its chunks
+    // can't all be mapped before the first is copied.
+    void write(const LogLine &line) override {
+        const std::size_t size = line.text.size();
+        const std::uint64_t start = m_offset.fetch_add(size, std::memory_order_seq_cst);
+        const std::uint64_t window = start / m_chunkSize + m_slotCount - 2;
+
+        // Moving into a new chunk gives the worker one more to map ahead.
+        bool wake = start / m_chunkSize != (start + size) / m_chunkSize;
+        bool dropped = false;
+        for (std::uint64_t chunk = start / m_chunkSize;
+             chunk * m_chunkSize < start + size && chunk <= window; ++chunk) {
+            dropped |= waitForChunk(chunk).data.load(std::memory_order_relaxed) == nullptr;
+        }
+
+        const char *text = line.text.data();
+        for (std::uint64_t position = start; position < start + size;) {
+            const std::size_t within = position % m_chunkSize;
+            const std::size_t part = std::min<std::uint64_t>(start + size - position, m_chunkSize - within);
+
+            Slot &slot = waitForChunk(position / m_chunkSize);
+            char *data = slot.data.load(std::memory_order_relaxed);
+            dropped |= data == nullptr;
+            if (data != nullptr) {
+                if (!dropped) {
+                    std::memcpy(data + within, text, part);
+                } else {
+                    std::memset(data + within, ' ', part);
+                    if (position + part == start + size) {
+                        data[within + part - 1] = '\n';
+                    }
+                }
+            }
+            // Completing a chunk frees its slot for the worker.
+            wake |= slot.copied.fetch_add(part, std::memory_order_seq_cst) + part == m_chunkSize;
+
+            text += part;
+            position += part;
+        }
+
+        if (wake) {
+            m_wakeup.notify();
+        }
+        if (dropped) {
+            m_metrics.countDropped();
+        } else {
+            m_metrics.countBytes(size);
+        }
+    }
+
+    /**************************************************************
+     * @brief Moves the file to rotatedName once every line handed an
+     * offset in it has been copied, and carries on in a new file
+     * under the original name.
+     *
+     * @Note: the moved file is cut back to what was written. Returns
+     * false, logging on into the same file, if the rename or the new
+     * file fails. Writers only wait if they outrun the new mapping.
+     *************************************************************/
+    bool rotate(const std::string &rotatedName) {
+        std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+
+        if (std::rename(m_filename.c_str(), rotatedName.c_str()) != 0) {
+            return false;
+        }
+        const int fd = ::open(m_filename.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::rename(rotatedName.c_str(), m_filename.c_str());
+            return false;
+        }
+        m_rotating.store(true, std::memory_order_relaxed);
+
+        // Later lines go to the new file, starting at a chunk past any
+        // the old one has had mapped.
+        std::uint64_t end = m_offset.load(std::memory_order_relaxed);
+        std::uint64_t newChunk = 0;
+        do {
+            newChunk = std::max(m_nextChunk, (end + m_chunkSize - 1) / m_chunkSize);
+        } while (!m_offset.compare_exchange_weak(end, newChunk * m_chunkSize, std::memory_order_relaxed));
+
+        // Lines in chunks not mapped yet are still the old file's.
+        const std::uint64_t endChunk = (end + m_chunkSize - 1) / m_chunkSize;
+        while (m_nextChunk < endChunk) {
+            mapAhead(endChunk - 1);
+            std::this_thread::yield();
+        }
+
+        // What was never handed out counts as copied, the end of the
+        // last chunk and any mapped ahead.
+        for (std::uint64_t chunk = end / m_chunkSize; chunk < m_nextChunk; ++chunk) {
+            const std::uint64_t chunkStart = chunk * m_chunkSize;
+            m_slots[chunk % m_slotCount].copied.fetch_add(
+                    m_chunkSize - (std::max(end, chunkStart) - chunkStart), std::memory_order_release);
+        }
+
+        const int oldFd = m_fd.load(std::memory_order_relaxed);
+        const std::uint64_t oldEnd = end - m_base.load(std::memory_order_relaxed);
+        m_fd.store(fd, std::memory_order_relaxed);
+        m_base.store(newChunk * m_chunkSize, std::memory_order_relaxed);
+        m_startOffset = 0;
+
+        // Maps for the new file while the old one drains.
+        for (;;) {
+            mapAhead();
+            bool drained = true;
+            for (std::size_t slot = 0; slot < m_slotCount; ++slot) {
+                const std::uint64_t chunk = m_slots[slot].chunk.load(std::memory_order_relaxed);
+                drained &= chunk == NoChunk || chunk >= newChunk
+                           || m_slots[slot].copied.load(std::memory_order_acquire) == m_chunkSize;
+            }
+            if (drained) {
+                break;
+            }
+            std::this_thread::yield();
+        }
+
+        for (std::size_t slot = 0; slot < m_slotCount; ++slot) {
+            Slot &old = m_slots[slot];
+            const std::uint64_t chunk = old.chunk.load(std::memory_order_relaxed);
+            if (chunk != NoChunk && chunk < newChunk) {
+                releaseSlot(old, oldEnd);
+                old.chunk.store(NoChunk, std::memory_order_relaxed);
+            }
+        }
+        [[maybe_unused]] const int truncated = ::ftruncate(oldFd, static_cast<off_t>(oldEnd));
+        ::close(oldFd);
+
+        m_rotating.store(false, std::memory_order_relaxed);
+        mapAhead();
+        return true;
+    }
+
+private:
+    // -------------------------------------------------------------------------
+    Slot &waitForChunk(std::uint64_t chunk) {
+        Slot &slot = m_slots[chunk % m_slotCount];
+        if (slot.chunk.load(std::memory_order_acquire) != chunk) {
+            m_wakeup.notify();
+            while (slot.chunk.load(std::memory_order_acquire) != chunk) {
+                std::this_thread::yield();
+            }
+        }
+        return slot;
+    }
+
+    // -------------------------------------------------------------------------
+    // Maps chunks in order up to chunksAhead past the current one, or up
+    // to last, each into the slot of the chunk slotCount before it once
+    // every byte of that has been copied.
+    void mapAhead(std::uint64_t last = NoChunk) {
+        if (last == NoChunk) {
+            last = m_offset.load(std::memory_order_relaxed) / m_chunkSize + m_mappingPolicy.chunksAhead;
+        }
+
+        for (; m_nextChunk <= last; ++m_nextChunk) {
+            Slot &slot = m_slots[m_nextChunk % m_slotCount];
+            if (slot.chunk.load(std::memory_order_relaxed) != NoChunk
+                && slot.copied.load(std::memory_order_acquire) != m_chunkSize) {
+                break;  // still being written, try again next round
+            }
+            releaseSlot(slot, NoChunk);
+
+            // Whatever the file held before we opened it counts as copied.
+            slot.fd = m_fd.load(std::memory_order_relaxed);
+            slot.position = m_nextChunk * m_chunkSize - m_base.load(std::memory_order_relaxed);
+            slot.existing = m_startOffset > slot.position
+                    ? std::min<std::size_t>(m_startOffset - slot.position, m_chunkSize) : 0;
+
+            slot.data.store(mapChunk(slot.fd, slot.position), std::memory_order_relaxed);
+            slot.copied.store(slot.existing, std::memory_order_relaxed);
+            slot.chunk.store(m_nextChunk, std::memory_order_release);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] char *mapChunk(int fd, std::uint64_t position) const {
+        const auto offset = static_cast<off_t>(position);
+        const auto length = static_cast<off_t>(m_chunkSize);
+        if (::posix_fallocate(fd, offset, length) != 0) {
+            return nullptr;
+        }
+
+        void *data = ::mmap(nullptr, m_chunkSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+        return data == MAP_FAILED ? nullptr : static_cast<char *>(data);
+    }
+
+    // -------------------------------------------------------------------------
+    // Unmaps a chunk every writer is done with. One that couldn't be
+    // mapped is blanked up to end, a position in its file, on disk
+    // instead, so the file has no NULs where lines were dropped.
+    void releaseSlot(Slot &slot, std::uint64_t end) {
+        if (char *data = slot.data.load(std::memory_order_relaxed)) {
+            ::munmap(data, m_chunkSize);
+            slot.data.store(nullptr, std::memory_order_relaxed);
+            return;
+        }
+        if (slot.chunk.load(std::memory_order_relaxed) == NoChunk) {
+            return;
+        }
+
+        const std::uint64_t from = slot.position + slot.existing;
+        const std::uint64_t to = std::min(slot.position + m_chunkSize, end);
+        std::array<char, 4096> blank{};
+        blank.fill(' ');
+        for (std::uint64_t position = from; position < to;) {
+            const std::size_t part = std::min<std::uint64_t>(to - position, blank.size());
+            if (position + part == to) {
+                blank[part - 1] = '\n';
+            }
+            const ssize_t written = ::pwrite(slot.fd, blank.data(), part, static_cast<off_t>(position));
+            if (written <= 0) {
+                break;  // the disk is still full, the hole stays
+            }
+            position += static_cast<std::uint64_t>(written);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void syncMapped(int flags) {
+        const auto start = std::chrono::steady_clock::now();
+        for (std::size_t slot = 0; slot < m_slotCount; ++slot) {
+            if (char *data = m_slots[slot].data.load(std::memory_order_relaxed)) {
+                ::msync(data, m_chunkSize, flags);
+            }
+        }
+        m_metrics.countFlush(std::chrono::steady_clock::now() - start);
+    }
+
+    // -------------------------------------------------------------------------
+    // Whether mapAhead() would map another chunk.
+    [[nodiscard]] bool canMapAhead() const {
+        const std::uint64_t current = m_offset.load(std::memory_order_seq_cst) / m_chunkSize;
+        const Slot &slot = m_slots[m_nextChunk % m_slotCount];
+        return m_nextChunk <= current + m_mappingPolicy.chunksAhead
+               && (slot.chunk.load(std::memory_order_relaxed) == NoChunk
+                   || slot.copied.load(std::memory_order_seq_cst) == m_chunkSize);
+    }
+
+    // -------------------------------------------------------------------------
+    // Sleeps until writers move into a new chunk or finish one, or a
+    // writer finds its chunk missing, and writes back on the configured
+    // cadence.
+    void runWorker() {
+        using Clock = detail::Wakeup::Clock;
+        const bool syncing = m_mappingPolicy.syncInterval.count() > 0;
+        auto nextSync = Clock::now() + m_mappingPolicy.syncInterval;
+
+        std::unique_lock<std::mutex> guard(m_wakeup.getMutex());
+        while (!m_stopWorker) {
+            mapAhead();
+
+            if (syncing && Clock::now() >= nextSync) {
+                syncMapped(MS_ASYNC);
+                nextSync = Clock::now() + m_mappingPolicy.syncInterval;
+            }
+
+            m_wakeup.sleepUntil(guard, syncing ? std::optional(nextSync) : std::nullopt,
+                                [this] { return m_stopWorker || canMapAhead(); });
+        }
+    }
+};
+
+}//namespace gc
+
+#endif //GCLOG_MAPPEDFILESINK_HPP
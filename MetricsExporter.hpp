@@ -0,0 +1,303 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: MetricsExporter.hpp                                         //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_METRICSEXPORTER_HPP
+#define GCLOG_METRICSEXPORTER_HPP
+
+#include "Logger.hpp"
+#include "Formatters.hpp"
+
+#include <cstdio>
+#include <string>
+
+namespace gc {
+
+namespace detail {
+    // -------------------------------------------------------------------------
+    // A label value as the Prometheus text format quotes it.
+    inline void appendLabelValue(fmt::memory_buffer &out, std::string_view value) {
+        out.push_back('"');
+        for (const char c : value) {
+            switch (c) {
+                case '\\':
+                    out.append(std::string_view("\\\\"));
+                    break;
+                case '"':
+                    out.append(std::string_view("\\\""));
+                    break;
+                case '\n':
+                    out.append(std::string_view("\\n"));
+                    break;
+                default:
+                    out.push_back(c);
+            }
+        }
+        out.push_back('"');
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Writes the metrics of the loggers and sinks it is given in the Prometheus
+// text format, into a buffer on request or to a file every interval, e.g.
+// for node_exporter's textfile collector:
+//
+//   gclog_records_total{logger="app",level="info"} 1042
+//   gclog_sink_flush_seconds_bucket{sink="file",le="1e-06"} 3
+//
+// Loggers are labelled logger=, sinks sink=, with the names they were
+// added under. Reading takes each one's metrics lock, long enough to list
+// one cell per thread logging at the time. Of the logging threads only a
+// thread's first record through a logger or sink takes that lock.
+class MetricsExporter
+{
+public:
+    MetricsExporter() = delete;
+
+    /**************************************************************
+     * @brief Dumps to filename every interval from a thread of
+     * its own, once more on destruction, or only when dump() is
+     * called if interval is 0.
+     *
+     * @Note: the dump goes to filename.tmp first and is renamed
+     * over filename, readers never see half of one.
+     *************************************************************/
+    [[maybe_unused]] explicit MetricsExporter(
+            std::string filename,
+            std::chrono::milliseconds interval = std::chrono::seconds(15))
+            : m_filename(std::move(filename)), m_interval(interval)
+    {
+        if (m_interval.count() > 0) {
+            m_dumper = std::thread([this] { runDumper(); });
+        }
+    }
+
+    ~MetricsExporter()
+    {
+        if (m_dumper.joinable()) {
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                m_stopDumper = true;
+            }
+            m_dumperWakeup.notify_one();
+            m_dumper.join();
+            dump();
+        }
+    }
+
+    MetricsExporter(const MetricsExporter &) = delete;            // non construction-copyable
+    MetricsExporter(MetricsExporter &&) = delete;                 // non movable
+    MetricsExporter &operator=(const MetricsExporter &) = delete; // non copyable
+    MetricsExporter &operator=(MetricsExporter &&) = delete;      // move assignment
+
+private:
+    struct Source {
+        std::string name;
+        const Logger *logger;
+        const Sink *sink;
+    };
+
+    std::string m_filename;
+    std::chrono::milliseconds m_interval;
+
+    mutable std::mutex m_mutex;
+    std::vector<Source> m_sources;
+
+    std::thread m_dumper;
+    std::condition_variable m_dumperWakeup;
+    bool m_stopDumper{false};
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] const std::string &getFilename() const { return m_filename; }
+
+    [[nodiscard]] std::chrono::milliseconds getInterval() const { return m_interval; }
+
+    // Setters -----------------------------------------------------------------
+    //
+    // Either must outlive the exporter. Can be called while it dumps.
+    void add(std::string name, const Logger &logger) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_sources.push_back({std::move(name), &logger, nullptr});
+    }
+
+    void add(std::string name, const Sink &sink) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_sources.push_back({std::move(name), nullptr, &sink});
+    }
+
+    // -------------------------------------------------------------------------
+    // Every metric of every source, each family once with its HELP and
+    // TYPE lines.
+    void appendTo(fmt::memory_buffer &out) const {
+        std::vector<std::pair<std::string, MetricsSnapshot>> loggers;
+        std::vector<std::pair<std::string, MetricsSnapshot>> sinks;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            for (const Source &source : m_sources) {
+                if (source.logger != nullptr) {
+                    loggers.emplace_back(source.name, source.logger->getMetrics());
+                } else {
+                    sinks.emplace_back(source.name, source.sink->getMetrics());
+                }
+            }
+        }
+
+        auto family = [&out](std::string_view name, std::string_view type, std::string_view help) {
+            fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+        };
+        auto sample = [&out](std::string_view name, std::string_view key, std::string_view value,
+                             const auto &number) {
+            out.append(name);
+            out.push_back('{');
+            out.append(key);
+            out.push_back('=');
+            detail::appendLabelValue(out, value);
+            fmt::format_to(std::back_inserter(out), "}} {}\n", number);
+        };
+
+        if (!loggers.empty()) {
+            family("gclog_records_total", "counter", "Records written, by level.");
+            for (const auto &[name, metrics] : loggers) {
+                for (std::size_t level = 0; level < metrics.records.size(); ++level) {
+                    out.append(std::string_view("gclog_records_total{logger="));
+                    detail::appendLabelValue(out, name);
+                    out.append(std::string_view(",level=\""));
+                    out.append(detail::getLevelName(static_cast<Logger::LogLevel>(level)));
+                    fmt::format_to(std::back_inserter(out), "\"}} {}\n", metrics.records[level]);
+                }
+            }
+
+            family("gclog_dropped_total", "counter", "Records lost to a full queue or buffer.");
+            for (const auto &[name, metrics] : loggers) {
+                sample("gclog_dropped_total", "logger", name, metrics.dropped);
+            }
+
+            family("gclog_suppressed_total", "counter", "Records deduplicated or rate limited.");
+            for (const auto &[name, metrics] : loggers) {
+                sample("gclog_suppressed_total", "logger", name, metrics.suppressed);
+            }
+
+            family("gclog_blocked_seconds_total", "counter", "Time producers waited for room in a queue.");
+            for (const auto &[name, metrics] : loggers) {
+                sample("gclog_blocked_seconds_total", "logger", name,
+                       toSeconds(metrics.blockedNanoseconds));
+            }
+
+            family("gclog_queue_high_water", "gauge", "Most records found waiting in the queue.");
+            for (const auto &[name, metrics] : loggers) {
+                sample("gclog_queue_high_water", "logger", name, metrics.queueHighWater);
+            }
+        }
+
+        if (!sinks.empty()) {
+            family("gclog_sink_bytes_total", "counter", "Bytes written.");
+            for (const auto &[name, metrics] : sinks) {
+                sample("gclog_sink_bytes_total", "sink", name, metrics.bytes);
+            }
+
+            family("gclog_sink_dropped_total", "counter", "Lines the destination had no room for.");
+            for (const auto &[name, metrics] : sinks) {
+                sample("gclog_sink_dropped_total", "sink", name, metrics.dropped);
+            }
+
+            family("gclog_sink_flush_seconds", "histogram", "Time taken handing buffered lines over.");
+            for (const auto &[name, metrics] : sinks) {
+                appendHistogram(out, name, metrics);
+            }
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] std::string toText() const {
+        fmt::memory_buffer out;
+        appendTo(out);
+        return {out.data(), out.size()};
+    }
+
+    // -------------------------------------------------------------------------
+    // Writes the metrics to the file now, false if it couldn't be.
+    bool dump() const {
+        fmt::memory_buffer out;
+        appendTo(out);
+
+        const std::string temporary = m_filename + ".tmp";
+        const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        iovec part{out.data(), out.size()};
+        detail::writeAll(fd, &part, 1);
+        if (::close(fd) != 0 || std::rename(temporary.c_str(), m_filename.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // -------------------------------------------------------------------------
+    static double toSeconds(std::uint64_t nanoseconds) {
+        return static_cast<double>(nanoseconds) / 1e9;
+    }
+
+    // -------------------------------------------------------------------------
+    // Prometheus buckets are cumulative, each counts every flush up to
+    // its bound.
+    static void appendHistogram(fmt::memory_buffer &out, std::string_view name,
+                                const MetricsSnapshot &metrics) {
+        std::uint64_t cumulative = 0;
+        for (std::size_t bucket = 0; bucket < metrics.flushLatency.size(); ++bucket) {
+            cumulative += metrics.flushLatency[bucket];
+            out.append(std::string_view("gclog_sink_flush_seconds_bucket{sink="));
+            detail::appendLabelValue(out, name);
+            if (bucket < MetricsSnapshot::LatencyBounds.size()) {
+                fmt::format_to(std::back_inserter(out), ",le=\"{}\"}} {}\n",
+                               toSeconds(MetricsSnapshot::LatencyBounds[bucket]), cumulative);
+            } else {
+                fmt::format_to(std::back_inserter(out), ",le=\"+Inf\"}} {}\n", cumulative);
+            }
+        }
+
+        out.append(std::string_view("gclog_sink_flush_seconds_sum{sink="));
+        detail::appendLabelValue(out, name);
+        fmt::format_to(std::back_inserter(out), "}} {}\n", toSeconds(metrics.flushNanoseconds));
+        out.append(std::string_view("gclog_sink_flush_seconds_count{sink="));
+        detail::appendLabelValue(out, name);
+        fmt::format_to(std::back_inserter(out), "}} {}\n", metrics.flushes);
+    }
+
+    // -------------------------------------------------------------------------
+    void runDumper() {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        while (!m_stopDumper) {
+            if (m_dumperWakeup.wait_for(guard, m_interval, [this] { return m_stopDumper; })) {
+                break;
+            }
+            guard.unlock();
+            dump();
+            guard.lock();
+        }
+    }
+};
+
+}//namespace gc
+
+#endif //GCLOG_METRICSEXPORTER_HPP
@@ -0,0 +1,394 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: Registry.hpp                                                //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_REGISTRY_HPP
+#define GCLOG_REGISTRY_HPP
+
+#include "Logger.hpp"
+
+#include <map>
+#include <string>
+
+namespace gc {
+
+class LoggerRegistry;
+
+// -----------------------------------------------------------------------------
+// A logger owned by a LoggerRegistry, named with dots ("net.http") and
+// inheriting its level, sinks and formatter from its parent ("net", then
+// the root "") unless they were set on it. Under a registry made over a
+// backend Logger, records a logger lets through go to the backend's
+// vlog()/vlogFields() unless the logger was given sinks of its own.
+//
+// Logging takes no registry lock: the level is the atomic every Logger has
+// and the sinks and formatter are read from an immutable snapshot the
+// registry swaps in with one atomic store. A record holds a reference to
+// the snapshot it started with, the last one out frees a replaced one.
+// setLevel() goes through the registry, the same as
+// LoggerRegistry::setLevel(name, level).
+class NamedLogger final : public Logger
+{
+public:
+    NamedLogger() = delete;
+
+    ~NamedLogger() override = default;
+
+    NamedLogger(const NamedLogger &) = delete;            // non construction-copyable
+    NamedLogger(NamedLogger &&) = delete;                 // non movable
+    NamedLogger &operator=(const NamedLogger &) = delete; // non copyable
+    NamedLogger &operator=(NamedLogger &&) = delete;      // move assignment
+
+private:
+    friend class LoggerRegistry;
+
+    // What a record is written with, never changed once published.
+    struct Output
+    {
+        std::vector<std::shared_ptr<Sink>> sinks;
+        std::shared_ptr<const Formatter> formatter;
+        Logger *backend{nullptr};  // instead of the sinks if set
+    };
+
+    NamedLogger(LoggerRegistry &registry, std::string name, NamedLogger *parent)
+            : Logger(LogLevel::INFO), m_registry(registry), m_name(std::move(name)), m_parent(parent) {}
+
+    LoggerRegistry &m_registry;
+    const std::string m_name;
+    NamedLogger *const m_parent;
+    std::atomic<std::shared_ptr<const Output>> m_output;
+    // The same snapshot for flushFromSignal(), which mustn't take the
+    // lock loading m_output takes. One replaced at that moment may
+    // already be gone.
+    std::atomic<const Output *> m_signalOutput{nullptr};
+
+    // What was set on this logger itself, guarded by the registry's lock.
+    std::optional<LogLevel> m_ownLevel;
+    std::optional<std::vector<std::shared_ptr<Sink>>> m_ownSinks;
+    std::shared_ptr<const Formatter> m_ownFormatter;
+    Logger *m_ownBackend{nullptr};  // the root's, if the registry has one
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] const std::string &getName() const { return m_name; }
+
+    // nullptr for the root.
+    [[nodiscard]] NamedLogger *getParent() const { return m_parent; }
+
+    // -------------------------------------------------------------------------
+    // Sets this logger's own level, for it and every descendant not
+    // setting one themselves.
+    void setLevel(LogLevel level) override;
+
+    // -------------------------------------------------------------------------
+    // The sinks in effect, inherited or not, none when writing through
+    // a backend.
+    [[nodiscard]] std::vector<std::shared_ptr<Sink>> getSinks() const {
+        return m_output.load(std::memory_order_acquire)->sinks;
+    }
+
+    // -------------------------------------------------------------------------
+    void log(LogLevel level, const std::string &message) override { write(level, message); }
+
+    // -------------------------------------------------------------------------
+    void flush() override {
+        const auto output = m_output.load(std::memory_order_acquire);
+        if (output->backend != nullptr) {
+            output->backend->flush();
+        }
+        for (const auto &sink : output->sinks) {
+            sink->flush();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void flushFromSignal(int fd) override {
+        const Output *output = m_signalOutput.load(std::memory_order_acquire);
+        if (output->backend != nullptr) {
+            output->backend->flushFromSignal(fd);
+        }
+        for (const auto &sink : output->sinks) {
+            sink->flushFromSignal();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void vlog(LogLevel level, fmt::string_view format, fmt::format_args args) override {
+        const auto output = m_output.load(std::memory_order_acquire);
+        if (output->backend != nullptr) {
+            m_metrics.countRecord(static_cast<std::size_t>(level));
+            output->backend->vlog(level, format, args);
+            return;
+        }
+        auto &buffer = detail::lineBuffer();
+        buffer.clear();
+
+        const LogLine line = output->formatter->format(buffer, *this, level, format, args, {});
+        m_metrics.countRecord(static_cast<std::size_t>(level));
+        for (const auto &sink : output->sinks) {
+            sink->write(line);
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void vlogFields(LogLevel level, std::string_view message, std::span<const Field> fields) override {
+        const auto output = m_output.load(std::memory_order_acquire);
+        if (output->backend != nullptr) {
+            m_metrics.countRecord(static_cast<std::size_t>(level));
+            output->backend->vlogFields(level, message, fields);
+            return;
+        }
+        auto &buffer = detail::lineBuffer();
+        buffer.clear();
+
+        const LogLine line = output->formatter->format(
+                buffer, *this, level, "{}", fmt::make_format_args(message), fields);
+        m_metrics.countRecord(static_cast<std::size_t>(level));
+        for (const auto &sink : output->sinks) {
+            sink->write(line);
+        }
+    }
+
+private:
+    // -------------------------------------------------------------------------
+    void write(LogLevel level, const std::string &message) {
+        if (isEnabled(level)) {
+            vlog(level, "{}", fmt::make_format_args(message));
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Hands out NamedLoggers by dotted name, creating them and their parents
+// on first use. The references stay valid for the registry's lifetime.
+//
+// Changes recompute what every logger inherits and publish new snapshots
+// under the registry's lock, copy-on-write. A replaced snapshot is freed
+// once the records that were using it are done.
+class LoggerRegistry
+{
+public:
+    LoggerRegistry() = delete;
+
+    /**************************************************************
+     * @brief Makes a registry whose root logger, "", writes to
+     * rootSinks at rootLevel with the default Formatter.
+     *
+     * @Note: the process wide registry behind gc::get() starts
+     * with one ConsoleSink at INFO.
+     *************************************************************/
+    [[maybe_unused]] explicit LoggerRegistry(std::vector<std::shared_ptr<Sink>> rootSinks,
+                                             Logger::LogLevel rootLevel = Logger::LogLevel::INFO)
+    {
+        NamedLogger &root = create("", nullptr);
+        root.m_ownLevel = rootLevel;
+        root.m_ownSinks = std::move(rootSinks);
+        root.m_ownFormatter = std::make_shared<const Formatter>();
+        publish();
+    }
+
+    /**************************************************************
+     * @brief Makes a registry whose loggers filter on their own
+     * levels and hand what they let through to backend, e.g. named
+     * categories in front of one AsyncLogger.
+     *
+     * @Note: backend must outlive the registry. The backend's level
+     * isn't tested again. A logger given sinks writes to those
+     * instead, it and its descendants.
+     *************************************************************/
+    [[maybe_unused]] explicit LoggerRegistry(Logger &backend,
+                                             Logger::LogLevel rootLevel = Logger::LogLevel::INFO)
+    {
+        NamedLogger &root = create("", nullptr);
+        root.m_ownLevel = rootLevel;
+        root.m_ownBackend = &backend;
+        root.m_ownFormatter = std::make_shared<const Formatter>();
+        publish();
+    }
+
+    LoggerRegistry(const LoggerRegistry &) = delete;            // non construction-copyable
+    LoggerRegistry(LoggerRegistry &&) = delete;                 // non movable
+    LoggerRegistry &operator=(const LoggerRegistry &) = delete; // non copyable
+    LoggerRegistry &operator=(LoggerRegistry &&) = delete;      // move assignment
+
+    // -------------------------------------------------------------------------
+    // The registry behind gc::get(), made on first use.
+    static LoggerRegistry &instance() {
+        static LoggerRegistry registry({std::make_shared<ConsoleSink>()});
+        return registry;
+    }
+
+private:
+    std::mutex m_mutex;
+    // Ordered by name, so a parent always comes before its children.
+    std::map<std::string, std::unique_ptr<NamedLogger>, std::less<>> m_loggers;
+
+public:
+    // -------------------------------------------------------------------------
+    // The logger called name, "" being the root. Takes a lock, call it
+    // once per call site (GCLOG_LOGGER does) and keep the reference.
+    [[nodiscard]] NamedLogger &get(std::string_view name) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        const std::size_t count = m_loggers.size();
+        NamedLogger &logger = findOrCreate(name);
+        if (m_loggers.size() != count) {
+            publish();
+        }
+        return logger;
+    }
+
+    [[nodiscard]] NamedLogger &getRoot() { return get(""); }
+
+    // -------------------------------------------------------------------------
+    // Every logger made so far bar the root, in name order.
+    [[nodiscard]] std::vector<std::string> getNames() {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        std::vector<std::string> names;
+        names.reserve(m_loggers.size());
+        for (const auto &entry : m_loggers) {
+            if (!entry.first.empty()) {
+                names.push_back(entry.first);
+            }
+        }
+        return names;
+    }
+
+    // Setters -----------------------------------------------------------------
+    //
+    // Each takes effect for name and every descendant not setting it
+    // themselves, records already being written finish with what was
+    // in effect when they started.
+    void setLevel(std::string_view name, Logger::LogLevel level) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        findOrCreate(name).m_ownLevel = level;
+        publish();
+    }
+
+    // -------------------------------------------------------------------------
+    // Sets the root's level and makes every other logger inherit it.
+    [[maybe_unused]] void setLevel(Logger::LogLevel level) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (const auto &entry : m_loggers) {
+            entry.second->m_ownLevel.reset();
+        }
+        m_loggers.find("")->second->m_ownLevel = level;
+        publish();
+    }
+
+    // -------------------------------------------------------------------------
+    void setSinks(std::string_view name, std::vector<std::shared_ptr<Sink>> sinks) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        findOrCreate(name).m_ownSinks = std::move(sinks);
+        publish();
+    }
+
+    // -------------------------------------------------------------------------
+    [[maybe_unused]] void setFormatter(std::string_view name, std::shared_ptr<const Formatter> formatter) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        findOrCreate(name).m_ownFormatter = std::move(formatter);
+        publish();
+    }
+
+    // -------------------------------------------------------------------------
+    // Makes name inherit its level and sinks again. The root keeps its own.
+    [[maybe_unused]] void inherit(std::string_view name) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        NamedLogger &logger = findOrCreate(name);
+        if (logger.m_parent != nullptr) {
+            logger.m_ownLevel.reset();
+            logger.m_ownSinks.reset();
+            logger.m_ownFormatter.reset();
+        }
+        publish();
+    }
+
+private:
+    // -------------------------------------------------------------------------
+    NamedLogger &create(const std::string &name, NamedLogger *parent) {
+        std::unique_ptr<NamedLogger> logger(new NamedLogger(*this, name, parent));
+        return *m_loggers.emplace(name, std::move(logger)).first->second;
+    }
+
+    // -------------------------------------------------------------------------
+    // Creates the missing ancestors first, "a.b.c" needs "a.b" and "a".
+    NamedLogger &findOrCreate(std::string_view name) {
+        if (const auto found = m_loggers.find(name); found != m_loggers.end()) {
+            return *found->second;
+        }
+        const std::size_t dot = name.rfind('.');
+        NamedLogger &parent = findOrCreate(dot == std::string_view::npos ? "" : name.substr(0, dot));
+        return create(std::string(name), &parent);
+    }
+
+    // -------------------------------------------------------------------------
+    // Resolves every logger from its parent, in name order, and swaps in
+    // a new snapshot wherever the sinks or formatter changed.
+    void publish() {
+        for (const auto &entry : m_loggers) {
+            NamedLogger &logger = *entry.second;
+            const NamedLogger *parent = logger.m_parent;
+            const auto inherited =
+                    parent ? parent->m_output.load(std::memory_order_relaxed) : nullptr;
+
+            logger.Logger::setLevel(logger.m_ownLevel ? *logger.m_ownLevel : parent->getLogLevel());
+
+            // Sinks set on a logger take over from a backend above it.
+            static const std::vector<std::shared_ptr<Sink>> NoSinks;
+            Logger *backend = logger.m_ownSinks ? nullptr
+                              : logger.m_ownBackend ? logger.m_ownBackend : inherited->backend;
+            const auto &sinks = logger.m_ownSinks ? *logger.m_ownSinks
+                                : logger.m_ownBackend ? NoSinks : inherited->sinks;
+            const auto &formatter = logger.m_ownFormatter ? logger.m_ownFormatter : inherited->formatter;
+
+            const auto current = logger.m_output.load(std::memory_order_relaxed);
+            if (current != nullptr && current->sinks == sinks && current->formatter == formatter
+                && current->backend == backend) {
+                continue;
+            }
+            auto output = std::make_shared<const NamedLogger::Output>(
+                    NamedLogger::Output{sinks, formatter, backend});
+            logger.m_signalOutput.store(output.get(), std::memory_order_release);
+            logger.m_output.store(std::move(output), std::memory_order_release);
+        }
+    }
+};
+
+// -----------------------------------------------------------------------------
+inline void NamedLogger::setLevel(LogLevel level) { m_registry.setLevel(m_name, level); }
+
+// -----------------------------------------------------------------------------
+// The process wide logger called name, gc::get("net.http").
+inline NamedLogger &get(std::string_view name) { return LoggerRegistry::instance().get(name); }
+
+}//namespace gc
+
+// -----------------------------------------------------------------------------
+// The process wide logger called name, looked up the first time the call
+// site runs and then read from a function local static, so later calls
+// cost a guard check, no lock and no hashing:
+//
+//   GCLOG_LOGGER("net.http").info("GET {} {}", path, status);
+#define GCLOG_LOGGER(name)                                                      \
+    ([]() -> ::gc::NamedLogger & {                                              \
+        static ::gc::NamedLogger &gclogHandle_ = ::gc::get(name);               \
+        return gclogHandle_;                                                    \
+    }())
+
+#endif //GCLOG_REGISTRY_HPP
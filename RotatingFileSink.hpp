@@ -0,0 +1,675 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: RotatingFileSink.hpp                                        //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef GCLOG_ROTATINGFILESINK_HPP
+#define GCLOG_ROTATINGFILESINK_HPP
+
+#include "Logger.hpp"
+
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <tuple>
+
+#include <sys/stat.h>
+
+namespace gc {
+
+namespace detail::lz4 {
+    // A small LZ4 frame writer, greedy single probe matching and no
+    // checksums, so rotated logs can be compressed without a dependency.
+    // The files it writes decompress with the stock lz4 tool.
+    constexpr std::size_t BlockSize = 64 * 1024;
+
+    // Worst case size of a compressed block, incompressible input grows.
+    constexpr std::size_t maxCompressedSize(std::size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    // -------------------------------------------------------------------------
+    // xxHash32 with seed 0 for inputs shorter than 16 bytes, all the frame
+    // header needs: 4 byte lanes, then the bytes left over.
+    constexpr std::uint32_t shortHash(const unsigned char *data, std::size_t size) {
+        constexpr std::uint32_t Prime1 = 2654435761U;
+        constexpr std::uint32_t Prime2 = 2246822519U;
+        constexpr std::uint32_t Prime3 = 3266489917U;
+        constexpr std::uint32_t Prime4 = 668265263U;
+        constexpr std::uint32_t Prime5 = 374761393U;
+
+        auto hash = static_cast<std::uint32_t>(Prime5 + size);
+        std::size_t index = 0;
+        for (; index + 4 <= size; index += 4) {
+            const std::uint32_t lane = data[index]
+                                       | static_cast<std::uint32_t>(data[index + 1]) << 8
+                                       | static_cast<std::uint32_t>(data[index + 2]) << 16
+                                       | static_cast<std::uint32_t>(data[index + 3]) << 24;
+            hash += lane * Prime3;
+            hash = ((hash << 17) | (hash >> 15)) * Prime4;
+        }
+        for (; index < size; ++index) {
+            hash += data[index] * Prime5;
+            hash = ((hash << 11) | (hash >> 21)) * Prime1;
+        }
+        hash ^= hash >> 15;
+        hash *= Prime2;
+        hash ^= hash >> 13;
+        hash *= Prime3;
+        hash ^= hash >> 16;
+        return hash;
+    }
+
+    // -------------------------------------------------------------------------
+    inline std::uint32_t read32(const unsigned char *data) {
+        std::uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    // -------------------------------------------------------------------------
+    inline unsigned char *writeLength(unsigned char *out, std::size_t length) {
+        for (; length >= 255; length -= 255) {
+            *out++ = 255;
+        }
+        *out++ = static_cast<unsigned char>(length);
+        return out;
+    }
+
+    // -------------------------------------------------------------------------
+    inline unsigned char *writeSequence(unsigned char *out,
+                                        const unsigned char *literals,
+                                        std::size_t literalLength,
+                                        std::size_t offset,
+                                        std::size_t matchLength) {
+        const std::size_t matchCode = matchLength - 4;
+        *out++ = static_cast<unsigned char>((std::min<std::size_t>(literalLength, 15) << 4)
+                                            | std::min<std::size_t>(matchCode, 15));
+        if (literalLength >= 15) {
+            out = writeLength(out, literalLength - 15);
+        }
+        std::memcpy(out, literals, literalLength);
+        out += literalLength;
+
+        *out++ = static_cast<unsigned char>(offset & 0xFF);
+        *out++ = static_cast<unsigned char>(offset >> 8);
+        if (matchCode >= 15) {
+            out = writeLength(out, matchCode - 15);
+        }
+        return out;
+    }
+
+    // -------------------------------------------------------------------------
+    // Compresses one independent block into out, which must hold
+    // maxCompressedSize(size) bytes, and returns the compressed size.
+    inline std::size_t compressBlock(const unsigned char *in, std::size_t size,
+                                     unsigned char *out) {
+        constexpr std::size_t MinMatch = 4;
+        constexpr std::size_t LastLiterals = 5;  // the block must end in literals
+        constexpr std::size_t MatchStartLimit = 12;
+        constexpr std::size_t MaxOffset = 65535;
+        constexpr int HashBits = 12;
+
+        std::array<std::uint32_t, 1U << HashBits> table{};
+        unsigned char *const start = out;
+        std::size_t anchor = 0;
+
+        if (size > MatchStartLimit) {
+            const std::size_t matchEndLimit = size - LastLiterals;
+            std::size_t position = 0;
+
+            while (position + MatchStartLimit <= size) {
+                const std::uint32_t sequence = read32(in + position);
+                const std::uint32_t hash = (sequence * 2654435761U) >> (32 - HashBits);
+                const std::size_t candidate = table[hash];
+                table[hash] = static_cast<std::uint32_t>(position);
+
+                if (candidate >= position || position - candidate > MaxOffset
+                    || read32(in + candidate) != sequence) {
+                    ++position;
+                    continue;
+                }
+
+                std::size_t length = MinMatch;
+                while (position + length < matchEndLimit
+                       && in[candidate + length] == in[position + length]) {
+                    ++length;
+                }
+
+                out = writeSequence(out, in + anchor, position - anchor,
+                                    position - candidate, length);
+                position += length;
+                anchor = position;
+            }
+        }
+
+        const std::size_t literalLength = size - anchor;
+        *out++ = static_cast<unsigned char>(std::min<std::size_t>(literalLength, 15) << 4);
+        if (literalLength >= 15) {
+            out = writeLength(out, literalLength - 15);
+        }
+        std::memcpy(out, in + anchor, literalLength);
+        out += literalLength;
+
+        return static_cast<std::size_t>(out - start);
+    }
+
+    // -------------------------------------------------------------------------
+    inline void writeLittle32(std::ostream &out, std::uint32_t value) {
+        const char bytes[] = {static_cast<char>(value & 0xFF),
+                              static_cast<char>((value >> 8) & 0xFF),
+                              static_cast<char>((value >> 16) & 0xFF),
+                              static_cast<char>((value >> 24) & 0xFF)};
+        out.write(bytes, sizeof(bytes));
+    }
+
+    // -------------------------------------------------------------------------
+    // Writes from as an LZ4 frame to to, false if either file failed.
+    inline bool compressFile(const std::string &from, const std::string &to) {
+        std::ifstream in(from, std::ios::binary);
+        std::ofstream out(to, std::ios::binary | std::ios::trunc);
+        if (!in || !out) {
+            return false;
+        }
+
+        // Version 1, independent blocks, 64 KiB maximum block size.
+        constexpr unsigned char Descriptor[] = {0x60, 0x40};
+        constexpr std::uint32_t Magic = 0x184D2204;
+        writeLittle32(out, Magic);
+        out.write(reinterpret_cast<const char *>(Descriptor), sizeof(Descriptor));
+        out.put(static_cast<char>((shortHash(Descriptor, sizeof(Descriptor)) >> 8) & 0xFF));
+
+        std::vector<char> raw(BlockSize);
+        std::vector<char> packed(maxCompressedSize(BlockSize));
+        constexpr std::uint32_t Uncompressed = 0x80000000U;
+
+        while (in) {
+            in.read(raw.data(), static_cast<std::streamsize>(raw.size()));
+            const auto size = static_cast<std::size_t>(in.gcount());
+            if (size == 0) {
+                break;
+            }
+
+            const std::size_t packedSize = compressBlock(
+                    reinterpret_cast<const unsigned char *>(raw.data()), size,
+                    reinterpret_cast<unsigned char *>(packed.data()));
+            if (packedSize < size) {
+                writeLittle32(out, static_cast<std::uint32_t>(packedSize));
+                out.write(packed.data(), static_cast<std::streamsize>(packedSize));
+            } else {
+                writeLittle32(out, static_cast<std::uint32_t>(size) | Uncompressed);
+                out.write(raw.data(), static_cast<std::streamsize>(size));
+            }
+        }
+
+        writeLittle32(out, 0);  // end mark
+        out.flush();
+        return in.eof() && static_cast<bool>(out);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// A file sink that moves its file aside once it would grow past maxBytes,
+// or at local midnight when daily is set. Finished files are named
+// app.log.2026-10-18.3, the date the file was started and a count within
+// that date, and are optionally compressed to app.log.2026-10-18.3.lz4.
+//
+// The thread crossing the boundary only swaps in a file the background
+// worker opened ahead of time (app.log.next), the renames, compression and
+// deleting old files all happen on the worker. The worker opens the next
+// file straight after the renames, before compressing, so a rotation
+// right behind another waits briefly for it at most. If no next file can
+// be had, lines keep going to the current one and are counted as overruns.
+class RotatingFileSink final : public Sink
+{
+public:
+    enum class Compression : char {
+        NONE = 0, LZ4
+    };
+
+    struct RotationPolicy {
+        std::size_t maxBytes{10 * 1024 * 1024};  // 0 = off
+        bool daily{false};
+        std::size_t maxFiles{5};                 // rotated files kept, 0 = no limit
+        std::uintmax_t maxTotalBytes{0};         // for rotated files, 0 = no limit
+        Compression compression{Compression::NONE};
+    };
+
+    RotatingFileSink() = delete;
+
+    [[maybe_unused]] RotatingFileSink(std::string filename, RotationPolicy rotationPolicy)
+            : RotatingFileSink(std::move(filename), rotationPolicy,
+                               FileSink::DefaultBufferSize, FileSink::FlushPolicy{}) {}
+
+    /**************************************************************
+     * @brief Appends to filename, counting what is already there
+     * towards the first rotation. An existing file is dated by
+     * when it was last written. A next file holding lines, left by
+     * a crash in the middle of a rotation, finishes that rotation.
+     *
+     * @Note: throws std::system_error if the file can't be opened.
+     * Rotating flushes the old file whatever flushPolicy says.
+     *************************************************************/
+    [[maybe_unused]] RotatingFileSink(
+            std::string filename,
+            RotationPolicy rotationPolicy,
+            std::size_t bufferSize,
+            FileSink::FlushPolicy flushPolicy)
+            : m_filename(std::move(filename)),
+              m_rotationPolicy(rotationPolicy),
+              m_bufferSize(bufferSize),
+              m_flushPolicy(flushPolicy)
+    {
+        m_flushPolicy.onShutdown = true;
+        std::string interrupted = finishInterruptedRotation();
+
+        struct stat status{};
+        const bool exists = ::stat(m_filename.c_str(), &status) == 0;
+        m_size = exists ? static_cast<std::size_t>(status.st_size) : 0;
+        startPeriod(exists ? status.st_mtime : std::time(nullptr));
+
+        m_file = std::make_unique<FileSink>(m_filename, m_bufferSize, m_flushPolicy);
+        m_worker = std::thread([this, interrupted = std::move(interrupted)] {
+            runWorker(interrupted);
+        });
+    }
+
+    ~RotatingFileSink() override
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stopWorker = true;
+        }
+        m_workerWakeup.notify_one();
+        m_worker.join();
+
+        // An unused next file is empty, one left behind by a crash is
+        // kept for the next start to finish its rotation.
+        if (m_spare) {
+            m_spare.reset();
+            std::error_code error;
+            if (std::filesystem::file_size(nextName(), error) == 0 && !error) {
+                std::filesystem::remove(nextName(), error);
+            }
+        }
+    }
+
+    RotatingFileSink(const RotatingFileSink &) = delete;            // non construction-copyable
+    RotatingFileSink(RotatingFileSink &&) = delete;                 // non movable
+    RotatingFileSink &operator=(const RotatingFileSink &) = delete; // non copyable
+    RotatingFileSink &operator=(RotatingFileSink &&) = delete;      // move assignment
+
+private:
+    // A finished file the worker has to move aside.
+    struct Rotation {
+        std::unique_ptr<FileSink> file;
+        std::string date;
+    };
+
+    mutable std::mutex m_mutex;
+    std::string m_filename;
+    RotationPolicy m_rotationPolicy;
+    std::size_t m_bufferSize;
+    FileSink::FlushPolicy m_flushPolicy;
+
+    std::unique_ptr<FileSink> m_file;
+    std::unique_ptr<FileSink> m_spare;
+    std::size_t m_size{0};
+    std::time_t m_periodStart{0};
+    std::time_t m_periodEnd{0};
+
+    std::thread m_worker;
+    std::condition_variable m_workerWakeup;
+    std::condition_variable m_workerIdle;
+    std::condition_variable m_spareReady;
+    bool m_spareExpected{true};      // the worker is opening one
+    std::uint64_t m_overruns{0};
+    std::deque<Rotation> m_rotations;
+    FileSink *m_finishing{nullptr};  // the rotation the worker is on
+    MetricsSnapshot m_retired;       // flushes of the files rotated away
+    bool m_workerBusy{true};
+    bool m_stopWorker{false};
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] const std::string &getFilename() const { return m_filename; }
+
+    [[nodiscard]] const RotationPolicy &getRotationPolicy() const { return m_rotationPolicy; }
+
+    // -------------------------------------------------------------------------
+    // Lines written to a file that was due to rotate, because no next
+    // file could be opened.
+    [[nodiscard]] std::uint64_t getOverrunCount() const {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_overruns;
+    }
+
+    // -------------------------------------------------------------------------
+    // Also waits for rotations already started to be renamed, compressed
+    // and pruned, so the directory is settled when it returns.
+    void flush() override {
+        std::unique_lock<std::mutex> guard(m_mutex);
+        m_workerIdle.wait(guard, [this] { return !m_workerBusy && m_rotations.empty(); });
+        m_file->flush();
+    }
+
+    // -------------------------------------------------------------------------
+    void flushFromSignal() override {
+        m_file->flushFromSignal();
+    }
+
+    // -------------------------------------------------------------------------
+    // Flushes are the files' own, the live one's, those waiting to be
+    // rotated and those already gone.
+    [[nodiscard]] MetricsSnapshot getMetrics() const override {
+        MetricsSnapshot snapshot = m_metrics.snapshot();
+        std::lock_guard<std::mutex> guard(m_mutex);
+        snapshot.addFlushes(m_retired);
+        snapshot.addFlushes(m_file->getMetrics());
+        for (const Rotation &rotation : m_rotations) {
+            snapshot.addFlushes(rotation.file->getMetrics());
+        }
+        if (m_finishing != nullptr) {
+            snapshot.addFlushes(m_finishing->getMetrics());
+        }
+        return snapshot;
+    }
+
+    // -------------------------------------------------------------------------
+    void write(const LogLine &line) override {
+        m_metrics.countBytes(line.text.size());
+        std::unique_lock<std::mutex> guard(m_mutex);
+
+        const std::size_t lineSize = line.text.size();
+        if (isDue(lineSize)) {
+            m_spareReady.wait_for(guard, SpareWait, [&] {
+                return m_spare || !m_spareExpected || !isDue(lineSize);
+            });
+            if (isDue(lineSize)) {
+                if (!m_spare && !m_spareExpected) {
+                    // The worker couldn't open one, the names are settled.
+                    m_spare = openSpare();
+                }
+                if (m_spare) {
+                    rotate();
+                } else {
+                    ++m_overruns;
+                }
+            }
+        }
+
+        m_file->write(line);
+        m_size += line.text.size();
+    }
+
+private:
+    // Longest a line due to rotate waits for the worker's next file.
+    static constexpr std::chrono::milliseconds SpareWait{100};
+
+    // -------------------------------------------------------------------------
+    void rotate() {
+        m_rotations.push_back({std::move(m_file), formatDate(m_periodStart)});
+        m_file = std::move(m_spare);
+        m_spareExpected = true;
+        m_size = 0;
+        startPeriod(std::time(nullptr));
+        m_workerBusy = true;
+        m_workerWakeup.notify_one();
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] bool isDue(std::size_t lineSize) const {
+        if (m_rotationPolicy.maxBytes != 0 && m_size != 0
+            && m_size + lineSize > m_rotationPolicy.maxBytes) {
+            return true;
+        }
+        return m_rotationPolicy.daily && std::time(nullptr) >= m_periodEnd;
+    }
+
+    // -------------------------------------------------------------------------
+    void startPeriod(std::time_t start) {
+        tm midnight{};
+        localtime_r(&start, &midnight);
+        midnight.tm_hour = 0;
+        midnight.tm_min = 0;
+        midnight.tm_sec = 0;
+        midnight.tm_mday += 1;
+        midnight.tm_isdst = -1;
+
+        m_periodStart = start;
+        m_periodEnd = std::mktime(&midnight);
+    }
+
+    // -------------------------------------------------------------------------
+    static std::string formatDate(std::time_t time) {
+        tm date{};
+        localtime_r(&time, &date);
+        return fmt::format("{:04}-{:02}-{:02}",
+                           date.tm_year + 1900, date.tm_mon + 1, date.tm_mday);
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] std::string nextName() const { return m_filename + ".next"; }
+
+    // -------------------------------------------------------------------------
+    // interrupted is a file finishInterruptedRotation() moved aside.
+    void runWorker(const std::string &interrupted) {
+        publishSpare(openSpare());
+        if (!interrupted.empty()) {
+            compress(interrupted);
+            prune();
+        }
+
+        std::unique_lock<std::mutex> guard(m_mutex);
+        while (true) {
+            if (m_rotations.empty()) {
+                m_workerBusy = false;
+                m_workerIdle.notify_all();
+                if (m_stopWorker) {
+                    return;
+                }
+                m_workerWakeup.wait(guard, [this] { return m_stopWorker || !m_rotations.empty(); });
+                continue;
+            }
+
+            Rotation rotation = std::move(m_rotations.front());
+            m_rotations.pop_front();
+            m_finishing = rotation.file.get();
+            guard.unlock();
+
+            const std::string rotated = retire(rotation);
+            publishSpare(openSpare());
+            compress(rotated);
+            prune();
+
+            guard.lock();
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void publishSpare(std::unique_ptr<FileSink> spare) {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_spare = std::move(spare);
+            m_spareExpected = false;
+        }
+        m_spareReady.notify_all();
+    }
+
+    // -------------------------------------------------------------------------
+    // Closes the finished file and moves it aside, the next file taking
+    // its name. Failed renames are ignored, logging carries on into
+    // whichever file is open. Returns the finished file's new name.
+    std::string retire(Rotation &rotation) {
+        rotation.file->flush();
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_retired.addFlushes(rotation.file->getMetrics());
+            m_finishing = nullptr;
+        }
+        rotation.file.reset();  // closes
+
+        const std::string rotated = rotatedName(rotation.date);
+        std::rename(m_filename.c_str(), rotated.c_str());
+        std::rename(nextName().c_str(), m_filename.c_str());
+        return rotated;
+    }
+
+    // -------------------------------------------------------------------------
+    void compress(const std::string &rotated) const {
+        if (m_rotationPolicy.compression == Compression::LZ4) {
+            if (detail::lz4::compressFile(rotated, rotated + ".lz4")) {
+                std::remove(rotated.c_str());
+            } else {
+                std::remove((rotated + ".lz4").c_str());
+            }
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // A next file with lines in it means a crash came between a rotation
+    // and its renames: it holds the newest lines, the live file the ones
+    // before. Does the renames, returning the live file's new name, or
+    // an empty string if there was nothing to do.
+    std::string finishInterruptedRotation() const {
+        struct stat next{};
+        if (::stat(nextName().c_str(), &next) != 0 || !S_ISREG(next.st_mode) || next.st_size == 0) {
+            return {};
+        }
+
+        std::string rotated;
+        struct stat live{};
+        if (::stat(m_filename.c_str(), &live) == 0) {
+            rotated = rotatedName(formatDate(live.st_mtime));
+            if (std::rename(m_filename.c_str(), rotated.c_str()) != 0) {
+                return {};
+            }
+        }
+        std::rename(nextName().c_str(), m_filename.c_str());
+        return rotated;
+    }
+
+    // -------------------------------------------------------------------------
+    // Null if it can't be opened, a due rotation then tries again.
+    std::unique_ptr<FileSink> openSpare() {
+        try {
+            return std::make_unique<FileSink>(nextName(), m_bufferSize, m_flushPolicy);
+        } catch (const std::system_error &) {
+            return nullptr;
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // A rotated file of ours as found in the directory.
+    struct RotatedFile {
+        std::filesystem::path path;
+        std::string date;
+        unsigned long index;
+        std::uintmax_t size;
+    };
+
+    // -------------------------------------------------------------------------
+    // Rotated files oldest first.
+    [[nodiscard]] std::vector<RotatedFile> listRotated() const {
+        const std::filesystem::path live(m_filename);
+        const std::string prefix = live.filename().string() + '.';
+        const std::filesystem::path directory =
+                live.has_parent_path() ? live.parent_path() : std::filesystem::path(".");
+
+        std::vector<RotatedFile> files;
+        std::error_code error;
+        for (const auto &entry : std::filesystem::directory_iterator(directory, error)) {
+            const std::string name = entry.path().filename().string();
+            if (name.compare(0, prefix.size(), prefix) != 0) {
+                continue;
+            }
+
+            // date.index, optionally .lz4
+            std::string_view rest = std::string_view(name).substr(prefix.size());
+            if (rest.size() > 4 && rest.substr(rest.size() - 4) == ".lz4") {
+                rest.remove_suffix(4);
+            }
+            if (rest.size() < 12 || rest[4] != '-' || rest[7] != '-' || rest[10] != '.') {
+                continue;
+            }
+
+            unsigned long index = 0;
+            const char *first = rest.data() + 11;
+            const char *last = rest.data() + rest.size();
+            const auto [end, status] = std::from_chars(first, last, index);
+            if (status != std::errc() || end != last) {
+                continue;
+            }
+
+            std::error_code sizeError;
+            const auto size = entry.file_size(sizeError);
+            files.push_back({entry.path(), std::string(rest.substr(0, 10)), index,
+                             sizeError ? 0 : size});
+        }
+
+        std::sort(files.begin(), files.end(), [](const auto &lhs, const auto &rhs) {
+            return std::tie(lhs.date, lhs.index) < std::tie(rhs.date, rhs.index);
+        });
+        return files;
+    }
+
+    // -------------------------------------------------------------------------
+    [[nodiscard]] std::string rotatedName(const std::string &date) const {
+        unsigned long index = 0;
+        for (const auto &file : listRotated()) {
+            if (file.date == date) {
+                index = std::max(index, file.index);
+            }
+        }
+        return fmt::format("{}.{}.{}", m_filename, date, index + 1);
+    }
+
+    // -------------------------------------------------------------------------
+    void prune() const {
+        auto files = listRotated();
+
+        std::uintmax_t total = 0;
+        for (const auto &file : files) {
+            total += file.size;
+        }
+
+        std::size_t count = files.size();
+        for (const auto &file : files) {
+            const bool tooMany = m_rotationPolicy.maxFiles != 0 && count > m_rotationPolicy.maxFiles;
+            const bool tooLarge = m_rotationPolicy.maxTotalBytes != 0
+                                  && total > m_rotationPolicy.maxTotalBytes;
+            if (!tooMany && !tooLarge) {
+                break;
+            }
+
+            std::error_code error;
+            std::filesystem::remove(file.path, error);
+            total -= file.size;
+            --count;
+        }
+    }
+};
+
+}//namespace gc
+
+#endif //GCLOG_ROTATINGFILESINK_HPP
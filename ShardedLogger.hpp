@@ -0,0 +1,387 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: ShardedLogger.hpp                                           //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef GCLOG_SHARDEDLOGGER_HPP
+#define GCLOG_SHARDEDLOGGER_HPP
+
+#include "BinaryLogger.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace gc {
+// -----------------------------------------------------------------------------
+    class ShardedLogger final : public Logger
+    {
+    public:
+        enum class OverflowPolicy : char {
+            BLOCK = 0, DROP_NEWEST
+        };
+
+        static constexpr std::size_t DefaultShardSize = 256U * 1024U;
+        static constexpr std::chrono::microseconds DefaultSkewWindow{1000};
+
+        ShardedLogger() = delete;
+
+        /**************************************************************
+         * @brief Decorates backend like AsyncLogger, but every producer
+         * thread gets a ring of its own, so producers never touch a
+         * cache line another producer writes. The writer thread merges
+         * the rings by timestamp before calling backend.
+         *
+         * @Note: a record is held back until it is skewWindow old, so
+         * one from a thread that was descheduled between taking its
+         * timestamp and publishing still comes out in order. Output is
+         * globally ordered as long as no publish takes longer than that.
+         * Messages longer than half a shard are cut to fit.
+         *************************************************************/
+        [[maybe_unused]] explicit ShardedLogger(
+                Logger &backend,
+                std::size_t shardSize = DefaultShardSize,
+                std::chrono::nanoseconds skewWindow = DefaultSkewWindow,
+                OverflowPolicy overflowPolicy = OverflowPolicy::BLOCK)
+                : Logger(backend.getLogLevel()),
+                  m_backend(backend),
+                  m_overflowPolicy(overflowPolicy),
+                  m_skewWindow(static_cast<std::uint64_t>(skewWindow.count())),
+                  m_shards([shardSize] { return std::make_unique<binlog::ThreadBuffer>(shardSize); })
+        {
+            m_worker = std::thread([this] { run(); });
+        }
+
+        ~ShardedLogger() override { shutdown(); }
+
+        ShardedLogger(const ShardedLogger &) = delete;            // non construction-copyable
+        ShardedLogger(ShardedLogger &&) = delete;                 // non movable
+        ShardedLogger &operator=(const ShardedLogger &) = delete; // non copyable
+        ShardedLogger &operator=(ShardedLogger &&) = delete;      // move assignment
+
+    private:
+        // A shard's oldest record, waiting in the merge heap.
+        struct Pending
+        {
+            std::uint64_t ticks;
+            binlog::ThreadBuffer *shard;
+            std::uint32_t id;
+            std::string_view message;
+        };
+
+        Logger &m_backend;
+        const OverflowPolicy m_overflowPolicy;
+        const std::uint64_t m_skewWindow;  // nanoseconds
+        detail::PerThread<binlog::ThreadBuffer> m_shards;
+        std::atomic<bool> m_stopped{false};
+
+        // Writer thread state.
+        binlog::TickClock m_clock;
+        std::vector<binlog::ThreadBuffer *> m_snapshot;
+        std::vector<Pending> m_heap;
+        std::string m_message;
+        std::optional<std::uint64_t> m_heldBack;  // oldest record the last merge left, nanoseconds
+
+        detail::Wakeup m_wakeup;
+        std::condition_variable m_passDone;
+        std::uint64_t m_passes{0};
+        bool m_flushRequested{false};
+        bool m_stopRequested{false};
+        std::atomic<bool> m_shardFull{false};  // a BLOCK producer is waiting for room
+        std::thread m_worker;
+
+    public:
+        // Getters -------------------------------------------------------------
+        [[nodiscard]] OverflowPolicy getOverflowPolicy() const { return m_overflowPolicy; }
+
+        [[nodiscard]] std::chrono::nanoseconds getSkewWindow() const {
+            return std::chrono::nanoseconds(m_skewWindow);
+        }
+
+        // ---------------------------------------------------------------------
+        // Records discarded by DROP_NEWEST since construction.
+        [[nodiscard]] std::uint64_t getDroppedCount() const
+        {
+            return getMetrics().dropped;
+        }
+
+        // ---------------------------------------------------------------------
+        void log(LogLevel level, const std::string &message) override { push(level, message); }
+
+        // ---------------------------------------------------------------------
+        void vlog(LogLevel level, fmt::string_view format, fmt::format_args args) override
+        {
+            if (!m_backend.isEnabled(level)) {
+                return;
+            }
+            if (m_stopped.load(std::memory_order_acquire)) {
+                m_backend.vlog(level, format, args);
+                return;
+            }
+            auto &buffer = detail::lineBuffer();
+            buffer.clear();
+            fmt::vformat_to(std::back_inserter(buffer), format, args);
+            push(level, std::string_view(buffer.data(), buffer.size()));
+        }
+
+        // ---------------------------------------------------------------------
+        // Returns once every record pushed before the call has been written,
+        // skew window or not, and the backend has been flushed.
+        void flush() override
+        {
+            {
+                std::unique_lock<std::mutex> guard(m_wakeup.getMutex());
+                if (!m_stopRequested) {
+                    // A pass that was already running may have missed our
+                    // records, the one after it can't have.
+                    const std::uint64_t target = m_passes + 2;
+                    m_flushRequested = true;
+                    m_wakeup.wake();
+                    m_passDone.wait(guard, [&] { return m_passes >= target || m_stopRequested; });
+                }
+            }
+            m_backend.flush();
+        }
+
+        // ---------------------------------------------------------------------
+        // What the backend has buffered goes first, then what is still in
+        // the shards is written raw to fd as "[LEVEL]: message" lines, a
+        // shard at a time rather than merged. The shards are left as they
+        // are, the writer thread may be in the middle of one.
+        void flushFromSignal(int fd) override
+        {
+            m_backend.flushFromSignal(fd);
+
+            m_shards.forEachFromSignal([fd](const binlog::ThreadBuffer &shard) {
+                shard.peek([fd](const binlog::ThreadBuffer::Header &header, std::string_view message) {
+                    const std::string_view tag = getLevelTag(toLevel(header.id));
+                    detail::writeFromSignal(fd, tag.data(), tag.size());
+                    detail::writeFromSignal(fd, message.data(), message.size());
+                    detail::writeFromSignal(fd, "\n", 1);
+                });
+            });
+        }
+
+        // ---------------------------------------------------------------------
+        // Writes out every shard and stops the writer thread. Anything
+        // logged afterwards goes straight to the backend on the caller's
+        // thread.
+        void shutdown()
+        {
+            {
+                std::lock_guard<std::mutex> guard(m_wakeup.getMutex());
+                if (m_stopRequested) {
+                    return;
+                }
+                m_stopRequested = true;
+            }
+            m_wakeup.wake();
+            m_passDone.notify_all();
+
+            if (m_worker.joinable()) {
+                m_worker.join();
+            }
+            m_stopped.store(true, std::memory_order_release);
+
+            // Pushes that raced with the writer's final merge.
+            merge(true);
+            m_backend.flush();
+        }
+
+    private:
+        // ---------------------------------------------------------------------
+        // Call site ids aren't used here, the id holds the level plus one
+        // since 0 marks a ring's padding.
+        static std::uint32_t toId(LogLevel level) { return static_cast<std::uint32_t>(level) + 1U; }
+
+        static LogLevel toLevel(std::uint32_t id) { return static_cast<LogLevel>(id - 1U); }
+
+        // ---------------------------------------------------------------------
+        void push(LogLevel level, const std::string &message)
+        {
+            if (!m_backend.isEnabled(level)) {
+                return;
+            }
+            if (m_stopped.load(std::memory_order_acquire)) {
+                m_backend.log(level, message);
+                return;
+            }
+            push(level, std::string_view(message));
+        }
+
+        // ---------------------------------------------------------------------
+        void push(LogLevel level, std::string_view message)
+        {
+            using Header = binlog::ThreadBuffer::Header;
+
+            const std::uint64_t ticks = binlog::TickClock::now();
+            binlog::ThreadBuffer &shard = m_shards.local();
+            message = message.substr(0, shard.getCapacity() / 2 - sizeof(Header));
+            const std::size_t size = sizeof(Header) + message.size();
+
+            char *out = shard.reserve(size);
+            if (out == nullptr) {
+                const auto blockedSince = std::chrono::steady_clock::now();
+                while (out == nullptr) {
+                    if (m_overflowPolicy == OverflowPolicy::DROP_NEWEST || m_stopped.load(std::memory_order_acquire)) {
+                        m_metrics.countDropped();
+                        return;
+                    }
+                    m_shardFull.store(true, std::memory_order_seq_cst);
+                    m_wakeup.notify();
+                    std::this_thread::yield();
+                    out = shard.reserve(size);
+                }
+                m_metrics.countBlocked(std::chrono::steady_clock::now() - blockedSince);
+            }
+
+            const Header header{static_cast<std::uint32_t>(size), toId(level), ticks};
+            std::memcpy(out, &header, sizeof(header));
+            std::memcpy(out + sizeof(header), message.data(), message.size());
+            shard.commit(size);
+            m_wakeup.notify();
+            m_metrics.countRecord(static_cast<std::size_t>(level));
+        }
+
+        // ---------------------------------------------------------------------
+        // Puts shard's oldest record in the heap if it is old enough,
+        // otherwise notes when it will be.
+        void pushPending(binlog::ThreadBuffer &shard, std::uint64_t cutoff)
+        {
+            binlog::ThreadBuffer::Header header{};
+            std::string_view message;
+            if (!shard.front(header, message)) {
+                return;
+            }
+            if (cutoff != std::numeric_limits<std::uint64_t>::max()) {
+                const std::uint64_t taken = m_clock.toNanoseconds(header.ticks);
+                if (taken > cutoff) {
+                    m_heldBack = std::min(m_heldBack.value_or(taken), taken);
+                    return;
+                }
+            }
+            m_heap.push_back({header.ticks, &shard, header.id, message});
+            std::push_heap(m_heap.begin(), m_heap.end(), isLater);
+        }
+
+        static bool isLater(const Pending &lhs, const Pending &rhs) { return lhs.ticks > rhs.ticks; }
+
+        // ---------------------------------------------------------------------
+        // k-way merge of the shards' records older than the skew window,
+        // or of all of them, oldest first. Each shard is in order already,
+        // so the heap holds at most one record per shard.
+        std::size_t merge(bool everything)
+        {
+            m_shards.snapshot(m_snapshot);
+            const std::uint64_t cutoff = everything
+                                         ? std::numeric_limits<std::uint64_t>::max()
+                                         : m_clock.toNanoseconds(binlog::TickClock::now()) - m_skewWindow;
+
+            m_heap.clear();
+            m_heldBack.reset();
+            for (auto *shard : m_snapshot) {
+                pushPending(*shard, cutoff);
+            }
+
+            std::size_t count = 0;
+            while (!m_heap.empty()) {
+                std::pop_heap(m_heap.begin(), m_heap.end(), isLater);
+                const Pending next = m_heap.back();
+                m_heap.pop_back();
+
+                m_message.assign(next.message);
+                next.shard->pop();
+                const std::uint64_t taken = m_clock.toNanoseconds(next.ticks);
+                const timespec time{static_cast<std::time_t>(taken / 1'000'000'000U),
+                                    static_cast<long>(taken % 1'000'000'000U)};
+                m_backend.logAt(toLevel(next.id), time, m_message);
+                ++count;
+
+                pushPending(*next.shard, cutoff);
+            }
+            // What was old enough to merge, the shards' backlog.
+            m_metrics.noteQueueDepth(count);
+            return count;
+        }
+
+        // ---------------------------------------------------------------------
+        bool hasRecords()
+        {
+            m_shards.snapshot(m_snapshot);
+            return std::any_of(m_snapshot.begin(), m_snapshot.end(), [](const binlog::ThreadBuffer *shard) {
+                return !shard->isEmpty();
+            });
+        }
+
+        // ---------------------------------------------------------------------
+        void run()
+        {
+            // Give the tick rate a few milliseconds of baseline before the
+            // first cutoff is taken, it is refined on every pass.
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+            bool everything = false;
+
+            for (;;) {
+                m_clock.calibrate();
+                const std::size_t count = merge(everything);
+
+                std::unique_lock<std::mutex> guard(m_wakeup.getMutex());
+                ++m_passes;
+                m_passDone.notify_all();
+                if (m_stopRequested) {
+                    break;
+                }
+                // A flush waits for the pass after the complete one, which
+                // needn't wait. Records held back by the skew window are
+                // due at a known time, newer ones can only be due later,
+                // so until then only a full shard is worth waking for.
+                if (count == 0 && !m_flushRequested && !everything) {
+                    if (m_heldBack) {
+                        const std::uint64_t due = *m_heldBack + m_skewWindow;
+                        const std::uint64_t now = m_clock.toNanoseconds(binlog::TickClock::now());
+                        const auto deadline = detail::Wakeup::Clock::now()
+                                              + std::chrono::nanoseconds(due > now ? due - now : 0);
+                        m_wakeup.sleepUntil(guard, deadline, [this] {
+                            return m_flushRequested || m_stopRequested
+                                   || m_shardFull.load(std::memory_order_seq_cst);
+                        });
+                    } else {
+                        m_wakeup.sleep(guard, [this] {
+                            return m_flushRequested || m_stopRequested
+                                   || m_shardFull.load(std::memory_order_seq_cst) || hasRecords();
+                        });
+                    }
+                    m_shardFull.store(false, std::memory_order_relaxed);
+                }
+                everything = m_flushRequested || m_stopRequested;
+                m_flushRequested = false;
+            }
+
+            merge(true);
+        }
+    };
+}// namespace gc
+
+#endif //GCLOG_SHARDEDLOGGER_HPP
@@ -0,0 +1,471 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: SharedMemorySink.hpp                                        //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+
+#ifndef GCLOG_SHAREDMEMORYSINK_HPP
+#define GCLOG_SHAREDMEMORYSINK_HPP
+
+#include "Logger.hpp"
+
+#include <cstring>
+#include <optional>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace gc {
+
+namespace detail {
+    // -------------------------------------------------------------------------
+    // getpid() without the syscall, kept right in forked children.
+    inline pid_t currentPid() {
+        static std::atomic<pid_t> cached = [] {
+            ::pthread_atfork(nullptr, nullptr, [] { cached.store(::getpid(), std::memory_order_relaxed); });
+            return ::getpid();
+        }();
+        return cached.load(std::memory_order_relaxed);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// A bounded multi-producer queue of log lines in a POSIX shared memory
+// segment, the channel between SharedMemorySinks in any number of
+// processes and the one gclog_collector draining it.
+//
+// Cells are fixed size and claimed the way AsyncRecordQueue claims them,
+// with a compare-exchange on the enqueue position and a per-cell
+// sequence number, all of it atomics living in the segment. A producer
+// never waits: a full ring drops the line and counts it in the segment.
+// A producer dying between claiming a cell and publishing it would stall
+// the consumer at that cell, so the claimer's pid goes into the cell
+// first and the consumer skips the cell once that process is gone, or
+// once it has stayed unpublished for the stall timeout, counting it as
+// dropped.
+//
+// The consumer sees lines in the order their cells were claimed, not by
+// time. Cells carry no timestamp to merge on.
+class SharedRing
+{
+public:
+    struct Geometry {
+        std::size_t cellCount{4096};  // rounded up to a power of two
+        std::size_t cellSize{512};    // bytes per cell, header included
+    };
+
+    // A line as the consumer sees it, valid until the visitor returns.
+    struct Record {
+        Logger::LogLevel level;
+        pid_t pid;
+        std::string_view text;
+    };
+
+    static constexpr std::uint32_t Magic = 0x67636c72;  // "gclr"
+    static constexpr std::uint32_t Version = 2;
+
+    static constexpr std::chrono::milliseconds DefaultStallTimeout{1000};
+
+    SharedRing() = delete;
+
+    /**************************************************************
+     * @brief Maps the segment called name, "/gclog" style, creating
+     * and formatting it with geometry if it doesn't exist yet. Of
+     * processes racing to create it exactly one does, the others
+     * wait for it to be formatted and use its geometry.
+     *
+     * @Note: throws std::system_error if the segment can't be made,
+     * opened or mapped, isn't formatted within a second, or its
+     * header doesn't describe a ring that fits in it.
+     *************************************************************/
+    [[maybe_unused]] SharedRing(std::string name, Geometry geometry)
+            : m_name(normalize(std::move(name)))
+    {
+        int fd = ::shm_open(m_name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd >= 0) {
+            create(fd, geometry);
+        } else if (errno == EEXIST) {
+            fd = ::shm_open(m_name.c_str(), O_RDWR | O_CLOEXEC, 0600);
+            if (fd < 0) {
+                fail("can't open");
+            }
+            attach(fd);
+        } else {
+            fail("can't create");
+        }
+        ::close(fd);
+    }
+
+    ~SharedRing() { ::munmap(m_base, m_size); }
+
+    SharedRing(const SharedRing &) = delete;            // non construction-copyable
+    SharedRing(SharedRing &&) = delete;                 // non movable
+    SharedRing &operator=(const SharedRing &) = delete; // non copyable
+    SharedRing &operator=(SharedRing &&) = delete;      // move assignment
+
+    // -------------------------------------------------------------------------
+    // Removes the segment's name, mappings already made stay valid.
+    static void unlink(const std::string &name) { ::shm_unlink(normalize(name).c_str()); }
+
+private:
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free
+                  && std::atomic<std::uint32_t>::is_always_lock_free
+                  && std::atomic<pid_t>::is_always_lock_free,
+                  "the ring's atomics are shared between processes");
+
+    // At the start of the segment.
+    struct Header
+    {
+        std::atomic<std::uint32_t> magic;  // Magic once formatted
+        std::uint32_t version;
+        std::uint64_t cellCount;
+        std::uint64_t cellSize;
+
+        alignas(64) std::atomic<std::uint64_t> enqueuePos;
+        std::atomic<std::uint64_t> dropped;
+        alignas(64) std::atomic<std::uint64_t> dequeuePos;
+    };
+
+    // At the start of every cell, the text follows.
+    struct Cell
+    {
+        std::atomic<std::uint64_t> sequence;
+        std::atomic<pid_t> pid;  // the claimer's, 0 while it is free
+        std::uint32_t length;
+        Logger::LogLevel level;
+    };
+
+    static constexpr std::size_t CellHeaderSize = (sizeof(Cell) + 7U) & ~std::size_t{7U};
+
+    const std::string m_name;
+    void *m_base{nullptr};
+    std::size_t m_size{0};
+    Header *m_header{nullptr};
+    char *m_cells{nullptr};
+    std::uint64_t m_mask{0};
+    std::size_t m_cellSize{0};
+
+    // Consumer side, the cell it has found claimed but unpublished.
+    std::chrono::nanoseconds m_stallTimeout{DefaultStallTimeout};
+    std::uint64_t m_stalledPos{0};
+    std::optional<std::chrono::steady_clock::time_point> m_stalledSince;
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] const std::string &getName() const { return m_name; }
+
+    [[nodiscard]] std::size_t getCellCount() const { return m_mask + 1; }
+
+    // The longest line a cell holds, longer ones are cut.
+    [[nodiscard]] std::size_t getTextCapacity() const { return m_cellSize - CellHeaderSize; }
+
+    // Lines dropped on a full ring by every producer, and cells the
+    // consumer skipped.
+    [[nodiscard]] std::uint64_t getDroppedCount() const {
+        return m_header->dropped.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::chrono::nanoseconds getStallTimeout() const { return m_stallTimeout; }
+
+    // Setters -----------------------------------------------------------------
+    //
+    // How long tryPop() waits on a claimed cell whose producer is still
+    // alive before skipping it. A producer that only stalled and gets
+    // as far as publishing after that loses its line, and if the ring
+    // went all the way round meanwhile its copy may garble the line of
+    // the next cell's producer, so keep it well above any scheduling hiccup.
+    void setStallTimeout(std::chrono::nanoseconds timeout) { m_stallTimeout = timeout; }
+
+    // -------------------------------------------------------------------------
+    // Copies text into a cell, cut to getTextCapacity() and still ending
+    // with a newline if it did. Returns false, and counts the line as
+    // dropped, if the ring is full or the consumer gave up on the cell.
+    bool tryPush(Logger::LogLevel level, std::string_view text)
+    {
+        std::uint64_t pos = m_header->enqueuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        for (;;) {
+            cell = cellAt(pos);
+            const std::uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::int64_t>(seq - pos);
+
+            if (diff == 0) {
+                if (m_header->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                m_header->dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                pos = m_header->enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->pid.store(detail::currentPid(), std::memory_order_relaxed);
+
+        char *out = reinterpret_cast<char *>(cell) + CellHeaderSize;
+        const std::size_t capacity = getTextCapacity();
+        if (text.size() <= capacity) {
+            std::memcpy(out, text.data(), text.size());
+        } else {
+            std::memcpy(out, text.data(), capacity);
+            if (text.back() == '\n') {
+                out[capacity - 1] = '\n';
+            }
+            text = text.substr(0, capacity);
+        }
+        cell->length = static_cast<std::uint32_t>(text.size());
+        cell->level = level;
+
+        // Fails only if the consumer skipped the cell, taking too long.
+        std::uint64_t claimed = pos;
+        return cell->sequence.compare_exchange_strong(claimed, pos + 1, std::memory_order_release,
+                                                      std::memory_order_relaxed);
+    }
+
+    // -------------------------------------------------------------------------
+    // Hands the oldest line to visitor(const Record &) while it still
+    // sits in its cell. Returns false if the ring is empty, or if the
+    // oldest cell is claimed and not published yet. Such a cell is
+    // skipped once its producer is gone or the stall timeout has passed.
+    template<typename Visitor>
+    bool tryPop(Visitor &&visitor)
+    {
+        std::uint64_t pos = m_header->dequeuePos.load(std::memory_order_relaxed);
+        Cell *cell;
+
+        for (;;) {
+            cell = cellAt(pos);
+            const std::uint64_t seq = cell->sequence.load(std::memory_order_acquire);
+            const auto diff = static_cast<std::int64_t>(seq - (pos + 1));
+
+            if (diff == 0) {
+                if (m_header->dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                if (!isAbandoned(pos, *cell)
+                    || !m_header->dequeuePos.compare_exchange_strong(pos, pos + 1, std::memory_order_relaxed)) {
+                    return false;
+                }
+                // Ours now, unless the producer published after all, in
+                // which case its pid is back in the cell whichever of
+                // its store and the exchange came first.
+                const pid_t claimer = cell->pid.exchange(0, std::memory_order_relaxed);
+                std::uint64_t claimed = pos;
+                if (cell->sequence.compare_exchange_strong(claimed, pos + m_mask + 1, std::memory_order_acq_rel,
+                                                           std::memory_order_acquire)) {
+                    m_header->dropped.fetch_add(1, std::memory_order_relaxed);
+                    pos = m_header->dequeuePos.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if (claimer != 0) {
+                    cell->pid.store(claimer, std::memory_order_relaxed);
+                }
+                break;
+            } else {
+                pos = m_header->dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        visitor(Record{cell->level, cell->pid.load(std::memory_order_relaxed),
+                       std::string_view(reinterpret_cast<const char *>(cell) + CellHeaderSize, cell->length)});
+
+        cell->pid.store(0, std::memory_order_relaxed);
+        cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    // -------------------------------------------------------------------------
+    [[noreturn]] void fail(const char *what) const {
+        throw std::system_error(errno, std::generic_category(), std::string("gclog: ") + what + " " + m_name);
+    }
+
+    // -------------------------------------------------------------------------
+    static std::string normalize(std::string name) {
+        return name.empty() || name[0] != '/' ? "/" + name : name;
+    }
+
+    // -------------------------------------------------------------------------
+    Cell *cellAt(std::uint64_t pos) const {
+        return reinterpret_cast<Cell *>(m_cells + (pos & m_mask) * m_cellSize);
+    }
+
+    // -------------------------------------------------------------------------
+    // Whether the unpublished cell at pos was claimed by a producer that
+    // died or has held it past the stall timeout. An unclaimed one is
+    // just the end of the ring.
+    bool isAbandoned(std::uint64_t pos, const Cell &cell) {
+        if (m_header->enqueuePos.load(std::memory_order_acquire) <= pos) {
+            m_stalledSince.reset();
+            return false;
+        }
+
+        // 0 if the producer died before storing it, the timeout catches that.
+        const pid_t pid = cell.pid.load(std::memory_order_relaxed);
+        if (pid != 0 && ::kill(pid, 0) != 0 && errno == ESRCH) {
+            m_stalledSince.reset();
+            return true;
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (!m_stalledSince || m_stalledPos != pos) {
+            m_stalledPos = pos;
+            m_stalledSince = now;
+        }
+        if (now - *m_stalledSince < m_stallTimeout) {
+            return false;
+        }
+        m_stalledSince.reset();
+        return true;
+    }
+
+    // -------------------------------------------------------------------------
+    void map(int fd, std::size_t cellCount, std::size_t cellSize) {
+        m_size = sizeof(Header) + cellCount * cellSize;
+        m_base = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m_base == MAP_FAILED) {
+            m_base = nullptr;
+            fail("can't map");
+        }
+        m_header = static_cast<Header *>(m_base);
+        m_cells = static_cast<char *>(m_base) + sizeof(Header);
+        m_mask = cellCount - 1;
+        m_cellSize = cellSize;
+    }
+
+    // -------------------------------------------------------------------------
+    // Sizes and formats a segment nobody else can have mapped yet, then
+    // publishes it through the magic.
+    void create(int fd, Geometry geometry) {
+        std::size_t cellCount = 2;
+        while (cellCount < geometry.cellCount) {
+            cellCount <<= 1U;
+        }
+        const std::size_t cellSize =
+                (std::max(geometry.cellSize, CellHeaderSize + 64) + 63) & ~std::size_t{63};
+
+        if (::ftruncate(fd, static_cast<off_t>(sizeof(Header) + cellCount * cellSize)) != 0) {
+            const int error = errno;
+            ::shm_unlink(m_name.c_str());
+            errno = error;
+            fail("can't size");
+        }
+        map(fd, cellCount, cellSize);
+
+        auto *header = ::new(m_base) Header{};
+        header->version = Version;
+        header->cellCount = cellCount;
+        header->cellSize = cellSize;
+        for (std::size_t i = 0; i < cellCount; ++i) {
+            ::new(m_cells + i * cellSize) Cell{};
+            cellAt(i)->sequence.store(i, std::memory_order_relaxed);
+        }
+        header->magic.store(Magic, std::memory_order_release);
+    }
+
+    // -------------------------------------------------------------------------
+    // Waits for whoever created the segment to format it.
+    void attach(int fd) {
+        for (int attempt = 0; attempt < 1000; ++attempt) {
+            struct stat status{};
+            if (::fstat(fd, &status) == 0 && static_cast<std::size_t>(status.st_size) >= sizeof(Header)) {
+                const auto size = static_cast<std::size_t>(status.st_size);
+                void *base = ::mmap(nullptr, sizeof(Header), PROT_READ, MAP_SHARED, fd, 0);
+                if (base == MAP_FAILED) {
+                    fail("can't map");
+                }
+                const auto *header = static_cast<const Header *>(base);
+                const bool ready = header->magic.load(std::memory_order_acquire) == Magic;
+                const std::uint32_t version = header->version;
+                const std::uint64_t cellCount = header->cellCount;
+                const std::uint64_t cellSize = header->cellSize;
+                ::munmap(base, sizeof(Header));
+
+                if (ready) {
+                    if (version != Version) {
+                        errno = EPROTO;
+                        fail("incompatible ring in");
+                    }
+                    // The header is whatever is in the segment, it mustn't
+                    // make us map, or index, past the end of it.
+                    if (cellCount < 2 || (cellCount & (cellCount - 1)) != 0
+                        || cellSize < CellHeaderSize || cellSize % alignof(Cell) != 0
+                        || cellCount > (size - sizeof(Header)) / cellSize) {
+                        errno = EINVAL;
+                        fail("malformed ring in");
+                    }
+                    map(fd, static_cast<std::size_t>(cellCount), static_cast<std::size_t>(cellSize));
+                    return;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        errno = ETIMEDOUT;
+        fail("nobody formatted");
+    }
+};
+
+// -----------------------------------------------------------------------------
+// Hands rendered lines to a gclog_collector through a SharedRing, so the
+// process itself does no file I/O: a write is one compare-exchange and a
+// copy into shared memory, no syscall and no lock. Several processes,
+// each with its own sink, share one ring and one collector.
+//
+// Lines longer than a cell are cut, keeping their newline, and lines
+// meeting a full ring (no collector, or one falling behind) are dropped
+// and counted in the ring, where the collector reports them.
+class SharedMemorySink final : public Sink
+{
+public:
+    SharedMemorySink() = delete;
+
+    [[maybe_unused]] explicit SharedMemorySink(std::string name)
+            : SharedMemorySink(std::move(name), SharedRing::Geometry{}) {}
+
+    // geometry only applies if this process is the first to open name,
+    // see SharedRing. Throws std::system_error if it can't be mapped.
+    [[maybe_unused]] SharedMemorySink(std::string name, SharedRing::Geometry geometry)
+            : m_ring(std::move(name), geometry) {}
+
+private:
+    SharedRing m_ring;
+
+public:
+    // Getters -----------------------------------------------------------------
+    [[nodiscard]] SharedRing &getRing() { return m_ring; }
+
+    // -------------------------------------------------------------------------
+    // The ring counts every process's drops, the sink's metrics this
+    // process's.
+    void write(const LogLine &line) override {
+        if (m_ring.tryPush(line.level, line.text)) {
+            m_metrics.countBytes(std::min(line.text.size(), m_ring.getTextCapacity()));
+        } else {
+            m_metrics.countDropped();
+        }
+    }
+};
+
+}//namespace gc
+
+#endif //GCLOG_SHAREDMEMORYSINK_HPP
@@ -0,0 +1,459 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: gclog_bench.cpp                                             //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+// Latency and throughput of the loggers and sinks.
+//
+//   gclog_bench --benchmark_out=results.json --benchmark_out_format=json
+//
+// Latency benchmarks time every call and report p50/p99/p999 in ns as
+// counters next to the mean. Files are written to GCLOG_BENCH_DIR, by
+// default /dev/shm so the numbers leave out the disk.
+
+#include "AsyncLogger.hpp"
+#include "BinaryLogger.hpp"
+#include "Formatters.hpp"
+#include "MappedFileSink.hpp"
+#include "RotatingFileSink.hpp"
+#include "ShardedLogger.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <filesystem>
+
+using namespace gc;
+
+namespace {
+    using Level = Logger::LogLevel;
+
+    constexpr std::size_t MaxLatencySamples = 1U << 22U;
+
+    // -------------------------------------------------------------------------
+    std::filesystem::path scratchFile(const std::string &name)
+    {
+        std::filesystem::path directory = "/dev/shm";
+        if (const char *configured = std::getenv("GCLOG_BENCH_DIR")) {
+            directory = configured;
+        } else if (!std::filesystem::is_directory(directory)) {
+            directory = std::filesystem::temp_directory_path();
+        }
+
+        auto path = directory / ("gclog_bench_" + name + ".log");
+        std::filesystem::remove(path);
+        return path;
+    }
+
+    // -------------------------------------------------------------------------
+    // Removes a scratch file and whatever a rotating sink left next to it.
+    void removeScratch(const std::filesystem::path &path)
+    {
+        const std::string prefix = path.filename().string();
+        std::error_code error;
+        for (const auto &entry : std::filesystem::directory_iterator(path.parent_path(), error)) {
+            if (entry.path().filename().string().rfind(prefix, 0) == 0) {
+                std::filesystem::remove(entry.path(), error);
+            }
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    // Runs body once per iteration, timing each call on its own. The
+    // clock reads add their own few ns to every sample.
+    template<typename Body>
+    void measureLatency(benchmark::State &state, Body &&body)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        std::vector<std::int64_t> samples;
+        samples.reserve(MaxLatencySamples);
+
+        for (auto _ : state) {
+            const auto start = Clock::now();
+            body();
+            const auto end = Clock::now();
+            if (samples.size() < MaxLatencySamples) {
+                samples.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        end - start).count());
+            }
+        }
+
+        if (!samples.empty()) {
+            std::sort(samples.begin(), samples.end());
+            const auto percentile = [&samples](double fraction) {
+                const auto index = static_cast<std::size_t>(
+                        fraction * static_cast<double>(samples.size() - 1));
+                return static_cast<double>(samples[index]);
+            };
+            // Averaged over the threads of a multi-threaded run.
+            state.counters["p50_ns"] = benchmark::Counter(percentile(0.50), benchmark::Counter::kAvgThreads);
+            state.counters["p99_ns"] = benchmark::Counter(percentile(0.99), benchmark::Counter::kAvgThreads);
+            state.counters["p999_ns"] = benchmark::Counter(percentile(0.999), benchmark::Counter::kAvgThreads);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+
+    // -------------------------------------------------------------------------
+    int maxThreads()
+    {
+        return static_cast<int>(std::max(1U, std::thread::hardware_concurrency()));
+    }
+}
+
+// Disabled levels -------------------------------------------------------------
+//
+// What a call below the logger's level costs.
+static void BM_DisabledLevel(benchmark::State &state)
+{
+    SinkLogger log(Level::WARN, {std::make_shared<NullSink>()});
+    int value = 42;
+
+    for (auto _ : state) {
+        log.info("value {}", value);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DisabledLevel);
+
+static void BM_DisabledLevelMacro(benchmark::State &state)
+{
+    SinkLogger log(Level::WARN, {std::make_shared<NullSink>()});
+    int value = 42;
+
+    for (auto _ : state) {
+        GCLOG_INFO(log, "value {}", value);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DisabledLevelMacro);
+
+// Timestamps ------------------------------------------------------------------
+static void BM_TimeFormat(benchmark::State &state)
+{
+    const auto precision = static_cast<Time::Precision>(state.range(0));
+    char buffer[Time::MaxFormattedSize];
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Time::format(buffer, true, true, precision));
+        benchmark::ClobberMemory();
+    }
+}
+BENCHMARK(BM_TimeFormat)
+        ->ArgName("precision")
+        ->DenseRange(static_cast<int>(Time::Precision::SECONDS),
+                     static_cast<int>(Time::Precision::NANOSECONDS));
+
+static void BM_TimeLegacyStrings(benchmark::State &state)
+{
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(Time::getTime());
+        benchmark::DoNotOptimize(Time::getDate());
+    }
+}
+BENCHMARK(BM_TimeLegacyStrings);
+
+// Formatting ------------------------------------------------------------------
+//
+// A whole enabled call with nowhere to write to, the formatting floor.
+static void BM_FormatToNullSink(benchmark::State &state)
+{
+    SinkLogger log(Level::TRACE, {std::make_shared<NullSink>()});
+    measureLatency(state, [&log] { log.info("user {} took {} ms", 42, 3.5); });
+}
+BENCHMARK(BM_FormatToNullSink);
+
+// Fields encoded as text, JSON and logfmt.
+static void BM_FieldsToNullSink(benchmark::State &state)
+{
+    SinkLogger log(Level::TRACE, {std::make_shared<NullSink>()});
+    if (state.range(0) == 1) {
+        log.setFormatter(std::make_unique<JsonFormatter>());
+    } else if (state.range(0) == 2) {
+        log.setFormatter(std::make_unique<LogfmtFormatter>());
+    }
+
+    measureLatency(state, [&log] {
+        log.info("request done", kv("status", 200), kv("ms", 3.2),
+                 kv("path", "/api/v1/users/42/settings?expand=profile"));
+    });
+}
+BENCHMARK(BM_FieldsToNullSink)->ArgName("encoding")->DenseRange(0, 2);
+
+// A record below the level kept by a backtrace, per thread or shared.
+static void BM_BacktraceCapture(benchmark::State &state)
+{
+    SinkLogger log(Level::INFO, {std::make_shared<NullSink>()});
+    Backtrace::BacktracePolicy policy;
+    policy.perThread = state.range(0) != 0;
+    log.enableBacktrace(policy);
+
+    measureLatency(state, [&log] { log.debug("user {} took {} ms", 42, 3.5); });
+}
+BENCHMARK(BM_BacktraceCapture)->ArgName("perThread")->DenseRange(0, 1);
+
+// Suppression -----------------------------------------------------------------
+//
+// What a record refused by a call site's rate limit or collapsed as a
+// repeat costs, across threads since both share atomics.
+static void BM_RateLimitedRefused(benchmark::State &state)
+{
+    static SinkLogger log(Level::TRACE, {std::make_shared<NullSink>()});
+    int value = 42;
+
+    for (auto _ : state) {
+        GCLOG_ERROR_LIMITED(log, 1, "value {}", value);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_RateLimitedRefused)->ThreadRange(1, 8);
+
+static void BM_DeduplicatedRepeat(benchmark::State &state)
+{
+    static SinkLogger &log = [] () -> SinkLogger & {
+        static SinkLogger deduplicating(Level::TRACE, {std::make_shared<NullSink>()});
+        deduplicating.setDeduplicate(true);
+        return deduplicating;
+    }();
+    int value = 42;
+
+    for (auto _ : state) {
+        log.error("value {}", value);
+        benchmark::DoNotOptimize(value);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DeduplicatedRepeat)->ThreadRange(1, 8);
+
+// Sinks -----------------------------------------------------------------------
+namespace {
+    using SinkFactory = std::function<std::shared_ptr<Sink>(const std::string &path)>;
+
+    int openOrThrow(const std::string &path)
+    {
+        const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "can't open " + path);
+        }
+        return fd;
+    }
+
+    // A console sink on path, the descriptor belongs to the benchmark.
+    std::shared_ptr<Sink> consoleSink(const std::string &path, bool terminal)
+    {
+        ConsoleSink::OutputPolicy output;
+        output.fd = openOrThrow(path);
+        output.terminal = terminal;
+
+        return std::shared_ptr<ConsoleSink>(
+                new ConsoleSink(ConsoleSink::ColorizeConsoleOutput::LEVEL_ONLY,
+                                ConsoleColor(FG_LIGHT_BLUE), ConsoleColor(FG_DEFAULT),
+                                ConsoleColor(FG_RED), ConsoleColor(FG_GREEN),
+                                ConsoleColor(FG_YELLOW), output),
+                [](ConsoleSink *console) {
+                    const int fd = console->getOutputPolicy().fd;
+                    delete console;
+                    ::close(fd);
+                });
+    }
+
+    struct SinkCase {
+        std::string name;
+        SinkFactory factory;
+        bool needsRegularFile;  // rotates, renames or maps its file
+    };
+
+    std::vector<SinkCase> sinkCases()
+    {
+        return {
+                {"FileSink", [](const std::string &path) {
+                    return std::make_shared<FileSink>(path);
+                }, false},
+                {"ConsoleSink/terminal", [](const std::string &path) {
+                    return consoleSink(path, true);
+                }, false},
+                {"ConsoleSink/batched", [](const std::string &path) {
+                    return consoleSink(path, false);
+                }, false},
+                {"RotatingFileSink", [](const std::string &path) {
+                    RotatingFileSink::RotationPolicy rotation;
+                    rotation.maxBytes = 64 * 1024 * 1024;
+                    rotation.maxFiles = 1;
+                    return std::make_shared<RotatingFileSink>(path, rotation);
+                }, true},
+                {"MappedFileSink", [](const std::string &path) {
+                    return std::make_shared<MappedFileSink>(path);
+                }, true},
+        };
+    }
+
+    // -------------------------------------------------------------------------
+    // One logger shared by every thread of the run, set up and torn down
+    // by thread 0 outside the timed loop.
+    void sinkLatency(benchmark::State &state, const SinkFactory &factory, const std::string &path)
+    {
+        static std::unique_ptr<SinkLogger> log;
+        if (state.thread_index() == 0) {
+            log = std::make_unique<SinkLogger>(Level::TRACE);
+            log->addSink(factory(path));
+        }
+
+        measureLatency(state, [&state] { log->info("user {} took {} ms", state.thread_index(), 3.5); });
+
+        if (state.thread_index() == 0) {
+            log.reset();
+            if (path != "/dev/null") {
+                removeScratch(path);
+            }
+        }
+    }
+
+    // -------------------------------------------------------------------------
+    void registerSinkBenchmarks()
+    {
+        for (const auto &sinkCase : sinkCases()) {
+            std::vector<std::pair<std::string, std::string>> targets;
+            if (!sinkCase.needsRegularFile) {
+                targets.emplace_back("devnull", "/dev/null");
+            }
+            targets.emplace_back("tmpfs", scratchFile(sinkCase.name.substr(0, sinkCase.name.find('/'))).string());
+
+            for (const auto &[target, path] : targets) {
+                benchmark::RegisterBenchmark(
+                        ("BM_Sink/" + sinkCase.name + "/" + target).c_str(),
+                        [factory = sinkCase.factory, path = path](benchmark::State &state) {
+                            sinkLatency(state, factory, path);
+                        })
+                        ->ThreadRange(1, maxThreads())
+                        ->UseRealTime();
+            }
+        }
+    }
+}
+
+// Loggers ---------------------------------------------------------------------
+//
+// Latency seen by the calling thread of the loggers that hand the work to
+// a thread of their own.
+static void BM_AsyncLogger(benchmark::State &state)
+{
+    static std::unique_ptr<SinkLogger> backend;
+    static std::unique_ptr<AsyncLogger> log;
+    if (state.thread_index() == 0) {
+        backend = std::make_unique<SinkLogger>(Level::TRACE);
+        backend->addSink(std::make_shared<FileSink>("/dev/null"));
+        log = std::make_unique<AsyncLogger>(*backend, 1U << 16U);
+    }
+
+    measureLatency(state, [&state] { log->info("user {} took {} ms", state.thread_index(), 3.5); });
+
+    if (state.thread_index() == 0) {
+        log.reset();
+        backend.reset();
+    }
+}
+BENCHMARK(BM_AsyncLogger)->ThreadRange(1, maxThreads())->UseRealTime();
+
+static void BM_BinaryLogger(benchmark::State &state)
+{
+    static int fd = -1;
+    static std::unique_ptr<BinaryLogger> log;
+    if (state.thread_index() == 0) {
+        fd = ::open("/dev/null", O_WRONLY | O_CLOEXEC);
+        log = std::make_unique<BinaryLogger>(
+                Level::TRACE, fd, static_cast<BinaryLogger::Encoding>(state.range(0)));
+    }
+
+    measureLatency(state, [&state] {
+        GCLOG_BINARY_INFO(*log, "user {} took {} ms", state.thread_index(), 3.5);
+    });
+
+    if (state.thread_index() == 0) {
+        log.reset();
+        ::close(fd);
+    }
+}
+BENCHMARK(BM_BinaryLogger)
+        ->ArgName("binary")
+        ->Arg(static_cast<int>(BinaryLogger::Encoding::TEXT))
+        ->Arg(static_cast<int>(BinaryLogger::Encoding::BINARY))
+        ->ThreadRange(1, maxThreads())
+        ->UseRealTime();
+
+// Producer throughput as threads are added, one shared queue against a
+// ring per thread. Records the writer can't keep up with are dropped
+// rather than waited for, so the curve is the producers' own, "dropped"
+// says how much of it the writer wrote. Run with
+// --benchmark_filter=BM_QueueScaling on the machine being sized.
+static void BM_QueueScaling(benchmark::State &state)
+{
+    static std::unique_ptr<SinkLogger> backend;
+    static std::unique_ptr<Logger> log;
+    if (state.thread_index() == 0) {
+        backend = std::make_unique<SinkLogger>(Level::TRACE);
+        backend->addSink(std::make_shared<NullSink>());
+        if (state.range(0) == 0) {
+            log = std::make_unique<AsyncLogger>(*backend, 1U << 16U, AsyncLogger::OverflowPolicy::DROP_NEWEST);
+        } else {
+            log = std::make_unique<ShardedLogger>(*backend, ShardedLogger::DefaultShardSize,
+                                                  ShardedLogger::DefaultSkewWindow,
+                                                  ShardedLogger::OverflowPolicy::DROP_NEWEST);
+        }
+    }
+
+    for (auto _ : state) {
+        log->info("user {} took {} ms", state.thread_index(), 3.5);
+    }
+    state.SetItemsProcessed(state.iterations());
+
+    if (state.thread_index() == 0) {
+        std::uint64_t dropped = 0;
+        if (const auto *async = dynamic_cast<const AsyncLogger *>(log.get())) {
+            dropped = async->getDroppedCount();
+        } else {
+            dropped = static_cast<const ShardedLogger &>(*log).getDroppedCount();
+        }
+        state.counters["dropped"] = benchmark::Counter(static_cast<double>(dropped),
+                                                       benchmark::Counter::kAvgIterations);
+        log.reset();
+        backend.reset();
+    }
+}
+BENCHMARK(BM_QueueScaling)
+        ->ArgName("sharded")
+        ->DenseRange(0, 1)
+        ->ThreadRange(1, 64)
+        ->UseRealTime();
+
+// -----------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    registerSinkBenchmarks();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
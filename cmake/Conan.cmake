@@ -18,6 +18,7 @@ macro(run_conan)
           REQUIRES
           ${CONAN_EXTRA_REQUIRES}
           catch2/2.11.0
+          fmt/9.1.0
           OPTIONS
           ${CONAN_EXTRA_OPTIONS}
           BASIC_SETUP
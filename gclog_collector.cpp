@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: gclog_collector.cpp                                         //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+// Drains the shared memory ring SharedMemorySinks write to and appends the
+// lines to a rotating file, so worker processes do no file I/O of their own.
+//
+//   gclog_collector [-c cells] [-s cell-bytes] [-r rotate-bytes] [-k keep]
+//                   [-u] name file
+//
+// -c and -s size the ring if the collector is the first to open it, -u
+// removes it on exit. Runs until SIGINT or SIGTERM, then writes out what
+// is left in the ring.
+//
+// Lines come out in the order their producers claimed cells in the ring,
+// which is not necessarily the order of the times on them: a process can
+// be descheduled between rendering a line and claiming its cell, so
+// another process's later line may come first. Lines from any one thread
+// keep their order. Sort on the timestamps downstream if that matters.
+
+#include "RotatingFileSink.hpp"
+#include "SharedMemorySink.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace gc;
+
+namespace {
+    std::atomic<bool> stopRequested{false};
+
+    void requestStop([[maybe_unused]] int signal) { stopRequested.store(true); }
+
+    int usage()
+    {
+        std::fputs("usage: gclog_collector [-c cells] [-s cell-bytes] [-r rotate-bytes] "
+                   "[-k keep] [-u] name file\n", stderr);
+        return 2;
+    }
+
+    // -------------------------------------------------------------------------
+    std::optional<std::size_t> parseSize(std::string_view text)
+    {
+        std::size_t value = 0;
+        for (const char c : text) {
+            if (c < '0' || c > '9') {
+                return std::nullopt;
+            }
+            value = value * 10 + static_cast<std::size_t>(c - '0');
+        }
+        return text.empty() ? std::nullopt : std::optional<std::size_t>(value);
+    }
+
+    // -------------------------------------------------------------------------
+    // Writes what is in the ring to sink, returns how many lines it was.
+    std::size_t drain(SharedRing &ring, Sink &sink)
+    {
+        std::size_t count = 0;
+        while (ring.tryPop([&sink](const SharedRing::Record &record) {
+            const std::size_t bodySize = record.text.empty() || record.text.back() != '\n'
+                                         ? record.text.size() : record.text.size() - 1;
+            sink.write(LogLine{record.level, record.text, 0, bodySize});
+        })) {
+            ++count;
+        }
+        return count;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    SharedRing::Geometry geometry;
+    RotatingFileSink::RotationPolicy rotation;
+    bool unlinkOnExit = false;
+    std::vector<std::string> operands;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if ((arg == "-c" || arg == "-s" || arg == "-r" || arg == "-k") && i + 1 < argc) {
+            const auto value = parseSize(argv[++i]);
+            if (!value) {
+                return usage();
+            }
+            if (arg == "-c") {
+                geometry.cellCount = *value;
+            } else if (arg == "-s") {
+                geometry.cellSize = *value;
+            } else if (arg == "-r") {
+                rotation.maxBytes = *value;
+            } else {
+                rotation.maxFiles = *value;
+            }
+        } else if (arg == "-u") {
+            unlinkOnExit = true;
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage();
+        } else {
+            operands.emplace_back(arg);
+        }
+    }
+
+    if (operands.size() != 2) {
+        return usage();
+    }
+
+    struct sigaction action{};
+    action.sa_handler = &requestStop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    try {
+        SharedRing ring(operands[0], geometry);
+
+        FileSink::FlushPolicy flush;
+        flush.everyInterval = std::chrono::milliseconds(200);
+        RotatingFileSink sink(operands[1], rotation, FileSink::DefaultBufferSize, flush);
+
+        std::uint64_t dropped = ring.getDroppedCount();
+        fmt::memory_buffer notice;
+
+        while (!stopRequested.load()) {
+            const std::size_t count = drain(ring, sink);
+
+            // Producers never wait, so this is the only place their
+            // losses show up.
+            if (const std::uint64_t now = ring.getDroppedCount(); now != dropped) {
+                notice.clear();
+                fmt::format_to(std::back_inserter(notice),
+                               "[WARN]: gclog_collector: {} lines dropped, the ring was full "
+                               "or their producer died writing them\n", now - dropped);
+                sink.write(LogLine{Logger::LogLevel::WARN, {notice.data(), notice.size()}, 8, notice.size() - 1});
+                dropped = now;
+            }
+
+            if (count == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+
+        drain(ring, sink);
+        sink.flush();
+    } catch (const std::system_error &error) {
+        std::fprintf(stderr, "gclog_collector: %s\n", error.what());
+        return 1;
+    }
+
+    if (unlinkOnExit) {
+        SharedRing::unlink(operands[0]);
+    }
+    return 0;
+}
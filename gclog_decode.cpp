@@ -0,0 +1,108 @@
+////////////////////////////////////////////////////////////////////////////////
+//      Filename: gclog_decode.cpp                                            //
+//                                                                            //
+//      Gclog: A Minimal, Header only, Modern C++ Logger.                     //
+//      https://github.com/Cheeseborgers/gclog                                //
+//      Created by Goodecheeseburgers on 28/07/2020.                          //
+//                                                                            //
+//      This program is free software: you can redistribute it and/or modify  //
+//      it under the terms of the GNU General Public License as published by  //
+//      the Free Software Foundation, either version 3 of the License, or     //
+//      (at your option) any later version.                                   //
+//                                                                            //
+//      This program is distributed in the hope that it will be useful,       //
+//      but WITHOUT ANY WARRANTY; without even the implied warranty of        //
+//      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         //
+//      GNU General Public License for more details.                          //
+//                                                                            //
+//      You should have received a copy of the GNU General Public License     //
+//      along with this program.  If not, see <https://www.gnu.org/licenses/>.//
+////////////////////////////////////////////////////////////////////////////////
+
+// Turns binary logs written by gc::BinaryLogger back into text lines.
+//
+//   gclog_decode [-t none|time|date|datetime] [-p s|ms|us|ns] file...
+
+#include "BinaryLogger.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+using namespace gc;
+
+namespace {
+    int usage()
+    {
+        std::fputs("usage: gclog_decode [-t none|time|date|datetime] "
+                   "[-p s|ms|us|ns] file...\n", stderr);
+        return 2;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Logger format(Logger::LogLevel::TRACE);
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if ((arg == "-t" || arg == "-p") && i + 1 < argc) {
+            const std::string_view value(argv[++i]);
+            if (arg == "-t" && value == "none") {
+                format.setAppendDateTime(Logger::AppendDateTimeFormat::NONE);
+            } else if (arg == "-t" && value == "time") {
+                format.setAppendDateTime(Logger::AppendDateTimeFormat::TIME_ONLY);
+            } else if (arg == "-t" && value == "date") {
+                format.setAppendDateTime(Logger::AppendDateTimeFormat::DATE_ONLY);
+            } else if (arg == "-t" && value == "datetime") {
+                format.setAppendDateTime(Logger::AppendDateTimeFormat::DATE_TIME);
+            } else if (arg == "-p" && value == "s") {
+                format.setTimePrecision(Time::Precision::SECONDS);
+            } else if (arg == "-p" && value == "ms") {
+                format.setTimePrecision(Time::Precision::MILLISECONDS);
+            } else if (arg == "-p" && value == "us") {
+                format.setTimePrecision(Time::Precision::MICROSECONDS);
+            } else if (arg == "-p" && value == "ns") {
+                format.setTimePrecision(Time::Precision::NANOSECONDS);
+            } else {
+                return usage();
+            }
+        } else if (!arg.empty() && arg[0] == '-') {
+            return usage();
+        } else {
+            files.emplace_back(arg);
+        }
+    }
+
+    if (files.empty()) {
+        return usage();
+    }
+
+    int status = 0;
+    fmt::memory_buffer line;
+
+    for (const auto &file : files) {
+        std::ifstream in(file, std::ios::binary);
+        if (!in) {
+            std::fprintf(stderr, "gclog_decode: can't open %s\n", file.c_str());
+            status = 1;
+            continue;
+        }
+
+        const bool complete = binlog::readFile(in, [&](const binlog::CallSite &site,
+                                                       const timespec &time,
+                                                       std::string_view payload) {
+            line.clear();
+            binlog::appendLine(line, format, site, time, payload);
+            std::fwrite(line.data(), 1, line.size(), stdout);
+        });
+
+        if (!complete) {
+            std::fprintf(stderr, "gclog_decode: %s is truncated or not a binary log\n",
+                         file.c_str());
+            status = 1;
+        }
+    }
+
+    return status;
+}
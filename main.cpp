@@ -27,8 +27,8 @@ using namespace gc;
 
 int main()
 {
-    ConsoleLogger log(Logger::LogLevel::ERROR);
-    FileLogger fileLogger(Logger::LogLevel::ERROR,
+    ConsoleLogger log(Logger::LogLevel::TRACE);
+    FileLogger fileLogger(Logger::LogLevel::TRACE,
                           "test.log");
 
     log.setConsoleColourStyle(
@@ -0,0 +1,99 @@
+#include <catch2/catch.hpp>
+
+#include "AsyncLogger.hpp"
+
+#include <cstdlib>
+#include <new>
+
+// Every allocation in this executable goes through here and is counted,
+// which is why these tests have a binary of their own.
+namespace {
+    std::atomic<std::size_t> allocations{0};
+}
+
+void *operator new(std::size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void *memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept { std::free(memory); }
+
+void operator delete(void *memory, [[maybe_unused]] std::size_t size) noexcept { std::free(memory); }
+
+namespace {
+    // Counts the bytes it is given, without allocating.
+    class CountingSink final : public gc::Sink
+    {
+    public:
+        void write(const gc::LogLine &line) override {
+            bytes.fetch_add(line.text.size(), std::memory_order_relaxed);
+        }
+
+        std::atomic<std::size_t> bytes{0};
+    };
+
+    // How many allocations running body took.
+    template<typename Body>
+    std::size_t countAllocations(Body &&body)
+    {
+        const std::size_t before = allocations.load();
+        body();
+        return allocations.load() - before;
+    }
+}
+
+// -----------------------------------------------------------------------------
+TEST_CASE("Steady state synchronous logging does not allocate", "[allocation]")
+{
+    auto sink = std::make_shared<CountingSink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {sink});
+    log.setTimePrecision(gc::Time::Precision::MICROSECONDS);
+    const std::string message(300, 'm');
+
+    const auto round = [&] {
+        for (int i = 0; i < 100; ++i) {
+            log.info("user {} took {} ms", i, 3.5);
+            log.warn("request done", gc::kv("status", 200), gc::kv("path", "/api"));
+            log.error(message);
+        }
+    };
+
+    round();
+    REQUIRE(countAllocations(round) == 0);
+    REQUIRE(sink->bytes.load() != 0);
+}
+
+TEST_CASE("Steady state asynchronous logging does not allocate", "[allocation]")
+{
+    auto sink = std::make_shared<CountingSink>();
+    gc::SinkLogger backend(gc::Logger::LogLevel::TRACE, {sink});
+    gc::AsyncLogger log(backend, 16);
+
+    const std::string shortMessage(40, 's');
+    const std::string longMessage(3000, 'l');
+    const std::string hugeMessage(100000, 'h');
+
+    const auto round = [&] {
+        for (int i = 0; i < 50; ++i) {
+            log.info("user {} took {} ms", i, 3.5);
+            log.debug(shortMessage);
+            log.warn(longMessage);
+            log.error("{} {}", i, std::string_view(hugeMessage));
+        }
+        log.flush();
+    };
+
+    // The arenas grow until they have seen the most blocks ever in flight
+    // at once, which depends on how the writer thread gets scheduled.
+    // Warm up until that peak has held for a while.
+    int cleanRounds = 0;
+    for (int warmUp = 0; warmUp < 200 && cleanRounds < 5; ++warmUp) {
+        cleanRounds = countAllocations(round) == 0 ? cleanRounds + 1 : 0;
+    }
+    REQUIRE(countAllocations(round) == 0);
+    REQUIRE(log.getDroppedCount() == 0);
+}
@@ -15,3 +15,67 @@ STATIC_REQUIRE(Factorial(3)
 STATIC_REQUIRE(Factorial(10)
 == 3628800);
 }
+
+// Strip everything below WARN from this translation unit.
+#undef GCLOG_MIN_LEVEL
+#define GCLOG_MIN_LEVEL GCLOG_LEVEL_WARN
+#include "Logger.hpp"
+
+TEST_CASE("GCLOG_MIN_LEVEL strips lower levels at compile time", "[levels]")
+{
+    using LogLevel = gc::Logger::LogLevel;
+    STATIC_REQUIRE_FALSE(gc::Logger::isCompiledIn(LogLevel::TRACE));
+    STATIC_REQUIRE_FALSE(gc::Logger::isCompiledIn(LogLevel::DEBUG));
+    STATIC_REQUIRE_FALSE(gc::Logger::isCompiledIn(LogLevel::INFO));
+    STATIC_REQUIRE(gc::Logger::isCompiledIn(LogLevel::WARN));
+    STATIC_REQUIRE(gc::Logger::isCompiledIn(LogLevel::ERROR));
+}
+
+TEST_CASE("Console escapes and level prefixes are built at compile time", "[format]")
+{
+    using gc::ConsoleColor;
+    using Style = gc::ConsoleSink::ColorizeConsoleOutput;
+    using LogLevel = gc::Logger::LogLevel;
+
+    STATIC_REQUIRE(gc::detail::ColorEscapes[gc::FG_RED].view() == "\033[31m");
+    STATIC_REQUIRE(gc::detail::ColorEscapes[gc::BG_LIGHT_CYAN].view() == "\033[106m");
+    STATIC_REQUIRE(gc::detail::ColorEscapes[gc::BG_DARK_GRAY].view() == "\033[100m");
+    STATIC_REQUIRE(gc::detail::ColorEscapes[gc::FG_ORANGE].view() == "\033[38;5;166m");
+    STATIC_REQUIRE(gc::detail::ColorEscapes[gc::BG_ORANGE].view() == "\033[48;5;214m");
+    STATIC_REQUIRE([] {
+        for (const auto &escape : gc::detail::ColorEscapes) {
+            const std::string_view view = escape.view();
+            if (!view.starts_with("\033[") || !view.ends_with('m')) {
+                return false;
+            }
+        }
+        return true;
+    }());
+
+    STATIC_REQUIRE(ConsoleColor::palette(208, true).getEscape() == "\033[48;5;208m");
+    STATIC_REQUIRE(ConsoleColor::rgb(255, 128, 0).getEscape() == "\033[38;2;255;128;0m");
+    STATIC_REQUIRE(ConsoleColor::rgb(255, 255, 255, true).getEscape() == "\033[48;2;255;255;255m");
+
+    constexpr ConsoleColor green(gc::FG_GREEN);
+    STATIC_REQUIRE(gc::ConsoleSink::makeLevelPrefix(green, LogLevel::WARN, Style::NO_COLOR).view()
+                   == "[WARN]: ");
+    STATIC_REQUIRE(gc::ConsoleSink::makeLevelPrefix(green, LogLevel::WARN, Style::LEVEL_ONLY).view()
+                   == "\033[32m[WARN]: \033[39m");
+    STATIC_REQUIRE(gc::ConsoleSink::makeLevelPrefix(green, LogLevel::TRACE, Style::ALL).view()
+                   == "\033[32m[TRACE]: ");
+}
+
+#include "RotatingFileSink.hpp"
+
+TEST_CASE("The LZ4 frame header checksum is xxHash32", "[lz4]")
+{
+    constexpr unsigned char abc[] = {'a', 'b', 'c'};
+    STATIC_REQUIRE(gc::detail::lz4::shortHash(abc, 0) == 0x02CC5D05U);
+    STATIC_REQUIRE(gc::detail::lz4::shortHash(abc, 1) == 0x550D7456U);
+    STATIC_REQUIRE(gc::detail::lz4::shortHash(abc, 3) == 0x32D153FFU);
+
+    // A descriptor with a content size, two 4 byte lanes and a tail,
+    // checked against the stock lz4 tool.
+    constexpr unsigned char descriptor[] = {0x68, 0x40, 5, 0, 0, 0, 0, 0, 0, 0};
+    STATIC_REQUIRE(gc::detail::lz4::shortHash(descriptor, sizeof(descriptor)) == 0x5E7561B7U);
+}
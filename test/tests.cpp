@@ -15,3 +15,2238 @@ REQUIRE(Factorial(3)
 REQUIRE(Factorial(10)
 == 3628800);
 }
+
+// -----------------------------------------------------------------------------
+#include "AsyncLogger.hpp"
+#include "CategoryLogger.hpp"
+#include "Registry.hpp"
+
+#include <vector>
+
+namespace {
+    // Backend that just remembers what it was asked to write.
+    class CapturingLogger final : public gc::Logger
+    {
+    public:
+        CapturingLogger() : Logger(LogLevel::TRACE) {}
+
+        std::vector<std::pair<LogLevel, std::string>> lines;
+        int flushes{0};
+
+        void log(LogLevel level, const std::string &message) override { lines.emplace_back(level, message); }
+        void flush() override { ++flushes; }
+    };
+}
+
+TEST_CASE("AsyncLogger delivers every record on flush", "[async]")
+{
+    CapturingLogger backend;
+    gc::AsyncLogger log(backend, 64);
+
+    constexpr int threads = 4;
+    constexpr int perThread = 1000;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t) {
+        producers.emplace_back([&log] {
+            for (int i = 0; i < perThread; ++i) {
+                log.info("message " + std::to_string(i));
+            }
+        });
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    log.error("last");
+    log.flush();
+
+    REQUIRE(backend.lines.size() == threads * perThread + 1);
+    REQUIRE(backend.lines.back().first == gc::Logger::LogLevel::ERROR);
+    REQUIRE(backend.lines.back().second == "last");
+    REQUIRE(backend.flushes >= 1);
+    REQUIRE(log.getDroppedCount() == 0);
+}
+
+TEST_CASE("AsyncLogger spills long messages into its arenas", "[async]")
+{
+    CapturingLogger backend;
+    gc::AsyncLogger log(backend, 4);
+
+    for (int round = 0; round < 3; ++round) {
+        log.warn(std::string(1000, 'x'));
+        log.info("{}", std::string(100000, 'y'));
+        log.error(std::string(gc::AsyncRecordQueue::MessageCapacity, 'z'));
+    }
+    log.flush();
+
+    REQUIRE(backend.lines.size() == 9);
+    REQUIRE(backend.lines[6].second == std::string(1000, 'x'));
+    REQUIRE(backend.lines[7].second == std::string(100000, 'y'));
+    REQUIRE(backend.lines[8].second.size() == gc::AsyncRecordQueue::MessageCapacity);
+}
+
+namespace {
+    struct Unprintable {};
+}
+
+template<>
+struct fmt::formatter<Unprintable> : fmt::formatter<std::string_view>
+{
+    auto format(const Unprintable &, fmt::format_context &ctx) const -> decltype(ctx.out())
+    {
+        throw std::runtime_error("can't print this");
+    }
+};
+
+TEST_CASE("An AsyncLogger formatter that throws holds up no other record", "[async]")
+{
+    CapturingLogger backend;
+    gc::AsyncLogger log(backend, 4);
+
+    log.info("before");
+    REQUIRE_THROWS_AS(log.info("{}", Unprintable{}), std::runtime_error);
+    for (int i = 0; i < 8; ++i) {
+        log.info("after {}", i);
+    }
+    log.flush();
+
+    REQUIRE(backend.lines.size() == 9);
+    REQUIRE(backend.lines.front().second == "before");
+    REQUIRE(backend.lines.back().second == "after 7");
+}
+
+TEST_CASE("AsyncLogger BLOCK producers wait for a slow backend", "[async]")
+{
+    // Slow enough that the producers run out of yields and sleep.
+    class SlowLogger final : public gc::Logger
+    {
+    public:
+        SlowLogger() : Logger(LogLevel::TRACE) {}
+
+        std::atomic<int> count{0};
+
+        void log([[maybe_unused]] LogLevel level, [[maybe_unused]] const std::string &message) override {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            ++count;
+        }
+    };
+
+    SlowLogger backend;
+    gc::AsyncLogger log(backend, 2);
+
+    std::vector<std::thread> producers;
+    for (int t = 0; t < 3; ++t) {
+        producers.emplace_back([&log] {
+            for (int i = 0; i < 50; ++i) {
+                log.info("record {}", i);
+            }
+        });
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    log.flush();
+
+    REQUIRE(backend.count == 150);
+    REQUIRE(log.getDroppedCount() == 0);
+    REQUIRE(log.getMetrics().blockedNanoseconds > 0);
+}
+
+TEST_CASE("AsyncLogger stamps lines with the time they were logged", "[async]")
+{
+    // Holds the writer thread on its first record until released.
+    class StampingLogger final : public gc::Logger
+    {
+    public:
+        StampingLogger() : Logger(LogLevel::TRACE, AppendDateTimeFormat::TIME_ONLY) {
+            setTimePrecision(gc::Time::Precision::NANOSECONDS);
+        }
+
+        std::mutex mutex;
+        std::condition_variable released;
+        bool release{false};
+        std::vector<std::string> stamps;
+
+        void log([[maybe_unused]] LogLevel level, [[maybe_unused]] const std::string &message) override {
+            std::unique_lock<std::mutex> guard(mutex);
+            released.wait(guard, [this] { return release; });
+            char stamp[gc::Time::MaxFormattedSize];
+            stamps.emplace_back(stamp, writeDateTime(stamp));
+        }
+    };
+
+    auto timeNow = [](const gc::Logger &logger) {
+        timespec now{};
+        ::clock_gettime(CLOCK_REALTIME, &now);
+        char stamp[gc::Time::MaxFormattedSize];
+        return std::string(stamp, logger.writeDateTime(stamp, now));
+    };
+
+    StampingLogger backend;
+    gc::AsyncLogger log(backend);
+    log.info("held");
+
+    const std::string before = timeNow(backend);
+    log.info("queued");
+    const std::string after = timeNow(backend);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    {
+        std::lock_guard<std::mutex> guard(backend.mutex);
+        backend.release = true;
+    }
+    backend.released.notify_all();
+    log.flush();
+    const std::string written = timeNow(backend);
+
+    // Fixed width " HH:MM:SS.nnnnnnnnn", in order as strings.
+    REQUIRE(backend.stamps.size() == 2);
+    REQUIRE(backend.stamps[1] >= before);
+    REQUIRE(backend.stamps[1] <= after);
+    REQUIRE(after < written);
+}
+
+TEST_CASE("An idle AsyncLogger writer wakes up for the next record", "[async]")
+{
+    class CountingLogger final : public gc::Logger
+    {
+    public:
+        CountingLogger() : Logger(LogLevel::TRACE) {}
+
+        std::atomic<int> count{0};
+
+        void log([[maybe_unused]] LogLevel level, [[maybe_unused]] const std::string &message) override { ++count; }
+    };
+
+    CountingLogger backend;
+    gc::AsyncLogger log(backend);
+
+    // No flush, only the push itself can wake the writer.
+    auto waitFor = [&backend](int count) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (backend.count < count && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return backend.count == count;
+    };
+    for (int i = 1; i <= 20; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        log.info("record {}", i);
+        REQUIRE(waitFor(i));
+    }
+}
+
+TEST_CASE("AsyncLogger DROP_OLDEST keeps the newest records", "[async]")
+{
+    gc::AsyncRecordQueue queue(4);
+    for (int i = 0; i < 4; ++i) {
+        REQUIRE(queue.tryPush(gc::Logger::LogLevel::INFO, std::to_string(i)));
+    }
+    REQUIRE_FALSE(queue.tryPush(gc::Logger::LogLevel::INFO, "full"));
+
+    std::string oldest;
+    REQUIRE(queue.tryPop([&](const gc::AsyncRecordQueue::Record &record) {
+        oldest.assign(record.text, record.length);
+    }));
+    REQUIRE(oldest == "0");
+
+    CapturingLogger backend;
+    {
+        gc::AsyncLogger log(backend, 2, gc::AsyncLogger::OverflowPolicy::DROP_OLDEST);
+        for (int i = 0; i < 10000; ++i) {
+            log.debug(std::to_string(i));
+        }
+        log.flush();
+        REQUIRE(backend.lines.size() + log.getDroppedCount() == 10000);
+        REQUIRE(backend.lines.back().second == "9999");
+    }
+}
+
+TEST_CASE("AsyncLogger shutdown drains and falls back to the caller", "[async]")
+{
+    CapturingLogger backend;
+    gc::AsyncLogger log(backend, 16, gc::AsyncLogger::OverflowPolicy::DROP_NEWEST);
+
+    log.trace("queued");
+    log.shutdown();
+    REQUIRE(backend.lines.size() == 1);
+
+    log.info("direct");
+    REQUIRE(backend.lines.size() == 2);
+    REQUIRE(backend.lines[1].second == "direct");
+}
+
+// -----------------------------------------------------------------------------
+#include <filesystem>
+#include <fstream>
+
+namespace {
+    std::string readFile(const std::filesystem::path &path)
+    {
+        std::ifstream file(path);
+        std::ostringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+    std::filesystem::path tempLogPath(const std::string &name)
+    {
+        auto path = std::filesystem::temp_directory_path() / ("gclog_" + name + ".log");
+        std::filesystem::remove(path);
+        return path;
+    }
+}
+
+TEST_CASE("FileLogger buffers lines until a flush policy fires", "[file]")
+{
+    const auto path = tempLogPath("buffered");
+    gc::FileLogger::FlushPolicy policy;
+    policy.atLevel = gc::Logger::LogLevel::ERROR;
+
+    {
+        gc::FileLogger log(gc::Logger::LogLevel::TRACE, path.string(), 4096, policy);
+        log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+        log.info("one");
+        log.warn("two");
+        REQUIRE(readFile(path).empty());
+
+        log.error("three");
+        REQUIRE(readFile(path) == "[INFO]: one\n[WARN]: two\n[ERROR]: three\n");
+
+        log.debug("four");
+    }
+
+    // Flushed on shutdown.
+    REQUIRE(readFile(path) == "[INFO]: one\n[WARN]: two\n[ERROR]: three\n[DEBUG]: four\n");
+}
+
+TEST_CASE("FileLogger writes lines larger than its buffer", "[file]")
+{
+    const auto path = tempLogPath("large");
+    gc::FileLogger::FlushPolicy policy;
+    policy.atLevel.reset();
+    policy.everyRecords = 2;
+
+    const std::string large(100, 'x');
+    {
+        gc::FileLogger log(gc::Logger::LogLevel::TRACE, path.string(), 16, policy);
+        log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+        log.info("a");
+        log.info(large);
+        REQUIRE(readFile(path) == "[INFO]: a\n[INFO]: " + large + "\n");
+
+        log.info("b");
+        log.info("c");
+        REQUIRE(readFile(path).size() == 10 + 9 + large.size() + 2 * 10);
+    }
+}
+
+TEST_CASE("FileLogger appends to an existing file", "[file]")
+{
+    const auto path = tempLogPath("append");
+    {
+        gc::FileLogger first(gc::Logger::LogLevel::TRACE, path.string());
+        gc::FileLogger second(gc::Logger::LogLevel::TRACE, path.string());
+        first.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+        second.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+        first.info("first");
+        first.flush();
+        second.info("second");
+        second.flush();
+        first.info("third");
+    }
+    REQUIRE(readFile(path) == "[INFO]: first\n[INFO]: second\n[INFO]: third\n");
+}
+
+TEST_CASE("FileLogger reports files it can't open", "[file]")
+{
+    REQUIRE_THROWS_AS(gc::FileLogger(gc::Logger::LogLevel::INFO, "/nonexistent/dir/gclog.log"),
+                      std::system_error);
+}
+
+// -----------------------------------------------------------------------------
+namespace {
+    bool isDigits(std::string_view text)
+    {
+        return std::all_of(text.begin(), text.end(), [](char c) { return c >= '0' && c <= '9'; });
+    }
+}
+
+TEST_CASE("Time::format writes fixed width, zero padded fields", "[time]")
+{
+    char buffer[gc::Time::MaxFormattedSize];
+
+    const std::string_view both(buffer, gc::Time::format(buffer, true, true));
+    REQUIRE(both.size() == 20);
+    REQUIRE(both[0] == ' ');
+    REQUIRE(isDigits(both.substr(1, 2)));
+    REQUIRE(both[3] == ':');
+    REQUIRE(isDigits(both.substr(4, 2)));
+    REQUIRE(both[6] == ':');
+    REQUIRE(isDigits(both.substr(7, 2)));
+    REQUIRE(both[9] == ' ');
+    REQUIRE(isDigits(both.substr(10, 2)));
+    REQUIRE(both[12] == '/');
+    REQUIRE(isDigits(both.substr(13, 2)));
+    REQUIRE(both[15] == '/');
+    REQUIRE(isDigits(both.substr(16, 4)));
+
+    REQUIRE(gc::Time::format(buffer, false, true) == 11);
+    REQUIRE(gc::Time::format(buffer, false, false) == 0);
+
+    using Precision = gc::Time::Precision;
+    REQUIRE(gc::Time::format(buffer, true, false, Precision::SECONDS) == 9);
+    REQUIRE(gc::Time::format(buffer, true, false, Precision::MILLISECONDS) == 13);
+    REQUIRE(gc::Time::format(buffer, true, false, Precision::MICROSECONDS) == 16);
+    REQUIRE(gc::Time::format(buffer, true, true, Precision::NANOSECONDS) == gc::Time::MaxFormattedSize - 2);
+    REQUIRE(buffer[9] == '.');
+    REQUIRE(isDigits(std::string_view(buffer + 10, 9)));
+}
+
+TEST_CASE("Logger date time suffix follows its settings", "[time]")
+{
+    gc::Logger log(gc::Logger::LogLevel::INFO, gc::Logger::AppendDateTimeFormat::TIME_ONLY);
+    REQUIRE(log.getDateTimeString().size() == 9);
+
+    log.setTimePrecision(gc::Time::Precision::MILLISECONDS);
+    REQUIRE(log.getDateTimeString().size() == 13);
+
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+    REQUIRE(log.getDateTimeString().empty());
+}
+
+TEST_CASE("Timestamp formatting cost", "[.][time][!benchmark]")
+{
+    BENCHMARK("legacy Time::getTime + Time::getDate")
+    {
+        return gc::Time::getTime() + gc::Time::getDate();
+    };
+
+    char buffer[gc::Time::MaxFormattedSize];
+    BENCHMARK("Time::format seconds")
+    {
+        return gc::Time::format(buffer, true, true);
+    };
+
+    BENCHMARK("Time::format milliseconds")
+    {
+        return gc::Time::format(buffer, true, true, gc::Time::Precision::MILLISECONDS);
+    };
+
+    BENCHMARK("Time::format nanoseconds")
+    {
+        return gc::Time::format(buffer, true, true, gc::Time::Precision::NANOSECONDS);
+    };
+
+    gc::Logger log(gc::Logger::LogLevel::INFO);
+    BENCHMARK("Logger::getDateTimeString")
+    {
+        return log.getDateTimeString();
+    };
+}
+
+// -----------------------------------------------------------------------------
+TEST_CASE("Logging macros only build messages for enabled levels", "[macros]")
+{
+    CapturingLogger log;
+    int built = 0;
+    auto message = [&built] {
+        ++built;
+        return std::string("built");
+    };
+
+    log.setLevel(gc::Logger::LogLevel::ERROR);
+    GCLOG_TRACE(log, message());
+    GCLOG_DEBUG(log, message());
+    GCLOG_INFO(log, message());
+    GCLOG_WARN(log, message());
+    GCLOG_ERROR(log, message());
+
+    REQUIRE(built == 1);
+    REQUIRE(log.lines.size() == 1);
+    REQUIRE(log.lines[0].first == gc::Logger::LogLevel::ERROR);
+
+    log.setLevel(gc::Logger::LogLevel::WARN);
+    GCLOG_WARN(log, message());
+    REQUIRE(built == 2);
+    REQUIRE(log.lines.size() == 2);
+}
+
+TEST_CASE("Every overload ends up in Logger::log", "[macros]")
+{
+    CapturingLogger log;
+    log.log(gc::Logger::LogLevel::WARN, "warned");
+    log.debug("debugged");
+    log.error("{} {}", "formatted", 1);
+    log.info("fields", gc::kv("key", 2));
+
+    REQUIRE(log.lines.size() == 4);
+    REQUIRE(log.lines[0] == std::pair(gc::Logger::LogLevel::WARN, std::string("warned")));
+    REQUIRE(log.lines[1] == std::pair(gc::Logger::LogLevel::DEBUG, std::string("debugged")));
+    REQUIRE(log.lines[2] == std::pair(gc::Logger::LogLevel::ERROR, std::string("formatted 1")));
+    REQUIRE(log.lines[3] == std::pair(gc::Logger::LogLevel::INFO, std::string("fields key=2")));
+}
+
+// -----------------------------------------------------------------------------
+TEST_CASE("A level lets through itself and everything above it", "[level]")
+{
+    using Level = gc::Logger::LogLevel;
+    gc::Logger log(Level::WARN);
+
+    REQUIRE_FALSE(log.isEnabled(Level::TRACE));
+    REQUIRE_FALSE(log.isEnabled(Level::DEBUG));
+    REQUIRE_FALSE(log.isEnabled(Level::INFO));
+    REQUIRE(log.isEnabled(Level::WARN));
+    REQUIRE(log.isEnabled(Level::ERROR));
+
+    log.setLevel(Level::TRACE);
+    REQUIRE(log.getLogLevel() == Level::TRACE);
+    REQUIRE(log.isEnabled(Level::TRACE));
+
+    log.setLevel(Level::ERROR);
+    REQUIRE_FALSE(log.isEnabled(Level::WARN));
+    REQUIRE(log.isEnabled(Level::ERROR));
+}
+
+TEST_CASE("The level can be changed while other threads log", "[level]")
+{
+    CapturingLogger backend;
+    gc::AsyncLogger log(backend, 1024);
+
+    std::atomic<bool> done{false};
+    std::thread changer([&log, &done] {
+        while (!done.load()) {
+            log.setLevel(gc::Logger::LogLevel::ERROR);
+            log.setLevel(gc::Logger::LogLevel::TRACE);
+        }
+    });
+    for (int i = 0; i < 2000; ++i) {
+        log.debug("{}", i);
+    }
+    done = true;
+    changer.join();
+
+    log.setLevel(gc::Logger::LogLevel::ERROR);
+    log.warn("{}", "dropped");
+    log.error("{}", "kept");
+    log.flush();
+    REQUIRE(backend.lines.back().second == "kept");
+    REQUIRE(backend.lines.size() <= 2001);
+}
+
+TEST_CASE("Categories filter on their own level", "[level]")
+{
+    CapturingLogger backend;
+    gc::CategoryRegistry categories(backend, gc::Logger::LogLevel::WARN);
+
+    auto &net = categories.get("net");
+    auto &db = categories.get("db");
+    REQUIRE(&categories.get("net") == &net);
+    REQUIRE(net.getName() == "net");
+
+    categories.setLevel("db", gc::Logger::LogLevel::DEBUG);
+    net.info("{} connections", 3);
+    db.debug("query {}", 7);
+    net.error("refused");
+    REQUIRE(backend.lines.size() == 2);
+    REQUIRE(backend.lines[0] == std::make_pair(gc::Logger::LogLevel::DEBUG, std::string("query 7")));
+    REQUIRE(backend.lines[1] == std::make_pair(gc::Logger::LogLevel::ERROR, std::string("refused")));
+
+    categories.setLevel(gc::Logger::LogLevel::ERROR);
+    db.warn("{}", "dropped");
+    REQUIRE(categories.get("cache").getLogLevel() == gc::Logger::LogLevel::ERROR);
+    REQUIRE(categories.getNames() == std::vector<std::string>{"cache", "db", "net"});
+    REQUIRE(backend.lines.size() == 2);
+}
+
+// -----------------------------------------------------------------------------
+TEST_CASE("Format style overloads format the message once enabled", "[format]")
+{
+    CapturingLogger log;
+    log.info("user {} took {} ms", 42, 3.5);
+    log.error("{:>5}|{}", "ab", std::string("cd"));
+
+    REQUIRE(log.lines.size() == 2);
+    REQUIRE(log.lines[0] == std::make_pair(gc::Logger::LogLevel::INFO, std::string("user 42 took 3.5 ms")));
+    REQUIRE(log.lines[1].second == "   ab|cd");
+
+    log.setLevel(gc::Logger::LogLevel::INFO);
+    log.debug("not {}", "written");
+    REQUIRE(log.lines.size() == 2);
+}
+
+namespace {
+    // A ConsoleSink writing to a fresh file at path instead of stdout.
+    std::shared_ptr<gc::ConsoleSink> consoleSinkTo(const std::filesystem::path &path, bool terminal)
+    {
+        gc::ConsoleSink::OutputPolicy output;
+        output.fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        output.terminal = terminal;
+        output.batchInterval = std::chrono::hours(1);
+        REQUIRE(output.fd >= 0);
+        return std::make_shared<gc::ConsoleSink>(output);
+    }
+}
+
+TEST_CASE("ConsoleSink renders whole colored lines on a terminal", "[format]")
+{
+    const auto path = tempLogPath("console_terminal");
+    auto sink = consoleSinkTo(path, true);
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+    log.addSink(sink);
+
+    sink->setColorizeStyle(gc::ConsoleSink::ColorizeConsoleOutput::LEVEL_ONLY);
+    log.warn("disk {}% full", 93);
+    REQUIRE(readFile(path) == "\033[32m[WARN]: \033[39mdisk 93% full\n");
+
+    sink->setColorizeStyle(gc::ConsoleSink::ColorizeConsoleOutput::ALL);
+    log.error("plain");
+    REQUIRE(readFile(path) == "\033[32m[WARN]: \033[39mdisk 93% full\n"
+                              "\033[31m[ERROR]: plain\033[39m\n");
+
+    sink->setColorizeStyle(gc::ConsoleSink::ColorizeConsoleOutput::NO_COLOR);
+    sink->setColor(gc::Logger::LogLevel::INFO, gc::ConsoleColor::rgb(255, 165, 0));
+    log.info("no escapes");
+    sink->setColorizeStyle(gc::ConsoleSink::ColorizeConsoleOutput::LEVEL_ONLY);
+    log.info("orange");
+    REQUIRE(readFile(path) == "\033[32m[WARN]: \033[39mdisk 93% full\n"
+                              "\033[31m[ERROR]: plain\033[39m\n"
+                              "[INFO]: no escapes\n"
+                              "\033[38;2;255;165;0m[INFO]: \033[39morange\n");
+    ::close(sink->getOutputPolicy().fd);
+}
+
+TEST_CASE("ConsoleSink batches plain lines elsewhere", "[format]")
+{
+    const auto path = tempLogPath("console_piped");
+    auto sink = consoleSinkTo(path, false);
+    REQUIRE_FALSE(sink->isTerminal());
+    sink->setColorizeStyle(gc::ConsoleSink::ColorizeConsoleOutput::ALL);
+
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+    log.addSink(sink);
+
+    log.info("one");
+    log.warn("two");
+    REQUIRE(readFile(path).empty());
+
+    log.flush();
+    REQUIRE(readFile(path) == "[INFO]: one\n[WARN]: two\n");
+
+    // Errors are not held back.
+    log.error("three");
+    REQUIRE(readFile(path) == "[INFO]: one\n[WARN]: two\n[ERROR]: three\n");
+    ::close(sink->getOutputPolicy().fd);
+}
+
+TEST_CASE("FileLogger and AsyncLogger accept format style calls", "[format]")
+{
+    const auto path = tempLogPath("format");
+    {
+        gc::FileLogger file(gc::Logger::LogLevel::TRACE, path.string());
+        file.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+        file.info("{} + {} = {}", 1, 2, 3);
+    }
+    REQUIRE(readFile(path) == "[INFO]: 1 + 2 = 3\n");
+
+    CapturingLogger backend;
+    gc::AsyncLogger log(backend);
+    log.warn("queued {}", std::string(300, 'y'));
+    log.flush();
+    REQUIRE(backend.lines.size() == 1);
+    REQUIRE(backend.lines[0].second == "queued " + std::string(300, 'y'));
+}
+
+// -----------------------------------------------------------------------------
+#include "RotatingFileSink.hpp"
+
+namespace {
+    // Default formatting, counting how many lines it rendered.
+    class CountingFormatter final : public gc::Formatter
+    {
+    public:
+        mutable std::atomic<int> calls{0};
+
+        gc::LogLine format(fmt::memory_buffer &out, const gc::Logger &logger,
+                           gc::Logger::LogLevel level, fmt::string_view format,
+                           fmt::format_args args, std::span<const gc::Field> fields) const override
+        {
+            ++calls;
+            return Formatter::format(out, logger, level, format, args, fields);
+        }
+    };
+}
+
+TEST_CASE("SinkLogger formats each line once for all of its sinks", "[sink]")
+{
+    auto first = std::make_shared<gc::MemorySink>();
+    auto second = std::make_shared<gc::MemorySink>();
+    auto formatter = std::make_unique<CountingFormatter>();
+    const auto &calls = formatter->calls;
+
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {first, std::make_shared<gc::NullSink>()});
+    log.addSink(second);
+    log.setFormatter(std::move(formatter));
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+    log.warn("disk {}% full", 93);
+    log.info("plain");
+
+    REQUIRE(calls == 2);
+    REQUIRE(first->getLines() == second->getLines());
+    REQUIRE(first->getLines().size() == 2);
+    REQUIRE(first->getLines()[0] == std::make_pair(gc::Logger::LogLevel::WARN, std::string("[WARN]: disk 93% full")));
+    REQUIRE(first->getLines()[1].second == "[INFO]: plain");
+}
+
+namespace {
+    // Removes what earlier runs left next to the live file at path.
+    void removeRotated(const std::filesystem::path &path)
+    {
+        const std::string prefix = path.filename().string() + '.';
+        for (const auto &entry : std::filesystem::directory_iterator(path.parent_path())) {
+            if (entry.path().filename().string().rfind(prefix, 0) == 0) {
+                std::filesystem::remove(entry.path());
+            }
+        }
+    }
+
+    // Rotated files next to path, sorted by name.
+    std::vector<std::filesystem::path> listRotated(const std::filesystem::path &path)
+    {
+        std::vector<std::filesystem::path> rotated;
+        const std::string prefix = path.filename().string() + '.';
+        for (const auto &entry : std::filesystem::directory_iterator(path.parent_path())) {
+            if (entry.path().filename().string().rfind(prefix, 0) == 0) {
+                rotated.push_back(entry.path());
+            }
+        }
+        std::sort(rotated.begin(), rotated.end());
+        return rotated;
+    }
+
+    // Just enough of an LZ4 frame reader for what the sink writes.
+    std::string decodeLz4(const std::string &frame)
+    {
+        const auto byte = [&](std::size_t at) { return static_cast<unsigned char>(frame.at(at)); };
+        const auto read32 = [&](std::size_t at) {
+            return static_cast<std::uint32_t>(byte(at) | byte(at + 1) << 8 | byte(at + 2) << 16)
+                   | static_cast<std::uint32_t>(byte(at + 3)) << 24;
+        };
+        const auto readLength = [&](std::size_t &at, std::size_t length) {
+            if (length == 15) {
+                unsigned char next;
+                do {
+                    next = byte(at++);
+                    length += next;
+                } while (next == 255);
+            }
+            return length;
+        };
+
+        REQUIRE(read32(0) == 0x184D2204);
+        std::string text;
+        std::size_t at = 7;
+        for (std::uint32_t block = read32(at); block != 0; block = read32(at)) {
+            at += 4;
+            const std::size_t size = block & 0x7FFFFFFF;
+            if ((block & 0x80000000U) != 0) {
+                text.append(frame, at, size);
+                at += size;
+                continue;
+            }
+
+            const std::size_t blockStart = text.size();
+            for (const std::size_t end = at + size; at < end;) {
+                const unsigned char token = byte(at++);
+                const std::size_t literals = readLength(at, token >> 4);
+                text.append(frame, at, literals);
+                at += literals;
+                if (at == end) {
+                    break;
+                }
+
+                const std::size_t offset = byte(at) | static_cast<std::size_t>(byte(at + 1)) << 8;
+                at += 2;
+                const std::size_t match = readLength(at, token & 15U) + 4;
+                if (offset == 0 || offset > text.size() - blockStart) {
+                    FAIL("match offset " << offset << " outside the block");
+                }
+                for (std::size_t copied = 0; copied < match; ++copied) {
+                    text.push_back(text[text.size() - offset]);
+                }
+            }
+        }
+        return text;
+    }
+}
+
+TEST_CASE("RotatingFileSink names, rotates and prunes files", "[sink]")
+{
+    const auto path = tempLogPath("rotating");
+    removeRotated(path);
+
+    gc::RotatingFileSink::RotationPolicy rotation;
+    rotation.maxBytes = 30;
+    rotation.maxFiles = 2;
+    {
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+        log.addSink(std::make_shared<gc::RotatingFileSink>(path.string(), rotation));
+
+        // 15 bytes a line, two to a file.
+        for (int index = 0; index < 8; ++index) {
+            log.info("line {}", index);
+            log.flush();
+        }
+    }
+
+    REQUIRE(readFile(path) == "[INFO]: line 6\n[INFO]: line 7\n");
+
+    const auto rotated = listRotated(path);
+    REQUIRE(rotated.size() == 2);
+    const std::string name = rotated[0].filename().string();
+    const std::string date = name.substr(path.filename().string().size() + 1, 10);
+    REQUIRE(name == path.filename().string() + '.' + date + ".2");
+    REQUIRE(rotated[1].filename().string() == path.filename().string() + '.' + date + ".3");
+    REQUIRE(readFile(rotated[0]) == "[INFO]: line 2\n[INFO]: line 3\n");
+    REQUIRE(readFile(rotated[1]) == "[INFO]: line 4\n[INFO]: line 5\n");
+}
+
+TEST_CASE("RotatingFileSink compresses rotated files to LZ4 frames", "[sink]")
+{
+    const auto path = tempLogPath("compressed");
+    removeRotated(path);
+
+    gc::RotatingFileSink::RotationPolicy rotation;
+    rotation.maxBytes = 200 * 1024;
+    rotation.maxFiles = 0;
+    rotation.compression = gc::RotatingFileSink::Compression::LZ4;
+
+    std::string expected;
+    {
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+        log.addSink(std::make_shared<gc::RotatingFileSink>(path.string(), rotation));
+
+        // More than one block, repetitive with some noise.
+        std::uint32_t noise = 12345;
+        while (expected.size() < rotation.maxBytes - 100) {
+            noise = noise * 1103515245 + 12345;
+            const std::string line = fmt::format("request {} served in {} us", noise % 1000, noise >> 20);
+            log.info("{}", line);
+            expected += "[INFO]: " + line + "\n";
+        }
+        log.flush();
+        log.info("{}", std::string(200, 'z'));
+        log.flush();
+    }
+
+    const auto rotated = listRotated(path);
+    REQUIRE(rotated.size() == 1);
+    REQUIRE(rotated[0].extension() == ".lz4");
+
+    const std::string frame = readFile(rotated[0]);
+    REQUIRE(frame.size() < expected.size() / 2);
+    REQUIRE(decodeLz4(frame) == expected);
+}
+
+TEST_CASE("RotatingFileSink opens the next file itself if the worker couldn't", "[sink]")
+{
+    const auto path = tempLogPath("overrun");
+    removeRotated(path);
+    const std::filesystem::path next = path.string() + ".next";
+    std::filesystem::create_directory(next);
+
+    gc::RotatingFileSink::RotationPolicy rotation;
+    rotation.maxBytes = 30;
+    rotation.maxFiles = 0;
+    {
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+        auto sink = std::make_shared<gc::RotatingFileSink>(path.string(), rotation);
+        log.addSink(sink);
+
+        for (int index = 0; index < 4; ++index) {
+            log.info("line {}", index);
+        }
+        log.flush();
+        REQUIRE(sink->getOverrunCount() == 2);
+        REQUIRE(listRotated(path) == std::vector<std::filesystem::path>{next});
+
+        std::filesystem::remove(next);
+        log.info("line {}", 4);
+        log.flush();
+        REQUIRE(sink->getOverrunCount() == 2);
+    }
+
+    REQUIRE(readFile(path) == "[INFO]: line 4\n");
+    const auto rotated = listRotated(path);
+    REQUIRE(rotated.size() == 1);
+    REQUIRE(readFile(rotated[0]) == "[INFO]: line 0\n[INFO]: line 1\n[INFO]: line 2\n[INFO]: line 3\n");
+}
+
+TEST_CASE("RotatingFileSink finishes a rotation a crash cut short", "[sink]")
+{
+    const auto path = tempLogPath("interrupted");
+    removeRotated(path);
+    std::ofstream(path) << "[INFO]: older\n";
+    std::ofstream(path.string() + ".next") << "[INFO]: newer\n";
+
+    gc::RotatingFileSink::RotationPolicy rotation;
+    rotation.maxBytes = 1024;
+    rotation.maxFiles = 0;
+    {
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+        log.addSink(std::make_shared<gc::RotatingFileSink>(path.string(), rotation));
+        log.info("newest");
+        log.flush();
+    }
+
+    REQUIRE(readFile(path) == "[INFO]: newer\n[INFO]: newest\n");
+    const auto rotated = listRotated(path);
+    REQUIRE(rotated.size() == 1);
+    REQUIRE(readFile(rotated[0]) == "[INFO]: older\n");
+}
+
+// -----------------------------------------------------------------------------
+#include "MappedFileSink.hpp"
+
+TEST_CASE("MappedFileSink appends every line and trims the file", "[sink]")
+{
+    const auto path = tempLogPath("mapped");
+    {
+        std::ofstream existing(path);
+        existing << "kept\n";
+    }
+
+    // One page chunks, so lines straddle chunks and slots get reused.
+    gc::MappedFileSink::MappingPolicy mapping;
+    mapping.chunkSize = 1;
+    mapping.chunksAhead = 1;
+
+    constexpr int Threads = 4;
+    constexpr int PerThread = 2000;
+    {
+        auto sink = std::make_shared<gc::MappedFileSink>(path.string(), mapping);
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {sink});
+        log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < Threads; ++thread) {
+            threads.emplace_back([&log, thread] {
+                for (int index = 0; index < PerThread; ++index) {
+                    log.info("thread {} line {}", thread, index);
+                }
+            });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        log.flush();
+        REQUIRE(sink->getDroppedCount() == 0);
+    }
+
+    std::istringstream lines(readFile(path));
+    std::string line;
+    REQUIRE(std::getline(lines, line));
+    REQUIRE(line == "kept");
+
+    // Each thread's lines whole and in order.
+    std::vector<int> next(Threads, 0);
+    bool intact = true;
+    while (std::getline(lines, line)) {
+        int thread = -1;
+        int index = 0;
+        intact = intact
+                 && std::sscanf(line.c_str(), "[INFO]: thread %d line %d", &thread, &index) == 2
+                 && thread >= 0 && thread < Threads
+                 && index == next[static_cast<std::size_t>(thread)]++;
+    }
+    REQUIRE(intact);
+    REQUIRE(next == std::vector<int>(Threads, PerThread));
+}
+
+TEST_CASE("MappedFileSink rotates without losing or splitting lines", "[sink]")
+{
+    const auto path = tempLogPath("mapped_rotate");
+    const std::filesystem::path rotatedPath = path.string() + ".1";
+    std::filesystem::remove(rotatedPath);
+    {
+        std::ofstream existing(path);
+        existing << "kept\n";
+    }
+
+    gc::MappedFileSink::MappingPolicy mapping;
+    mapping.chunkSize = 1;
+    mapping.chunksAhead = 1;
+
+    constexpr int Threads = 3;
+    constexpr int PerThread = 2000;
+    {
+        auto sink = std::make_shared<gc::MappedFileSink>(path.string(), mapping);
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {sink});
+        log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+        std::atomic<int> written{0};
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < Threads; ++thread) {
+            threads.emplace_back([&log, &written, thread] {
+                for (int index = 0; index < PerThread; ++index) {
+                    log.info("thread {} line {}", thread, index);
+                    written.fetch_add(1, std::memory_order_relaxed);
+                }
+            });
+        }
+        while (written.load(std::memory_order_relaxed) < Threads * PerThread / 2) {
+            std::this_thread::yield();
+        }
+        REQUIRE(sink->rotate(rotatedPath.string()));
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        REQUIRE(sink->getDroppedCount() == 0);
+    }
+
+    const std::string before = readFile(rotatedPath);
+    const std::string after = readFile(path);
+    REQUIRE(before.rfind("kept\n", 0) == 0);
+    REQUIRE(before.back() == '\n');
+    REQUIRE(before.find('\0') == std::string::npos);
+    REQUIRE(after.find('\0') == std::string::npos);
+
+    // Every line whole in one file or the other, each thread's in order.
+    std::istringstream lines(before.substr(5) + after);
+    std::string line;
+    std::vector<int> next(Threads, 0);
+    bool intact = true;
+    while (std::getline(lines, line)) {
+        int thread = -1;
+        int index = 0;
+        intact = intact
+                 && std::sscanf(line.c_str(), "[INFO]: thread %d line %d", &thread, &index) == 2
+                 && thread >= 0 && thread < Threads
+                 && index == next[static_cast<std::size_t>(thread)]++;
+    }
+    REQUIRE(intact);
+    REQUIRE(next == std::vector<int>(Threads, PerThread));
+    std::filesystem::remove(rotatedPath);
+}
+
+// -----------------------------------------------------------------------------
+#include "Formatters.hpp"
+
+namespace {
+    // What appendEscaped should produce, one character at a time.
+    std::string escapeSlowly(std::string_view text)
+    {
+        std::string escaped;
+        for (const char c : text) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                escaped += fmt::format("\\u{:04x}", static_cast<int>(c));
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    // The line without the ts field every machine readable line starts with.
+    std::string withoutTimestamp(const std::string &line, std::string_view prefix, char end)
+    {
+        REQUIRE(line.rfind(prefix, 0) == 0);
+        return line.substr(line.find(end, prefix.size()));
+    }
+}
+
+TEST_CASE("Fields read as key=value in plain lines", "[fields]")
+{
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {memory});
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+    const std::string user = "ann smith";
+    log.info("request done", gc::kv("status", 200), gc::kv("ms", 3.25), gc::kv("user", user),
+             gc::kv("ok", true), gc::kv("bytes", 12U), gc::kv("grade", 'A'));
+    REQUIRE(memory->getLines().at(0).second
+            == R"([INFO]: request done status=200 ms=3.25 user="ann smith" ok=true bytes=12 grade=A)");
+
+    // Loggers that don't encode fields get the same text.
+    CapturingLogger capture;
+    capture.warn("retrying", gc::kv("attempt", -2), gc::kv("reason", ""));
+    REQUIRE(capture.lines.at(0).second == R"(retrying attempt=-2 reason="")");
+}
+
+TEST_CASE("JsonFormatter writes one escaped object a line", "[fields]")
+{
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {memory});
+    log.setFormatter(std::make_unique<gc::JsonFormatter>());
+
+    log.warn("quote \" and \\ in {}", "msg");
+    log.info("request done", gc::kv("status", 200), gc::kv("path", "/a\tb"),
+             gc::kv("ratio", 0.5), gc::kv("nan", std::nan("")), gc::kv("ok", false));
+
+    const auto lines = memory->getLines();
+    REQUIRE(withoutTimestamp(lines.at(0).second, R"({"ts":)", ',')
+            == R"(,"level":"warn","msg":"quote \" and \\ in msg"})");
+    REQUIRE(withoutTimestamp(lines.at(1).second, R"({"ts":)", ',')
+            == R"(,"level":"info","msg":"request done","status":200,"path":"/a\tb","ratio":0.5,"nan":null,"ok":false})");
+}
+
+TEST_CASE("LogfmtFormatter quotes only where it has to", "[fields]")
+{
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {memory});
+    log.setFormatter(std::make_unique<gc::LogfmtFormatter>());
+
+    log.error("disk full", gc::kv("mount", "/var"), gc::kv("note", "a=b"), gc::kv("free", 0));
+    log.info("done");
+
+    const auto lines = memory->getLines();
+    REQUIRE(withoutTimestamp(lines.at(0).second, "ts=", ' ')
+            == R"( level=error msg="disk full" mount=/var note="a=b" free=0)");
+    REQUIRE(withoutTimestamp(lines.at(1).second, "ts=", ' ') == " level=info msg=done");
+}
+
+TEST_CASE("appendEscaped matches a character by character escape", "[fields]")
+{
+    constexpr std::string_view Alphabet = "abcdef \"\\\n\x01\x1f\x7f\xc3\xa9";
+    std::uint32_t random = 7;
+    bool same = true;
+
+    for (std::size_t size = 0; size < 100; ++size) {
+        for (int round = 0; round < 20; ++round) {
+            std::string text;
+            for (std::size_t index = 0; index < size; ++index) {
+                random = random * 1103515245 + 12345;
+                text += Alphabet[(random >> 16) % Alphabet.size()];
+            }
+
+            fmt::memory_buffer escaped;
+            gc::detail::appendEscaped(escaped, text);
+            same = same && fmt::to_string(escaped) == escapeSlowly(text);
+        }
+    }
+    REQUIRE(same);
+}
+
+// -----------------------------------------------------------------------------
+#include "BinaryLogger.hpp"
+
+TEST_CASE("BinaryLogger text output matches the other loggers", "[binary]")
+{
+    const auto path = tempLogPath("binary_text");
+    {
+        gc::BinaryLogger log(gc::Logger::LogLevel::TRACE, path.string(),
+                             gc::BinaryLogger::Encoding::TEXT);
+        log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+        const std::string name = "disk";
+        GCLOG_BINARY_INFO(log, "{} is {}% full, {} {} {}", name, 93U, -1, 2.5, true);
+        GCLOG_BINARY_WARN(log, "char {} view {}", 'x', std::string_view("sv"));
+        log.error("plain message");
+        log.debug("formatted {}", 7);
+        log.flush();
+
+        REQUIRE(readFile(path) == "[INFO]: disk is 93% full, -1 2.5 true\n"
+                                  "[WARN]: char x view sv\n"
+                                  "[ERROR]: plain message\n"
+                                  "[DEBUG]: formatted 7\n");
+    }
+}
+
+TEST_CASE("BinaryLogger binary output decodes to the same lines", "[binary]")
+{
+    const auto path = tempLogPath("binary");
+    constexpr int threads = 4;
+    constexpr int perThread = 500;
+    {
+        gc::BinaryLogger log(gc::Logger::LogLevel::TRACE, path.string());
+        std::vector<std::thread> producers;
+        for (int t = 0; t < threads; ++t) {
+            producers.emplace_back([&log, t] {
+                for (int i = 0; i < perThread; ++i) {
+                    GCLOG_BINARY_ERROR(log, "thread {} record {}", t, i);
+                }
+            });
+        }
+        for (auto &producer : producers) {
+            producer.join();
+        }
+        REQUIRE(log.getDroppedCount() == 0);
+    }
+
+    gc::Logger format(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+    std::ifstream in(path, std::ios::binary);
+    std::vector<int> next(threads, 0);
+    int records = 0;
+    fmt::memory_buffer line;
+
+    const bool complete = gc::binlog::readFile(in, [&](const gc::binlog::CallSite &site,
+                                                       const timespec &,
+                                                       std::string_view payload) {
+        line.clear();
+        gc::binlog::appendLine(line, format, site, {}, payload);
+        const std::string text(line.data(), line.size());
+
+        int thread = 0;
+        int record = 0;
+        REQUIRE(std::sscanf(text.c_str(), "[ERROR]: thread %d record %d", &thread, &record) == 2);
+        // Each thread's records arrive in the order they were logged.
+        REQUIRE(record == next[static_cast<std::size_t>(thread)]++);
+        ++records;
+    });
+
+    REQUIRE(complete);
+    REQUIRE(records == threads * perThread);
+}
+
+TEST_CASE("Binary logs appended to by several loggers decode as segments", "[binary]")
+{
+    const auto path = tempLogPath("binary_append");
+    for (int run = 0; run < 2; ++run) {
+        gc::BinaryLogger log(gc::Logger::LogLevel::TRACE, path.string());
+        GCLOG_BINARY_INFO(log, "run {} first", run);
+        GCLOG_BINARY_WARN(log, "run {} second", run);
+    }
+
+    gc::Logger format(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+    const auto decode = [&format](std::istream &in, std::vector<std::string> &lines) {
+        return gc::binlog::readFile(in, [&](const gc::binlog::CallSite &site, const timespec &,
+                                            std::string_view payload) {
+            fmt::memory_buffer line;
+            gc::binlog::appendLine(line, format, site, {}, payload);
+            lines.emplace_back(line.data(), line.size() - 1);
+        });
+    };
+
+    std::ifstream in(path, std::ios::binary);
+    std::vector<std::string> lines;
+    REQUIRE(decode(in, lines));
+    REQUIRE(lines == std::vector<std::string>{"[INFO]: run 0 first", "[WARN]: run 0 second",
+                                              "[INFO]: run 1 first", "[WARN]: run 1 second"});
+
+    SECTION("a new segment's ids are its own") {
+        // Another process's id 1 is a different call site.
+        gc::binlog::CallSite first;
+        first.id = 1;
+        first.level = gc::Logger::LogLevel::INFO;
+        first.format = "from the first process";
+        gc::binlog::CallSite second = first;
+        second.format = "from the second process";
+
+        fmt::memory_buffer file;
+        for (const auto *site : {&first, &second}) {
+            file.append(gc::binlog::FileMagic);
+            gc::binlog::appendSiteEntry(file, *site);
+            gc::binlog::appendRecordEntry(file, 1, 0, {});
+        }
+        std::istringstream segments(std::string(file.data(), file.size()));
+        lines.clear();
+        REQUIRE(decode(segments, lines));
+        REQUIRE(lines == std::vector<std::string>{"[INFO]: from the first process",
+                                                  "[INFO]: from the second process"});
+    }
+
+    SECTION("call site ids out of range are rejected") {
+        for (const std::uint32_t id : {0U, gc::binlog::MaxSiteId + 1, 0xFFFFFFFFU}) {
+            gc::binlog::CallSite site;
+            site.id = id;
+            fmt::memory_buffer file;
+            file.append(gc::binlog::FileMagic);
+            gc::binlog::appendSiteEntry(file, site);
+            std::istringstream corrupt(std::string(file.data(), file.size()));
+            lines.clear();
+            REQUIRE_FALSE(decode(corrupt, lines));
+        }
+    }
+}
+
+TEST_CASE("An idle BinaryLogger writer wakes up for the next record", "[binary]")
+{
+    const auto path = tempLogPath("binary_wakeup");
+    gc::BinaryLogger log(gc::Logger::LogLevel::TRACE, path.string(),
+                         gc::BinaryLogger::Encoding::TEXT);
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+    // No flush, only the record itself can wake the writer.
+    std::string expected;
+    for (int i = 0; i < 10; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        GCLOG_BINARY_INFO(log, "record {}", i);
+        expected += "[INFO]: record " + std::to_string(i) + "\n";
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (readFile(path) != expected && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        REQUIRE(readFile(path) == expected);
+    }
+}
+
+TEST_CASE("BinaryLogger counts records dropped on a full buffer", "[binary]")
+{
+    const auto path = tempLogPath("binary_drop");
+    gc::BinaryLogger log(gc::Logger::LogLevel::TRACE, path.string(),
+                         gc::BinaryLogger::Encoding::BINARY, 64);
+
+    // Bigger than half the ring, never fits.
+    GCLOG_BINARY_INFO(log, "{}", std::string(100, 'x'));
+    REQUIRE(log.getDroppedCount() == 1);
+}
+
+// -----------------------------------------------------------------------------
+TEST_CASE("Registry loggers inherit from their dotted parent", "[registry]")
+{
+    auto root = std::make_shared<gc::MemorySink>();
+    gc::LoggerRegistry registry({root}, gc::Logger::LogLevel::WARN);
+
+    auto &http = registry.get("net.http");
+    REQUIRE(&registry.get("net.http") == &http);
+    REQUIRE(http.getParent() == &registry.get("net"));
+    REQUIRE(http.getParent()->getParent() == &registry.getRoot());
+    REQUIRE(http.getLogLevel() == gc::Logger::LogLevel::WARN);
+
+    http.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+    http.info("{}", "dropped");
+    http.warn("{} slow", "GET");
+    REQUIRE(root->getLines().size() == 1);
+    REQUIRE(root->getLines()[0].second == "[WARN]: GET slow");
+
+    auto net = std::make_shared<gc::MemorySink>();
+    registry.setLevel("net", gc::Logger::LogLevel::DEBUG);
+    registry.setSinks("net", {net});
+    REQUIRE(http.getLogLevel() == gc::Logger::LogLevel::DEBUG);
+    REQUIRE(registry.getRoot().getLogLevel() == gc::Logger::LogLevel::WARN);
+
+    http.debug("status {}", 200);
+    REQUIRE(root->getLines().size() == 1);
+    REQUIRE(net->getLines().size() == 1);
+
+    registry.setLevel("net.http", gc::Logger::LogLevel::ERROR);
+    registry.setLevel("net", gc::Logger::LogLevel::TRACE);
+    REQUIRE(http.getLogLevel() == gc::Logger::LogLevel::ERROR);
+
+    registry.inherit("net.http");
+    REQUIRE(http.getLogLevel() == gc::Logger::LogLevel::TRACE);
+    REQUIRE(http.getSinks() == std::vector<std::shared_ptr<gc::Sink>>{net});
+}
+
+TEST_CASE("A registry logger's own setLevel survives later updates", "[registry]")
+{
+    gc::LoggerRegistry registry({std::make_shared<gc::NullSink>()});
+    auto &http = registry.get("net.http");
+
+    gc::Logger &base = http;
+    base.setLevel(gc::Logger::LogLevel::ERROR);
+    registry.setLevel("net", gc::Logger::LogLevel::TRACE);
+    registry.setSinks("net", {std::make_shared<gc::MemorySink>()});
+    REQUIRE(http.getLogLevel() == gc::Logger::LogLevel::ERROR);
+
+    registry.inherit("net.http");
+    REQUIRE(http.getLogLevel() == gc::Logger::LogLevel::TRACE);
+}
+
+TEST_CASE("GCLOG_LOGGER looks a call site's logger up once", "[registry]")
+{
+    auto handle = [] { return &GCLOG_LOGGER("gclog.tests.handle"); };
+    REQUIRE(handle() == &gc::get("gclog.tests.handle"));
+    REQUIRE(handle() == handle());
+    REQUIRE(gc::get("gclog.tests").getName() == "gclog.tests");
+}
+
+TEST_CASE("Registry updates race safely with logging", "[registry]")
+{
+    gc::LoggerRegistry registry({std::make_shared<gc::NullSink>()});
+    auto &logger = registry.get("a.b");
+    auto memory = std::make_shared<gc::MemorySink>();
+
+    std::atomic<bool> done{false};
+    std::thread updater([&registry, &memory, &done] {
+        for (int i = 0; !done.load(); ++i) {
+            registry.setSinks("a", {memory});
+            registry.setLevel("a", i % 2 ? gc::Logger::LogLevel::TRACE : gc::Logger::LogLevel::ERROR);
+            registry.inherit("a");
+        }
+    });
+    for (int i = 0; i < 2000; ++i) {
+        logger.info("{}", i);
+    }
+    done = true;
+    updater.join();
+    REQUIRE(logger.getLogLevel() == gc::Logger::LogLevel::INFO);
+}
+
+TEST_CASE("Registry snapshots are freed once replaced", "[registry]")
+{
+    gc::LoggerRegistry registry({std::make_shared<gc::NullSink>()});
+    auto &logger = registry.get("a.b");
+    auto first = std::make_shared<gc::MemorySink>();
+    auto second = std::make_shared<gc::MemorySink>();
+
+    registry.setSinks("a", {first});
+    logger.error("{}", "kept");
+    REQUIRE(first.use_count() == 4);  // set on a, a's and a.b's snapshots
+
+    registry.setSinks("a", {second});
+    REQUIRE(first.use_count() == 1);
+    REQUIRE(logger.getSinks() == std::vector<std::shared_ptr<gc::Sink>>{second});
+    REQUIRE(first->getLines().size() == 1);
+}
+
+// -----------------------------------------------------------------------------
+TEST_CASE("A backtrace keeps records below the level until an error", "[backtrace]")
+{
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::INFO, {memory});
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+    gc::Backtrace::BacktracePolicy policy;
+    policy.records = 3;
+    log.enableBacktrace(policy);
+    REQUIRE(log.isEnabled(gc::Logger::LogLevel::TRACE));
+
+    for (int i = 0; i < 5; ++i) {
+        log.debug("step {}", i);
+    }
+    log.info("started");
+    REQUIRE(memory->getLines().size() == 1);
+
+    log.error("failed");
+    const auto lines = memory->getLines();
+    REQUIRE(lines.size() == 5);
+    REQUIRE(lines[1] == std::make_pair(gc::Logger::LogLevel::DEBUG, std::string("[DEBUG]: step 2")));
+    REQUIRE(lines[3].second == "[DEBUG]: step 4");
+    REQUIRE(lines[4].second == "[ERROR]: failed");
+
+    log.dumpBacktrace();
+    REQUIRE(memory->getLines().size() == 5);
+
+    log.disableBacktrace();
+    REQUIRE_FALSE(log.isEnabled(gc::Logger::LogLevel::DEBUG));
+}
+
+TEST_CASE("A shared backtrace cuts long records and dumps on request", "[backtrace]")
+{
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::WARN, {memory});
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+    gc::Backtrace::BacktracePolicy policy;
+    policy.recordSize = 16;
+    policy.perThread = false;
+    log.enableBacktrace(policy);
+
+    std::thread([&log] { log.info("{}", "from another thread"); }).join();
+    log.getBacktrace()->requestDump();
+    log.warn("next");
+
+    const auto lines = memory->getLines();
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0].second == "[INFO]: from an");
+    REQUIRE(lines[1].second == "[WARN]: next");
+}
+
+TEST_CASE("A per thread backtrace dumps the erring thread's records", "[backtrace]")
+{
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::ERROR, {memory});
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+    log.enableBacktrace();
+
+    std::thread([&log] { log.trace("{}", "elsewhere"); }).join();
+    log.trace("{}", "here");
+    log.error("{}", "failed");
+
+    const auto lines = memory->getLines();
+    REQUIRE(lines.size() == 2);
+    REQUIRE(lines[0].second == "[TRACE]: here");
+}
+
+// -----------------------------------------------------------------------------
+TEST_CASE("RateLimiter lets a burst through and refills over time", "[limit]")
+{
+    gc::RateLimiter limiter(2, 3);
+    const auto start = gc::RateLimiter::Clock::now();
+
+    REQUIRE(limiter.tryAcquire(start) == 0u);
+    REQUIRE(limiter.tryAcquire(start) == 0u);
+    REQUIRE(limiter.tryAcquire(start) == 0u);
+    REQUIRE_FALSE(limiter.tryAcquire(start));
+    REQUIRE_FALSE(limiter.tryAcquire(start + std::chrono::milliseconds(400)));
+
+    REQUIRE(limiter.tryAcquire(start + std::chrono::milliseconds(500)) == 2u);
+    REQUIRE_FALSE(limiter.tryAcquire(start + std::chrono::milliseconds(500)));
+}
+
+TEST_CASE("Rate limited macros keep a limiter per call site", "[limit]")
+{
+    CapturingLogger log;
+    const auto burst = [&log] {
+        for (int i = 0; i < 100; ++i) {
+            GCLOG_ERROR_LIMITED(log, 5, "failed {}", i);
+        }
+    };
+
+    burst();
+    REQUIRE(log.lines.size() == 5);
+    REQUIRE(log.lines[4].second == "failed 4");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    burst();
+    REQUIRE(log.lines.size() == 7);
+    REQUIRE(log.lines[5].second == "95 messages suppressed by the rate limit");
+    REQUIRE(log.lines[6].second == "failed 0");
+}
+
+TEST_CASE("Deduplication collapses runs of the same record", "[limit]")
+{
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::DEBUG, {memory});
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+    log.setDeduplicate(true);
+
+    for (int i = 0; i < 5; ++i) {
+        log.error("db down");
+    }
+    log.trace("{}", "not written, not counted");
+    for (int i = 0; i < 3; ++i) {
+        log.info("{} users", i);
+    }
+    log.warn("disk", gc::kv("free", 3));
+    log.flush();
+
+    const auto lines = memory->getLines();
+    REQUIRE(lines.size() == 5);
+    REQUIRE(lines[0].second == "[ERROR]: db down");
+    REQUIRE(lines[1] == std::make_pair(gc::Logger::LogLevel::ERROR,
+                                       std::string("[ERROR]: last message repeated 4 times")));
+    REQUIRE(lines[2].second == "[INFO]: 0 users");
+    REQUIRE(lines[3].second == "[INFO]: last message repeated 2 times");
+    REQUIRE(lines[4].second == "[WARN]: disk free=3");
+}
+
+// -----------------------------------------------------------------------------
+#include "CrashHandler.hpp"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+namespace {
+    // Backend whose first record never comes back, so the ones behind it
+    // stay in the AsyncLogger's queue.
+    class StalledLogger final : public gc::Logger
+    {
+    public:
+        StalledLogger() : Logger(LogLevel::TRACE) {}
+
+        std::atomic<bool> stalled{false};
+
+        void log([[maybe_unused]] LogLevel level, [[maybe_unused]] const std::string &message) override {
+            stalled = true;
+            for (;;) {
+                ::pause();
+            }
+        }
+    };
+
+    // Runs body in a child process that is expected to die, returning
+    // its wait status. No core file, and stderr goes nowhere.
+    template<typename Body>
+    int runCrashing(Body &&body)
+    {
+        const pid_t child = ::fork();
+        if (child == 0) {
+            const rlimit noCore{0, 0};
+            ::setrlimit(RLIMIT_CORE, &noCore);
+            const int devNull = ::open("/dev/null", O_WRONLY);
+            ::dup2(devNull, STDERR_FILENO);
+            body();
+            ::_exit(0);
+        }
+        int status = 0;
+        ::waitpid(child, &status, 0);
+        return status;
+    }
+
+    int openForCrash(const std::filesystem::path &path)
+    {
+        return ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    }
+}
+
+TEST_CASE("A fatal signal flushes buffered and queued records", "[crash]")
+{
+    const auto path = tempLogPath("crash_signal");
+    const std::string longMessage(300, 'x');
+
+    const int status = runCrashing([&] {
+        gc::CrashHandler::install({openForCrash(path), true, false});
+
+        gc::FileSink::FlushPolicy policy;
+        policy.atLevel.reset();
+        auto file = std::make_shared<gc::FileSink>(path.string(), 1 << 20, policy);
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {file});
+        log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+        StalledLogger backend;
+        gc::AsyncLogger async(backend, 64);
+        gc::CrashHandler::add(log);
+        gc::CrashHandler::add(async);
+
+        log.info("buffered {}", 1);
+        log.error("buffered {}", 2);
+        async.info("stalls the writer");
+        while (!backend.stalled) {
+            std::this_thread::yield();
+        }
+        async.warn("queued {}", 1);
+        async.error(longMessage);
+
+        ::raise(SIGSEGV);
+    });
+
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(WTERMSIG(status) == SIGSEGV);
+
+    const std::string contents = readFile(path);
+    const std::string expected = "[INFO]: buffered 1\n[ERROR]: buffered 2\n"
+                                 "[WARN]: queued 1\n[ERROR]: " + longMessage + "\n"
+                                 "[FATAL]: caught SIGSEGV (signal 11)\n";
+    REQUIRE(contents.substr(0, expected.size()) == expected);
+    REQUIRE(contents.find("stalls the writer") == std::string::npos);
+}
+
+TEST_CASE("A fatal signal flushes a binary BinaryLogger's buffers", "[crash]")
+{
+    const auto path = tempLogPath("crash_binary");
+
+    const int status = runCrashing([&] {
+        gc::CrashHandler::install({::open("/dev/null", O_WRONLY), true, false});
+
+        // TEXT records can't be formatted in a signal handler.
+        gc::BinaryLogger text(gc::Logger::LogLevel::TRACE, "/dev/null", gc::BinaryLogger::Encoding::TEXT);
+        gc::BinaryLogger log(gc::Logger::LogLevel::TRACE, path.string());
+        if (gc::CrashHandler::add(text) || !gc::CrashHandler::add(log)) {
+            ::_exit(1);
+        }
+        for (int i = 0; i < 3; ++i) {
+            GCLOG_BINARY_WARN(log, "record {} of {}", i, 2.5);
+        }
+        ::raise(SIGSEGV);
+    });
+
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(WTERMSIG(status) == SIGSEGV);
+
+    // A record the writer was in the middle of may come out twice.
+    gc::Logger format(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+    std::ifstream in(path, std::ios::binary);
+    std::vector<std::string> lines;
+    fmt::memory_buffer line;
+    const bool complete = gc::binlog::readFile(in, [&](const gc::binlog::CallSite &site,
+                                                       const timespec &,
+                                                       std::string_view payload) {
+        line.clear();
+        gc::binlog::appendLine(line, format, site, {}, payload);
+        const std::string decoded(line.data(), line.size());
+        if (lines.empty() || lines.back() != decoded) {
+            lines.push_back(decoded);
+        }
+    });
+    REQUIRE(complete);
+    REQUIRE(lines == std::vector<std::string>{"[WARN]: record 0 of 2.5\n", "[WARN]: record 1 of 2.5\n",
+                                              "[WARN]: record 2 of 2.5\n"});
+}
+
+TEST_CASE("std::terminate flushes and names the exception", "[crash]")
+{
+    const auto path = tempLogPath("crash_terminate");
+
+    const int status = runCrashing([&] {
+        gc::CrashHandler::install({openForCrash(path)});
+
+        gc::FileSink::FlushPolicy policy;
+        policy.atLevel.reset();
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE,
+                           {std::make_shared<gc::FileSink>(path.string(), 4096, policy)});
+        log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+        gc::CrashHandler::add(log);
+
+        log.warn("before terminate");
+        try {
+            throw std::runtime_error("boom");
+        } catch (...) {
+            std::terminate();
+        }
+    });
+
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(WTERMSIG(status) == SIGABRT);
+
+    const std::string contents = readFile(path);
+    const std::string expected = "[WARN]: before terminate\n"
+                                 "[FATAL]: std::terminate called after throwing: boom\n";
+    REQUIRE(contents.substr(0, expected.size()) == expected);
+    REQUIRE(contents.find("caught SIGABRT") == std::string::npos);
+}
+
+// -----------------------------------------------------------------------------
+#include "ShardedLogger.hpp"
+
+TEST_CASE("ShardedLogger merges every thread's records in time order", "[sharded]")
+{
+    CapturingLogger backend;
+    gc::ShardedLogger log(backend, 64 * 1024, std::chrono::milliseconds(50));
+
+    // The lock makes taking a number and logging it one step, so the
+    // numbers' order is the timestamps' order.
+    std::mutex order;
+    int next = 0;
+    constexpr int threads = 4;
+    constexpr int perThread = 500;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t) {
+        producers.emplace_back([&] {
+            for (int i = 0; i < perThread; ++i) {
+                std::lock_guard<std::mutex> guard(order);
+                log.info("{}", next++);
+            }
+        });
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    log.flush();
+
+    REQUIRE(backend.lines.size() == threads * perThread);
+    for (std::size_t i = 0; i < backend.lines.size(); ++i) {
+        REQUIRE(backend.lines[i].second == std::to_string(i));
+    }
+    REQUIRE(backend.flushes == 1);
+    REQUIRE(log.getDroppedCount() == 0);
+}
+
+TEST_CASE("ShardedLogger cuts long messages and writes directly once stopped", "[sharded]")
+{
+    CapturingLogger backend;
+    gc::ShardedLogger log(backend, 4096);
+
+    log.warn(std::string(3000, 'w'));
+    log.trace("kept");
+    log.shutdown();
+    log.error("after {}", "shutdown");
+
+    REQUIRE(backend.lines.size() == 3);
+    REQUIRE(backend.lines[0].first == gc::Logger::LogLevel::WARN);
+    REQUIRE(backend.lines[0].second == std::string(2048 - sizeof(gc::binlog::ThreadBuffer::Header), 'w'));
+    REQUIRE(backend.lines[1] == std::make_pair(gc::Logger::LogLevel::TRACE, std::string("kept")));
+    REQUIRE(backend.lines[2].second == "after shutdown");
+}
+
+TEST_CASE("ShardedLogger stamps each record with the time it was logged", "[sharded]")
+{
+    // Keeps the time the backend was handed with each record.
+    class TimeCapturingLogger final : public gc::Logger
+    {
+    public:
+        TimeCapturingLogger() : Logger(LogLevel::TRACE) {}
+
+        std::vector<std::optional<timespec>> times;
+
+        void log(LogLevel, const std::string &) override {
+            const timespec *time = gc::detail::recordTime();
+            times.push_back(time == nullptr ? std::nullopt : std::optional<timespec>(*time));
+        }
+    };
+
+    auto nanoseconds = [](const timespec &time) {
+        return std::int64_t{time.tv_sec} * 1'000'000'000 + time.tv_nsec;
+    };
+
+    TimeCapturingLogger backend;
+    gc::ShardedLogger log(backend);
+
+    timespec before{};
+    ::clock_gettime(CLOCK_REALTIME, &before);
+    log.info("stamped");
+    timespec after{};
+    ::clock_gettime(CLOCK_REALTIME, &after);
+    // Written long after it was logged.
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    log.flush();
+
+    REQUIRE(backend.times.size() == 1);
+    REQUIRE(backend.times[0].has_value());
+    constexpr std::int64_t tolerance = 5'000'000;
+    REQUIRE(nanoseconds(*backend.times[0]) >= nanoseconds(before) - tolerance);
+    REQUIRE(nanoseconds(*backend.times[0]) <= nanoseconds(after) + tolerance);
+}
+
+TEST_CASE("ShardedLogger writes what is still in its shards from a signal handler", "[sharded]")
+{
+    CapturingLogger backend;
+    // A window long enough that nothing leaves the shards.
+    gc::ShardedLogger log(backend, 4096, std::chrono::seconds(60));
+
+    log.warn("one");
+    log.info("two");
+
+    const auto path = tempLogPath("sharded_signal");
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    REQUIRE(fd >= 0);
+    log.flushFromSignal(fd);
+    ::close(fd);
+
+    REQUIRE(readFile(path) == "[WARN]: one\n[INFO]: two\n");
+    REQUIRE(backend.lines.empty());
+
+    // Still there for the writer thread.
+    log.flush();
+    REQUIRE(backend.lines.size() == 2);
+    std::filesystem::remove(path);
+}
+
+// -----------------------------------------------------------------------------
+#include "SharedMemorySink.hpp"
+
+namespace {
+    std::string ringName(const std::string &name)
+    {
+        return "/gclog_test_" + name + "_" + std::to_string(::getpid());
+    }
+}
+
+TEST_CASE("Producer processes share one ring through SharedMemorySink", "[shm]")
+{
+    const std::string name = ringName("processes");
+    gc::SharedRing::unlink(name);
+
+    constexpr int processes = 4;
+    constexpr int perProcess = 300;
+    std::vector<pid_t> children;
+    for (int p = 0; p < processes; ++p) {
+        const pid_t child = ::fork();
+        if (child == 0) {
+            // Racing each other to create the ring.
+            gc::SinkLogger log(gc::Logger::LogLevel::TRACE, gc::Logger::AppendDateTimeFormat::NONE);
+            log.addSink(std::make_shared<gc::SharedMemorySink>(name, gc::SharedRing::Geometry{2048, 256}));
+            for (int i = 0; i < perProcess; ++i) {
+                log.info("process {} line {}", p, i);
+            }
+            ::_exit(0);
+        }
+        children.push_back(child);
+    }
+
+    for (const pid_t child : children) {
+        int status = 0;
+        ::waitpid(child, &status, 0);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(WEXITSTATUS(status) == 0);
+    }
+
+    gc::SharedRing ring(name, {});
+    REQUIRE(ring.getCellCount() == 2048);
+
+    std::vector<int> next(processes, 0);
+    std::vector<pid_t> pids(processes, 0);
+    bool inOrder = true;
+    while (ring.tryPop([&](const gc::SharedRing::Record &record) {
+        int process = 0;
+        int line = 0;
+        REQUIRE(std::sscanf(std::string(record.text).c_str(), "[INFO]: process %d line %d", &process, &line) == 2);
+        REQUIRE(record.level == gc::Logger::LogLevel::INFO);
+        REQUIRE(record.text.back() == '\n');
+        inOrder = inOrder && line == next[static_cast<std::size_t>(process)]++;
+        pids[static_cast<std::size_t>(process)] = record.pid;
+    })) {
+    }
+
+    REQUIRE(inOrder);
+    REQUIRE(next == std::vector<int>(processes, perProcess));
+    for (int p = 0; p < processes; ++p) {
+        REQUIRE(pids[static_cast<std::size_t>(p)] == children[static_cast<std::size_t>(p)]);
+    }
+    REQUIRE(ring.getDroppedCount() == 0);
+    gc::SharedRing::unlink(name);
+}
+
+TEST_CASE("A full ring drops lines and long lines are cut", "[shm]")
+{
+    const std::string name = ringName("full");
+    gc::SharedRing::unlink(name);
+    gc::SharedRing ring(name, {3, 128});
+    REQUIRE(ring.getCellCount() == 4);
+    REQUIRE(ring.getTextCapacity() < 128);
+
+    const std::string longLine = std::string(300, 'l') + "\n";
+    REQUIRE(ring.tryPush(gc::Logger::LogLevel::ERROR, longLine));
+    for (int i = 0; i < 3; ++i) {
+        REQUIRE(ring.tryPush(gc::Logger::LogLevel::INFO, "fits\n"));
+    }
+    REQUIRE_FALSE(ring.tryPush(gc::Logger::LogLevel::INFO, "dropped\n"));
+    REQUIRE_FALSE(ring.tryPush(gc::Logger::LogLevel::INFO, "dropped\n"));
+    REQUIRE(ring.getDroppedCount() == 2);
+
+    std::vector<std::string> lines;
+    while (ring.tryPop([&](const gc::SharedRing::Record &record) { lines.emplace_back(record.text); })) {
+    }
+    REQUIRE(lines.size() == 4);
+    REQUIRE(lines[0] == std::string(ring.getTextCapacity() - 1, 'l') + "\n");
+    REQUIRE(lines[3] == "fits\n");
+
+    REQUIRE(ring.tryPush(gc::Logger::LogLevel::INFO, "room again\n"));
+    gc::SharedRing::unlink(name);
+}
+
+namespace {
+    int stallReadyFd = -1;
+
+    // Forks a producer that faults copying its line, after claiming a
+    // cell and before publishing it. Unless it stays, the fault kills it.
+    pid_t forkFaultingProducer(gc::SharedRing &ring, bool stay)
+    {
+        void *page = ::mmap(nullptr, 4096, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        REQUIRE(page != MAP_FAILED);
+        const pid_t child = ::fork();
+        if (child == 0) {
+            if (stay) {
+                struct sigaction action{};
+                action.sa_handler = [](int) {
+                    const char ready = 1;
+                    [[maybe_unused]] const auto written = ::write(stallReadyFd, &ready, 1);
+                    for (;;) {
+                        ::pause();
+                    }
+                };
+                ::sigaction(SIGSEGV, &action, nullptr);
+            } else {
+                ::signal(SIGSEGV, SIG_DFL);
+            }
+            ring.tryPush(gc::Logger::LogLevel::INFO, std::string_view(static_cast<const char *>(page), 16));
+            ::_exit(0);
+        }
+        ::munmap(page, 4096);
+        return child;
+    }
+
+    std::vector<std::string> popAll(gc::SharedRing &ring)
+    {
+        std::vector<std::string> lines;
+        while (ring.tryPop([&](const gc::SharedRing::Record &record) { lines.emplace_back(record.text); })) {
+        }
+        return lines;
+    }
+}
+
+TEST_CASE("A ring skips a cell whose producer died before publishing it", "[shm]")
+{
+    const std::string name = ringName("dead");
+    gc::SharedRing::unlink(name);
+    gc::SharedRing ring(name, {8, 128});
+
+    REQUIRE(ring.tryPush(gc::Logger::LogLevel::INFO, "before\n"));
+    const pid_t child = forkFaultingProducer(ring, false);
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    REQUIRE(WIFSIGNALED(status));
+    REQUIRE(ring.tryPush(gc::Logger::LogLevel::INFO, "after\n"));
+
+    REQUIRE(popAll(ring) == std::vector<std::string>{"before\n", "after\n"});
+    REQUIRE(ring.getDroppedCount() == 1);
+    gc::SharedRing::unlink(name);
+}
+
+TEST_CASE("A ring skips a cell left unpublished past the stall timeout", "[shm]")
+{
+    const std::string name = ringName("stalled");
+    gc::SharedRing::unlink(name);
+    gc::SharedRing ring(name, {8, 128});
+    ring.setStallTimeout(std::chrono::milliseconds(50));
+
+    int ready[2];
+    REQUIRE(::pipe(ready) == 0);
+    stallReadyFd = ready[1];
+
+    REQUIRE(ring.tryPush(gc::Logger::LogLevel::INFO, "before\n"));
+    const pid_t child = forkFaultingProducer(ring, true);
+    char byte = 0;
+    REQUIRE(::read(ready[0], &byte, 1) == 1);
+    REQUIRE(ring.tryPush(gc::Logger::LogLevel::INFO, "after\n"));
+
+    // Alive, so only the timeout lets the collector past it.
+    REQUIRE(popAll(ring) == std::vector<std::string>{"before\n"});
+    std::this_thread::sleep_for(std::chrono::milliseconds(60));
+    REQUIRE(popAll(ring) == std::vector<std::string>{"after\n"});
+    REQUIRE(ring.getDroppedCount() == 1);
+
+    ::kill(child, SIGKILL);
+    ::waitpid(child, nullptr, 0);
+    ::close(ready[0]);
+    ::close(ready[1]);
+    gc::SharedRing::unlink(name);
+}
+
+TEST_CASE("Attaching to a ring too small for its header fails", "[shm]")
+{
+    const std::string name = ringName("truncated");
+    gc::SharedRing::unlink(name);
+    gc::SharedRing ring(name, {64, 256});
+
+    const int fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+    REQUIRE(fd >= 0);
+    REQUIRE(::ftruncate(fd, 4096) == 0);
+    ::close(fd);
+
+    REQUIRE_THROWS_AS(gc::SharedRing(name, {}), std::system_error);
+    gc::SharedRing::unlink(name);
+}
+
+// -----------------------------------------------------------------------------
+#include "MetricsExporter.hpp"
+
+namespace {
+    // Backend holding its first record until the gate opens.
+    class GatedLogger final : public gc::Logger
+    {
+    public:
+        GatedLogger() : Logger(LogLevel::TRACE) {}
+
+        std::atomic<bool> open{false};
+
+        void log([[maybe_unused]] LogLevel level, [[maybe_unused]] const std::string &message) override {
+            while (!open.load()) {
+                std::this_thread::yield();
+            }
+        }
+    };
+}
+
+TEST_CASE("Loggers and sinks count records, bytes and flushes from every thread", "[metrics]")
+{
+    const auto path = tempLogPath("metrics");
+    gc::FileSink::FlushPolicy policy;
+    policy.everyRecords = 10;
+    policy.atLevel.reset();
+    auto file = std::make_shared<gc::FileSink>(path.string(), 1 << 20, policy);
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {memory, file});
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+
+    constexpr int threads = 4;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < threads; ++t) {
+        producers.emplace_back([&log, t] {
+            for (int i = 0; i < 250; ++i) {
+                log.info("thread {} line {}", t, i);
+            }
+            for (int i = 0; i < 10; ++i) {
+                log.error("thread {} failed", t);
+            }
+        });
+    }
+    for (auto &producer : producers) {
+        producer.join();
+    }
+    log.debug("not written");
+
+    const gc::MetricsSnapshot metrics = log.getMetrics();
+    REQUIRE(metrics.records[static_cast<std::size_t>(gc::Logger::LogLevel::INFO)] == 1000);
+    REQUIRE(metrics.records[static_cast<std::size_t>(gc::Logger::LogLevel::ERROR)] == 40);
+    REQUIRE(metrics.records[static_cast<std::size_t>(gc::Logger::LogLevel::DEBUG)] == 1);
+    REQUIRE(metrics.getRecordCount() == 1041);
+    REQUIRE(metrics.dropped == 0);
+
+    std::uint64_t bytes = 0;
+    for (const auto &line : memory->getLines()) {
+        bytes += line.second.size() + 1;
+    }
+    REQUIRE(memory->getMetrics().bytes == bytes);
+
+    const gc::MetricsSnapshot written = file->getMetrics();
+    REQUIRE(written.bytes == bytes);
+    REQUIRE(written.flushes == 104);
+    std::uint64_t bucketed = 0;
+    for (const std::uint64_t bucket : written.flushLatency) {
+        bucketed += bucket;
+    }
+    REQUIRE(bucketed == 104);
+    REQUIRE(written.flushNanoseconds > 0);
+}
+
+TEST_CASE("Dropped, suppressed and blocked records are counted", "[metrics]")
+{
+    SECTION("deduplicated and rate limited") {
+        auto memory = std::make_shared<gc::MemorySink>();
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {memory});
+        log.setDeduplicate(true);
+        for (int i = 0; i < 5; ++i) {
+            log.error("db down");
+        }
+        log.flush();
+        REQUIRE(log.getMetrics().suppressed == 4);
+        REQUIRE(log.getMetrics().records[static_cast<std::size_t>(gc::Logger::LogLevel::ERROR)] == 2);
+
+        CapturingLogger limited;
+        const auto burst = [&limited] {
+            for (int i = 0; i < 20; ++i) {
+                GCLOG_WARN_LIMITED(limited, 5, "failed {}", i);
+            }
+        };
+        burst();
+        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        burst();
+        REQUIRE(limited.getMetrics().suppressed == 15);
+    }
+
+    SECTION("dropped by a full queue") {
+        CapturingLogger backend;
+        gc::AsyncLogger log(backend, 2, gc::AsyncLogger::OverflowPolicy::DROP_NEWEST);
+        for (int i = 0; i < 10000; ++i) {
+            log.debug(std::to_string(i));
+        }
+        log.flush();
+
+        const gc::MetricsSnapshot metrics = log.getMetrics();
+        REQUIRE(metrics.records[static_cast<std::size_t>(gc::Logger::LogLevel::DEBUG)] + metrics.dropped == 10000);
+        REQUIRE(metrics.dropped == log.getDroppedCount());
+        REQUIRE(backend.lines.size() == 10000 - metrics.dropped);
+        REQUIRE(metrics.blockedNanoseconds == 0);
+    }
+
+    SECTION("blocked on a full queue") {
+        GatedLogger backend;
+        gc::AsyncLogger log(backend, 2);
+        std::thread producer([&log] {
+            for (int i = 0; i < 6; ++i) {
+                log.info("record");
+            }
+        });
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        backend.open = true;
+        producer.join();
+        log.flush();
+
+        const gc::MetricsSnapshot metrics = log.getMetrics();
+        REQUIRE(metrics.records[static_cast<std::size_t>(gc::Logger::LogLevel::INFO)] == 6);
+        REQUIRE(metrics.dropped == 0);
+        REQUIRE(metrics.blockedNanoseconds > 0);
+    }
+}
+
+TEST_CASE("MetricsExporter writes the Prometheus text format", "[metrics]")
+{
+    const auto path = tempLogPath("metrics_prom");
+    auto memory = std::make_shared<gc::MemorySink>();
+    gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {memory});
+    log.setAppendDateTime(gc::Logger::AppendDateTimeFormat::NONE);
+    for (int i = 0; i < 3; ++i) {
+        log.info("hello");
+    }
+    log.error("oops");
+
+    gc::MetricsExporter exporter(path.string(), std::chrono::milliseconds(0));
+    exporter.add("app", log);
+    exporter.add("mem\"ory", *memory);
+    const std::string text = exporter.toText();
+
+    const auto contains = [&text](const std::string &line) {
+        return text.find(line + "\n") != std::string::npos;
+    };
+    REQUIRE(contains("# TYPE gclog_records_total counter"));
+    REQUIRE(contains("gclog_records_total{logger=\"app\",level=\"info\"} 3"));
+    REQUIRE(contains("gclog_records_total{logger=\"app\",level=\"error\"} 1"));
+    REQUIRE(contains("gclog_records_total{logger=\"app\",level=\"trace\"} 0"));
+    REQUIRE(contains("gclog_dropped_total{logger=\"app\"} 0"));
+    REQUIRE(contains("# TYPE gclog_queue_high_water gauge"));
+    REQUIRE(contains("gclog_sink_bytes_total{sink=\"mem\\\"ory\"} 56"));
+    REQUIRE(contains("# TYPE gclog_sink_flush_seconds histogram"));
+    REQUIRE(contains("gclog_sink_flush_seconds_bucket{sink=\"mem\\\"ory\",le=\"0.001\"} 0"));
+    REQUIRE(contains("gclog_sink_flush_seconds_bucket{sink=\"mem\\\"ory\",le=\"+Inf\"} 0"));
+    REQUIRE(contains("gclog_sink_flush_seconds_count{sink=\"mem\\\"ory\"} 0"));
+
+    REQUIRE(exporter.dump());
+    REQUIRE(readFile(path) == text);
+    REQUIRE_FALSE(std::filesystem::exists(path.string() + ".tmp"));
+
+    SECTION("periodically") {
+        std::filesystem::remove(path);
+        gc::MetricsExporter periodic(path.string(), std::chrono::milliseconds(10));
+        periodic.add("app", log);
+        for (int i = 0; i < 200 && !std::filesystem::exists(path); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        REQUIRE(readFile(path).find("gclog_records_total{logger=\"app\",level=\"info\"} 3\n") != std::string::npos);
+    }
+}
+
+TEST_CASE("Exited threads hand their per thread state to new ones", "[metrics]")
+{
+    gc::detail::PerThread<std::uint64_t> counters([] { return std::make_unique<std::uint64_t>(0); });
+    for (int round = 0; round < 500; ++round) {
+        std::thread([&counters] { ++counters.local(); }).join();
+    }
+    REQUIRE(counters.size() == 1);
+
+    for (int round = 0; round < 50; ++round) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&counters] { ++counters.local(); });
+        }
+        for (auto &thread : threads) {
+            thread.join();
+        }
+    }
+    REQUIRE(counters.size() <= 4);
+
+    std::vector<std::uint64_t *> values;
+    counters.snapshot(values);
+    std::uint64_t total = 0;
+    for (const std::uint64_t *value : values) {
+        total += *value;
+    }
+    REQUIRE(total == 700);
+
+    SECTION("and a logger's counts survive them") {
+        gc::SinkLogger log(gc::Logger::LogLevel::TRACE, {std::make_shared<gc::NullSink>()});
+        for (int round = 0; round < 2000; ++round) {
+            std::thread([&log] { log.info("short lived"); }).join();
+        }
+        REQUIRE(log.getMetrics().records[static_cast<std::size_t>(gc::Logger::LogLevel::INFO)] == 2000);
+    }
+}
+
+TEST_CASE("A thread keeps its own value in every per thread owner", "[metrics]")
+{
+    using Counters = gc::detail::PerThread<std::uint64_t>;
+    auto make = [] { return std::make_unique<Counters>([] { return std::make_unique<std::uint64_t>(0); }); };
+
+    // More owners than a thread could ever have cached by id.
+    std::vector<std::unique_ptr<Counters>> owners;
+    for (int i = 0; i < 40; ++i) {
+        owners.push_back(make());
+    }
+    for (int round = 0; round < 10; ++round) {
+        for (std::size_t i = 0; i < owners.size(); ++i) {
+            owners[i]->local() += i;
+        }
+    }
+    for (std::size_t i = 0; i < owners.size(); ++i) {
+        REQUIRE(owners[i]->local() == 10 * i);
+        REQUIRE(owners[i]->size() == 1);
+    }
+
+    // An owner taking over a destroyed one's slot starts from nothing.
+    for (std::size_t i = 0; i < owners.size(); i += 2) {
+        owners[i] = make();
+    }
+    for (std::size_t i = 0; i < owners.size(); ++i) {
+        REQUIRE(owners[i]->local() == (i % 2 == 0 ? 0 : 10 * i));
+    }
+}